@@ -189,6 +189,22 @@ struct sort_statiterlist{
     }
 };
 
+//
+// Check the ETag in meta is the same as petag
+//
+static bool is_same_etag(const headers_t& meta, const char* petag)
+{
+    if(!petag || '\0' == petag[0]){
+        return false;
+    }
+    for(headers_t::const_iterator iter = meta.begin(); iter != meta.end(); ++iter){
+        if(lower(iter->first) == "etag"){
+            return (0 == strcmp(petag, iter->second.c_str()));
+        }
+    }
+    return false;
+}
+
 //
 // For symbolic link cache out 
 //
@@ -218,7 +234,7 @@ pthread_mutex_t StatCache::stat_cache_lock;
 // Constructor/Destructor
 //-------------------------------------------------------------------
 StatCache::StatCache() : IsExpireTime(true), IsExpireIntervalType(false), ExpireTime(15 * 60), CacheSize(100000), IsCacheNoObject(false),
- IsNoExtendedMeta(false), CheckSizeForMeta(0LL)
+ IsNoExtendedMeta(false), CheckSizeForMeta(0LL), StaleTime(0)
 {
     if(this == StatCache::getStatCacheData()){
         stat_cache.clear();
@@ -259,6 +275,12 @@ unsigned long StatCache::GetCacheSize() const
     return CacheSize;
 }
 
+bool StatCache::IsCacheFull()
+{
+    AutoLock lock(&StatCache::stat_cache_lock);
+    return (CacheSize <= stat_cache.size());
+}
+
 unsigned long StatCache::SetCacheSize(unsigned long size)
 {
     unsigned long old = CacheSize;
@@ -304,6 +326,29 @@ bool StatCache::SetNoExtendedMeta(bool flag, off_t check_size)
     return old;
 }
 
+time_t StatCache::SetStaleTime(time_t stale)
+{
+    time_t old = StaleTime;
+    StaleTime  = stale;
+    return old;
+}
+
+//
+// Returns true if the caller is the only one which refreshes the key.
+// The caller must call FinishRevalidate() after refreshing.
+//
+bool StatCache::StartRevalidate(const std::string& key)
+{
+    AutoLock lock(&StatCache::stat_cache_lock);
+    return revalidating.insert(key).second;
+}
+
+void StatCache::FinishRevalidate(const std::string& key)
+{
+    AutoLock lock(&StatCache::stat_cache_lock);
+    revalidating.erase(key);
+}
+
 void StatCache::Clear()
 {
     AutoLock lock(&StatCache::stat_cache_lock);
@@ -312,10 +357,24 @@ void StatCache::Clear()
         delete (*iter).second;
     }
     stat_cache.clear();
+    for(stat_cache_t::iterator iter = validated_cache.begin(); iter != validated_cache.end(); ++iter){
+        delete (*iter).second;
+    }
+    validated_cache.clear();
+    revalidating.clear();
     S3FS_MALLOCTRIM(0);
 }
 
-bool StatCache::GetStat(const std::string& key, struct stat* pst, headers_t* meta, bool overcheck, const char* petag, bool* pisforce, bool *pisfake)
+// [NOTE]
+// If stale-while-revalidate is enabled, the entry which is expired but
+// is still in the stale window is not removed. It is returned only when
+// pisstale is specified, and *pisstale is set to true for it. The caller
+// must refresh that entry.
+// If petag is specified(it comes from the listing), the expired entry or
+// the entry in the validated metadata which has the same ETag is
+// revalidated without HEAD request.
+//
+bool StatCache::GetStat(const std::string& key, struct stat* pst, headers_t* meta, bool overcheck, const char* petag, bool* pisforce, bool *pisfake, bool* pisstale)
 {
     bool is_delete_cache = false;
     std::string strpath = key;
@@ -331,10 +390,35 @@ bool StatCache::GetStat(const std::string& key, struct stat* pst, headers_t* met
         strpath = key;
         iter = stat_cache.find(strpath);
     }
+    if(iter == stat_cache.end() && petag && '\0' != petag[0]){
+        if(stat_cache.end() != (iter = RestoreValidatedStat(key, petag, overcheck))){
+            strpath = iter->first;
+        }
+    }
 
+    if(pisstale != NULL){
+        (*pisstale) = false;
+    }
+    bool is_retire_cache = false;
     if(iter != stat_cache.end() && (*iter).second){
         stat_cache_entry* ent = (*iter).second;
-        if(0 < ent->notruncate || !IsExpireTime || !IsExpireStatCacheTime(ent->cache_date, ExpireTime)){
+        bool is_stale = false;
+        bool is_valid = (0 < ent->notruncate || !IsExpireTime || !IsExpireStatCacheTime(ent->cache_date, ExpireTime));
+        if(!is_valid && !ent->noobjcache && is_same_etag(ent->meta, petag)){
+            // the listing proves that the object is not changed.
+            S3FS_PRN_DBG("stat cache revalidated by ETag[path=%s][ETag=%s]", strpath.c_str(), petag);
+            SetStatCacheTime(ent->cache_date);
+            is_valid = true;
+        }
+        if(!is_valid && IsStaleRevalidate() && !ent->noobjcache && !IsExpireStatCacheTime(ent->cache_date, ExpireTime + StaleTime)){
+            if(pisstale == NULL){
+                // keep this entry for the caller which can return stale stats.
+                return false;
+            }
+            is_valid = true;
+            is_stale = true;
+        }
+        if(is_valid){
             if(ent->noobjcache){
                 if(!IsCacheNoObject){
                     // need to delete this cache.
@@ -380,9 +464,12 @@ bool StatCache::GetStat(const std::string& key, struct stat* pst, headers_t* met
                 if (pisfake != NULL) {
                     (*pisfake) = ent->isfake;
                 }
+                if(pisstale != NULL){
+                    (*pisstale) = is_stale;
+                }
                 ent->hit_count++;
   
-                if(IsExpireIntervalType){
+                if(IsExpireIntervalType && !is_stale){
                     SetStatCacheTime(ent->cache_date);
                 }
                 return true;
@@ -390,16 +477,101 @@ bool StatCache::GetStat(const std::string& key, struct stat* pst, headers_t* met
 
         }else{
             // timeout
-            is_delete_cache = true;
+            is_retire_cache = true;
         }
     }
 
     if(is_delete_cache){
         DelStat(strpath, /*lock_already_held=*/ true);
+    }else if(is_retire_cache){
+        RetireStat(iter);
     }
     return false;
 }
 
+//
+// Move the expired or truncated entry to the validated metadata.
+// The entry which can not be checked by ETag is deleted.
+//
+void StatCache::RetireStat(stat_cache_t::iterator& iter)
+{
+    stat_cache_entry* ent = iter->second;
+    if(ent && !ent->noobjcache && !ent->isfake && 0 < CacheSize){
+        if(validated_cache.size() >= CacheSize){
+            TruncateValidated();
+        }
+        std::pair<stat_cache_t::iterator, bool> pair = validated_cache.insert(std::make_pair(iter->first, ent));
+        if(!pair.second){
+            delete pair.first->second;
+            pair.first->second = ent;
+        }
+    }else{
+        delete ent;
+    }
+    stat_cache.erase(iter++);
+}
+
+//
+// Move back the entry in the validated metadata which has the same ETag
+// to the stat cache, and returns the iterator of it.
+//
+stat_cache_t::iterator StatCache::RestoreValidatedStat(const std::string& key, const char* petag, bool overcheck)
+{
+    std::string            strpath = key;
+    stat_cache_t::iterator viter   = validated_cache.end();
+    if(overcheck && '/' != *strpath.rbegin()){
+        strpath += "/";
+        viter = validated_cache.find(strpath);
+    }
+    if(viter == validated_cache.end()){
+        strpath = key;
+        viter = validated_cache.find(strpath);
+    }
+    if(viter == validated_cache.end()){
+        return stat_cache.end();
+    }
+
+    stat_cache_entry* ent = viter->second;
+    validated_cache.erase(viter);
+    if(!is_same_etag(ent->meta, petag)){
+        // the object is changed.
+        delete ent;
+        return stat_cache.end();
+    }
+    S3FS_PRN_DBG("stat cache restored by ETag[path=%s][ETag=%s]", strpath.c_str(), petag);
+
+    ent->hit_count = 0;
+    SetStatCacheTime(ent->cache_date);
+
+    std::pair<stat_cache_t::iterator, bool> pair = stat_cache.insert(std::make_pair(strpath, ent));
+    if(!pair.second){
+        delete pair.first->second;
+        pair.first->second = ent;
+    }
+    return pair.first;
+}
+
+//
+// Truncate the validated metadata from the old entries.
+// This erases a tenth of entries at once for not sorting every time.
+//
+void StatCache::TruncateValidated()
+{
+    if(validated_cache.empty()){
+        return;
+    }
+    size_t         erase_count = std::max(validated_cache.size() / 10, static_cast<size_t>(1));
+    statiterlist_t erase_iters;
+    for(stat_cache_t::iterator iter = validated_cache.begin(); iter != validated_cache.end(); ++iter){
+        erase_iters.push_back(iter);
+    }
+    std::nth_element(erase_iters.begin(), erase_iters.begin() + (erase_count - 1), erase_iters.end(), sort_statiterlist());
+    for(size_t cnt = 0; cnt < erase_count; ++cnt){
+        delete erase_iters[cnt]->second;
+        validated_cache.erase(erase_iters[cnt]);
+    }
+}
+
 bool StatCache::IsNoObjectCache(const std::string& key, bool overcheck)
 {
     bool is_delete_cache = false;
@@ -515,6 +687,33 @@ bool StatCache::AddStat(const std::string& key, headers_t& meta, bool forcedir,
     return true;
 }
 
+//
+// Add the stats of directory which is not checked by HEAD request.
+// (ex. it is built from the common prefix in the listing result)
+// This entry is marked as fake, and has the specified mode and owner
+// even if no extended meta mode.
+//
+bool StatCache::AddFakeDirStat(const std::string& key, mode_t mode, uid_t uid, gid_t gid)
+{
+    headers_t meta;
+    meta["x-oss-meta-mode"] = str(S_IFDIR | (mode & ~S_IFMT));
+    meta["x-oss-meta-uid"]  = str(uid);
+    meta["x-oss-meta-gid"]  = str(gid);
+
+    if(!AddStat(key, meta, /*forcedir=*/ true, /*no_truncate=*/ false, /*isfake=*/ true)){
+        return false;
+    }
+
+    AutoLock lock(&StatCache::stat_cache_lock);
+    stat_cache_t::iterator iter = stat_cache.find(key);
+    if(stat_cache.end() != iter && iter->second){
+        iter->second->stbuf.st_mode = S_IFDIR | (mode & ~S_IFMT);
+        iter->second->stbuf.st_uid  = uid;
+        iter->second->stbuf.st_gid  = gid;
+    }
+    return true;
+}
+
 // [NOTE]
 // Updates only meta data if cached data exists.
 // And when these are updated, it also updates the cache time.
@@ -646,13 +845,13 @@ bool StatCache::TruncateCache()
         return true;
     }
 
-    // 1) erase over expire time
+    // 1) erase over expire time(and stale window)
     if(IsExpireTime){
+        time_t truncate_time = ExpireTime + (IsStaleRevalidate() ? StaleTime : 0);
         for(stat_cache_t::iterator iter = stat_cache.begin(); iter != stat_cache.end(); ){
             stat_cache_entry* entry = iter->second;
-            if(!entry || (0L == entry->notruncate && IsExpireStatCacheTime(entry->cache_date, ExpireTime))){
-                delete entry;
-                stat_cache.erase(iter++);
+            if(!entry || (0L == entry->notruncate && IsExpireStatCacheTime(entry->cache_date, truncate_time))){
+                RetireStat(iter);
             }else{
                 ++iter;
             }
@@ -690,8 +889,7 @@ bool StatCache::TruncateCache()
         stat_cache_t::iterator siter = *iiter;
 
         S3FS_PRN_DBG("truncate stat cache[path=%s]", siter->first.c_str());
-        delete siter->second;
-        stat_cache.erase(siter);
+        RetireStat(siter);
     }
     S3FS_MALLOCTRIM(0);
 
@@ -712,6 +910,10 @@ bool StatCache::DelStat(const char* key, bool lock_already_held)
         delete (*iter).second;
         stat_cache.erase(iter);
     }
+    if(validated_cache.end() != (iter = validated_cache.find(std::string(key)))){
+        delete (*iter).second;
+        validated_cache.erase(iter);
+    }
     if(0 < strlen(key) && 0 != strcmp(key, "/")){
         std::string strpath = key;
         if('/' == *strpath.rbegin()){
@@ -725,12 +927,30 @@ bool StatCache::DelStat(const char* key, bool lock_already_held)
             delete (*iter).second;
             stat_cache.erase(iter);
         }
+        if(validated_cache.end() != (iter = validated_cache.find(strpath))){
+            delete (*iter).second;
+            validated_cache.erase(iter);
+        }
     }
     S3FS_MALLOCTRIM(0);
 
     return true;
 }
 
+//
+// Delete stat and symbolic link caches of the keys at once
+//
+bool StatCache::DelStats(const std::vector<std::string>& keys)
+{
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    for(std::vector<std::string>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter){
+        DelStat(iter->c_str(), true);
+        DelSymlink(iter->c_str(), true);
+    }
+    return true;
+}
+
 bool StatCache::GetSymlink(const std::string& key, std::string& value)
 {
     bool is_delete_cache = false;
@@ -880,6 +1100,240 @@ bool StatCache::ConvertMetaToStat(const std::string& strpath, const headers_t& m
     return convert_header_to_stat(strpath, meta, pst, forcedir, IsNoExtendedMeta, CheckSizeForMeta);
 }
 
+//-------------------------------------------------------------------
+// Class ListCache
+//-------------------------------------------------------------------
+ListCache       ListCache::singleton;
+pthread_mutex_t ListCache::list_cache_lock;
+
+ListCache::ListCache() : ExpireTime(0), Generation(0)
+{
+    if(this == ListCache::getListCacheData()){
+        list_cache.clear();
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+        int result;
+        if(0 != (result = pthread_mutex_init(&ListCache::list_cache_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init list_cache_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+ListCache::~ListCache()
+{
+    if(this == ListCache::getListCacheData()){
+        Clear();
+        int result = pthread_mutex_destroy(&ListCache::list_cache_lock);
+        if(result != 0){
+            S3FS_PRN_CRIT("failed to destroy list_cache_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+void ListCache::Clear()
+{
+    AutoLock lock(&ListCache::list_cache_lock);
+
+    for(list_cache_t::iterator iter = list_cache.begin(); iter != list_cache.end(); ++iter){
+        delete (*iter).second;
+    }
+    list_cache.clear();
+    S3FS_MALLOCTRIM(0);
+}
+
+//
+// The directory path has no trailing "/" except "/".
+//
+std::string ListCache::GetDirPath(const char* path)
+{
+    std::string dirpath = (path && '\0' != path[0]) ? path : "/";
+    while(1 < dirpath.length() && '/' == *dirpath.rbegin()){
+        dirpath.erase(dirpath.length() - 1);
+    }
+    return dirpath;
+}
+
+std::string ListCache::GetCacheKey(const std::string& dirpath, const char* delimiter)
+{
+    return dirpath + '\n' + (delimiter ? delimiter : "");
+}
+
+time_t ListCache::SetExpireTime(time_t expire)
+{
+    time_t old = ExpireTime;
+    ExpireTime = expire;
+    return old;
+}
+
+unsigned long ListCache::GetGeneration()
+{
+    AutoLock lock(&ListCache::list_cache_lock);
+    return Generation;
+}
+
+//
+// If check_content_only is true, the head is set with at most 2 entries
+// from the listing of the path which has any delimiter.
+//
+bool ListCache::GetList(const char* path, const char* delimiter, S3ObjList& head, bool check_content_only)
+{
+    if(!IsEnabled()){
+        return false;
+    }
+    std::string dirpath = ListCache::GetDirPath(path);
+
+    AutoLock lock(&ListCache::list_cache_lock);
+
+    const char* delimiters[] = {delimiter, (delimiter && '\0' != delimiter[0]) ? "" : "/"};
+    for(size_t cnt = 0; cnt < (check_content_only ? 2 : 1); ++cnt){
+        list_cache_t::iterator iter = list_cache.find(ListCache::GetCacheKey(dirpath, delimiters[cnt]));
+        if(iter == list_cache.end()){
+            continue;
+        }
+        if(IsExpireStatCacheTime(iter->second->cache_date, ExpireTime)){
+            delete iter->second;
+            list_cache.erase(iter);
+            continue;
+        }
+        S3FS_PRN_DBG("list cache hit [path=%s][delimiter=%s]", dirpath.c_str(), SAFESTRPTR(delimiters[cnt]));
+
+        if(!check_content_only){
+            head = iter->second->list;
+        }else{
+            size_t count = 0;
+            for(S3ObjList::const_iterator liter = iter->second->list.begin(); iter->second->list.end() != liter && count < 2; ++liter, ++count){
+                head.insert(liter);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ListCache::AddList(const char* path, const char* delimiter, const S3ObjList& head, unsigned long generation)
+{
+    if(!IsEnabled()){
+        return false;
+    }
+    std::string key = ListCache::GetCacheKey(ListCache::GetDirPath(path), delimiter);
+
+    AutoLock lock(&ListCache::list_cache_lock);
+
+    if(generation != Generation){
+        // some objects were changed while listing.
+        S3FS_PRN_DBG("list cache is not added because objects were changed [key=%s]", key.c_str());
+        return false;
+    }
+    TruncateCache();
+
+    list_cache_entry* ent = new list_cache_entry();
+    ent->list = head;
+    SetStatCacheTime(ent->cache_date);
+
+    list_cache_t::iterator iter = list_cache.find(key);
+    if(iter != list_cache.end()){
+        delete iter->second;
+        iter->second = ent;
+    }else{
+        list_cache[key] = ent;
+    }
+    return true;
+}
+
+//
+// Remove expired entries, and the oldest one if the cache is full.
+// The caller must hold list_cache_lock.
+//
+void ListCache::TruncateCache()
+{
+    list_cache_t::iterator oldest = list_cache.end();
+    for(list_cache_t::iterator iter = list_cache.begin(); iter != list_cache.end(); ){
+        if(IsExpireStatCacheTime(iter->second->cache_date, ExpireTime)){
+            delete iter->second;
+            list_cache.erase(iter++);
+            continue;
+        }
+        if(oldest == list_cache.end() || 0 < CompareStatCacheTime(oldest->second->cache_date, iter->second->cache_date)){
+            oldest = iter;
+        }
+        ++iter;
+    }
+    if(ListCache::MAX_ENTRIES <= list_cache.size() && oldest != list_cache.end()){
+        delete oldest->second;
+        list_cache.erase(oldest);
+    }
+}
+
+//
+// The object of path is removed.
+// It is erased from the listing of the parent directory and of the
+// ancestors which has no delimiter. The listing of the ancestor with
+// delimiter is removed, because the common prefix may be gone.
+//
+void ListCache::DelObject(const char* path)
+{
+    if(!path){
+        return;
+    }
+    std::string strpath = path;
+
+    AutoLock lock(&ListCache::list_cache_lock);
+
+    ++Generation;
+    for(list_cache_t::iterator iter = list_cache.begin(); iter != list_cache.end(); ){
+        std::string::size_type pos     = iter->first.find('\n');
+        std::string            dirpath = iter->first.substr(0, pos);
+        bool                   is_flat = (iter->first.length() == pos + 1);
+        std::string            base    = ("/" == dirpath ? dirpath : dirpath + "/");
+
+        if(strpath.length() <= base.length() || 0 != strpath.compare(0, base.length(), base)){
+            ++iter;
+            continue;
+        }
+        std::string name = strpath.substr(base.length());
+        if(is_flat || std::string::npos == (pos = name.find('/')) || pos == name.length() - 1){
+            iter->second->list.erase(name.c_str());
+            ++iter;
+        }else{
+            delete iter->second;
+            list_cache.erase(iter++);
+        }
+    }
+}
+
+//
+// The object of path is added or changed.
+// The listings of the path and its ancestors are removed.
+//
+void ListCache::Invalidate(const char* path)
+{
+    std::string strpath = ListCache::GetDirPath(path);
+
+    AutoLock lock(&ListCache::list_cache_lock);
+
+    ++Generation;
+    for(list_cache_t::iterator iter = list_cache.begin(); iter != list_cache.end(); ){
+        std::string dirpath = iter->first.substr(0, iter->first.find('\n'));
+        std::string base    = ("/" == dirpath ? dirpath : dirpath + "/");
+
+        if(strpath == dirpath || 0 == strpath.compare(0, base.length(), base)){
+            delete iter->second;
+            list_cache.erase(iter++);
+        }else{
+            ++iter;
+        }
+    }
+}
+
 bool StatCache::ToTimeStat(const headers_t& meta, struct stat* pst)
 {
     // mtime
@@ -21,7 +21,11 @@
 #ifndef S3FS_CACHE_H_
 #define S3FS_CACHE_H_
 
+#include <set>
+#include <vector>
+
 #include "metaheader.h"
+#include "s3objlist.h"
 
 //-------------------------------------------------------------------
 // Structure
@@ -67,6 +71,24 @@ struct symlink_cache_entry {
 
 typedef std::map<std::string, symlink_cache_entry*> symlink_cache_t;
 
+typedef std::set<std::string> stat_revalidate_t;               // key=path which is refreshing now
+
+//
+// Struct for listing cache
+//
+struct list_cache_entry {
+    S3ObjList         list;
+    struct timespec   cache_date;  // The function that operates timespec uses the same as Stats
+
+    list_cache_entry()
+    {
+      cache_date.tv_sec  = 0;
+      cache_date.tv_nsec = 0;
+    }
+};
+
+typedef std::map<std::string, list_cache_entry*> list_cache_t;  // key=directory path + delimiter
+
 //-------------------------------------------------------------------
 // Class StatCache
 //-------------------------------------------------------------------
@@ -93,15 +115,22 @@ class StatCache
         symlink_cache_t        symlink_cache;
         bool                   IsNoExtendedMeta;
         off_t                  CheckSizeForMeta;
+        time_t                 StaleTime;               // 0 means stale entries are never returned
+        stat_revalidate_t      revalidating;
+        stat_cache_t           validated_cache;         // expired or truncated entries which can be revalidated by ETag
 
     private:
         StatCache();
         ~StatCache();
 
         void Clear();
-        bool GetStat(const std::string& key, struct stat* pst, headers_t* meta, bool overcheck, const char* petag, bool* pisforce, bool *pisfake);
+        bool GetStat(const std::string& key, struct stat* pst, headers_t* meta, bool overcheck, const char* petag, bool* pisforce, bool *pisfake, bool* pisstale);
         // Truncate stat cache
         bool TruncateCache();
+        // Validated metadata(second tier)
+        void RetireStat(stat_cache_t::iterator& iter);
+        stat_cache_t::iterator RestoreValidatedStat(const std::string& key, const char* petag, bool overcheck);
+        void TruncateValidated();
         // Truncate symbolic link cache
         bool TruncateSymlink();
 
@@ -114,6 +143,7 @@ class StatCache
 
         // Attribute
         unsigned long GetCacheSize() const;
+        bool IsCacheFull();
         unsigned long SetCacheSize(unsigned long size);
         time_t GetExpireTime() const;
         time_t SetExpireTime(time_t expire, bool is_interval = false);
@@ -143,26 +173,33 @@ class StatCache
             return SetNoExtendedMeta(false, 0);
         }
 
+        // Stale-while-revalidate
+        time_t GetStaleTime() const { return StaleTime; }
+        time_t SetStaleTime(time_t stale);
+        bool IsStaleRevalidate() const { return (IsExpireTime && 0 < StaleTime); }
+        bool StartRevalidate(const std::string& key);
+        void FinishRevalidate(const std::string& key);
+
         // Get stat cache
-        bool GetStat(const std::string& key, struct stat* pst, headers_t* meta, bool overcheck = true, bool* pisforce = NULL, bool *pisfake = NULL)
+        bool GetStat(const std::string& key, struct stat* pst, headers_t* meta, bool overcheck = true, bool* pisforce = NULL, bool *pisfake = NULL, bool* pisstale = NULL)
         {
-            return GetStat(key, pst, meta, overcheck, NULL, pisforce, pisfake);
+            return GetStat(key, pst, meta, overcheck, NULL, pisforce, pisfake, pisstale);
         }
         bool GetStat(const std::string& key, struct stat* pst, bool overcheck = true)
         {
-            return GetStat(key, pst, NULL, overcheck, NULL, NULL, NULL);
+            return GetStat(key, pst, NULL, overcheck, NULL, NULL, NULL, NULL);
         }
         bool GetStat(const std::string& key, headers_t* meta, bool overcheck = true)
         {
-            return GetStat(key, NULL, meta, overcheck, NULL, NULL, NULL);
+            return GetStat(key, NULL, meta, overcheck, NULL, NULL, NULL, NULL);
         }
         bool HasStat(const std::string& key, bool overcheck = true)
         {
-            return GetStat(key, NULL, NULL, overcheck, NULL, NULL, NULL);
+            return GetStat(key, NULL, NULL, overcheck, NULL, NULL, NULL, NULL);
         }
         bool HasStat(const std::string& key, const char* etag, bool overcheck = true)
         {
-            return GetStat(key, NULL, NULL, overcheck, etag, NULL, NULL);
+            return GetStat(key, NULL, NULL, overcheck, etag, NULL, NULL, NULL);
         }
 
         // Cache For no object
@@ -171,6 +208,7 @@ class StatCache
 
         // Add stat cache
         bool AddStat(const std::string& key, headers_t& meta, bool forcedir = false, bool no_truncate = false, bool isfake = false);
+        bool AddFakeDirStat(const std::string& key, mode_t mode, uid_t uid, gid_t gid);
 
         // Update meta stats
         bool UpdateMetaStats(const std::string& key, headers_t& meta);
@@ -184,6 +222,7 @@ class StatCache
         {
             return DelStat(key.c_str(), lock_already_held);
         }
+        bool DelStats(const std::vector<std::string>& keys);
         // Cache for symbolic link
         bool GetSymlink(const std::string& key, std::string& value);
         bool AddSymlink(const std::string& key, const std::string& value);
@@ -196,6 +235,60 @@ class StatCache
         bool ToTimeStat(const headers_t& meta, struct stat* pst);
 };
 
+//-------------------------------------------------------------------
+// Class ListCache
+//-------------------------------------------------------------------
+// [NOTE]
+// The listing results are cached for a short time, so that readdir, the
+// emptiness check before rmdir and rename of directory which are called
+// one after another do not send the same listing requests.
+// The entries are updated by the local mutations: the removed object is
+// erased from the listing of its parent and ancestors, and the entry is
+// removed if the object is added or the change can not be applied to it.
+// The generation is counted up by each mutation, and the listing which
+// was started before the mutation is not added.
+//
+class ListCache
+{
+    private:
+        static ListCache       singleton;
+        static pthread_mutex_t list_cache_lock;
+        list_cache_t           list_cache;
+        time_t                 ExpireTime;              // 0 means disabled
+        unsigned long          Generation;
+
+    private:
+        ListCache();
+        ~ListCache();
+
+        void Clear();
+        void TruncateCache();
+        static std::string GetDirPath(const char* path);
+        static std::string GetCacheKey(const std::string& dirpath, const char* delimiter);
+
+    public:
+        static const size_t    MAX_ENTRIES = 100;
+
+        // Reference singleton
+        static ListCache* getListCacheData()
+        {
+            return &singleton;
+        }
+
+        // Attribute
+        time_t GetExpireTime() const { return ExpireTime; }
+        time_t SetExpireTime(time_t expire);
+        bool IsEnabled() const { return (0 < ExpireTime); }
+        unsigned long GetGeneration();
+
+        // Get/Add listing cache
+        bool GetList(const char* path, const char* delimiter, S3ObjList& head, bool check_content_only = false);
+        bool AddList(const char* path, const char* delimiter, const S3ObjList& head, unsigned long generation);
+
+        // Update by mutation
+        void DelObject(const char* path);
+        void Invalidate(const char* path);
+};
 
 static inline bool is_check_meta(off_t size, off_t max_size) { return (size == 0) || (size <= max_size); }
 
@@ -0,0 +1,309 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Takeshi Nakatani <ggtakec.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <errno.h>
+
+#include "common.h"
+#include "s3fs.h"
+#include "copypart.h"
+#include "curl.h"
+#include "autolock.h"
+
+//------------------------------------------------
+// copypart_group methods
+//------------------------------------------------
+copypart_group::copypart_group() : done(0), result(0)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    pthread_mutex_init(&lock, &attr);
+}
+
+copypart_group::~copypart_group()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+int copypart_group::GetResult()
+{
+    AutoLock auto_lock(&lock);
+    return result;
+}
+
+void copypart_group::Finish(int part_result)
+{
+    {
+        AutoLock auto_lock(&lock);
+        if(0 == result){
+            result = part_result;       // keep the first error
+        }
+    }
+    done.post();
+}
+
+//------------------------------------------------
+// CopyPartScheduler class variables
+//------------------------------------------------
+CopyPartScheduler* CopyPartScheduler::singleton    = NULL;
+int                CopyPartScheduler::worker_count = 10;     // default
+
+//------------------------------------------------
+// CopyPartScheduler class methods
+//------------------------------------------------
+bool CopyPartScheduler::Initialize()
+{
+    if(CopyPartScheduler::singleton){
+        S3FS_PRN_WARN("Already singleton for copy part scheduler is existed, then re-create it.");
+        CopyPartScheduler::Destroy();
+    }
+    CopyPartScheduler::singleton = new CopyPartScheduler(CopyPartScheduler::worker_count);
+    return true;
+}
+
+void CopyPartScheduler::Destroy()
+{
+    if(CopyPartScheduler::singleton){
+        delete CopyPartScheduler::singleton;
+        CopyPartScheduler::singleton = NULL;
+    }
+}
+
+int CopyPartScheduler::SetWorkerCount(int count)
+{
+    int old = CopyPartScheduler::worker_count;
+    CopyPartScheduler::worker_count = count;
+    return old;
+}
+
+//
+// Copy all parts by the workers, and wait for finishing them.
+//
+// The S3fsCurl objects in parts are set up by CopyMultipartPostSetup, and
+// they are owned(deleted) by the scheduler after calling this.
+//
+int CopyPartScheduler::Request(copypart_curls_t& parts)
+{
+    S3FS_PRN_INFO3("[parts=%zu]", parts.size());
+
+    if(!CopyPartScheduler::singleton){
+        S3FS_PRN_ERR("The singleton object is not initialized yet.");
+        for(copypart_curls_t::iterator iter = parts.begin(); iter != parts.end(); ++iter){
+            (*iter)->DestroyCurlHandle();
+            delete *iter;
+        }
+        parts.clear();
+        return -EIO;
+    }
+
+    copypart_group group;
+    size_t         count = parts.size();
+    for(copypart_curls_t::iterator iter = parts.begin(); iter != parts.end(); ++iter){
+        CopyPartScheduler::singleton->AddJob(new copypart_job(*iter, &group));
+    }
+    parts.clear();
+
+    for(; 0 < count; --count){
+        group.done.wait();
+    }
+    return group.GetResult();
+}
+
+//
+// Copy one part with retrying
+//
+int CopyPartScheduler::CopyPart(S3fsCurl* s3fscurl, copypart_group* pgroup)
+{
+    int result = 0;
+
+    while(s3fscurl){
+        if(0 != pgroup->GetResult()){
+            // the other part of the object failed, this part is not needed.
+            result = -ECANCELED;
+            break;
+        }
+        if(s3fscurl->fpLazySetup && !s3fscurl->fpLazySetup(s3fscurl)){
+            S3FS_PRN_ERR("Failed to lazy setup, then respond EIO.");
+            result = -EIO;
+        }else{
+            CurlConcurrency::Acquire(s3fscurl->GetRequestClass());
+            result = s3fscurl->RequestPerform();
+            CurlConcurrency::Release(s3fscurl->GetRequestClass(), s3fscurl, result);
+        }
+        if(0 == result){
+            s3fscurl->CopyMultipartPostComplete();
+            if(s3fscurl->partdata.uploaded){
+                break;
+            }
+            result = -EIO;
+        }
+        if(-ENOENT == result || -EPERM == result){
+            // retrying does not help
+            break;
+        }
+        S3FS_PRN_WARN("failed to copy part(%d: %s), then retry it.", result, s3fscurl->url.c_str());
+
+        S3fsCurl* retrycurl = S3fsCurl::CopyMultipartPostRetryCallback(s3fscurl);
+        s3fscurl->DestroyCurlHandle();
+        delete s3fscurl;
+        s3fscurl = retrycurl;
+    }
+    if(s3fscurl){
+        s3fscurl->DestroyCurlHandle();
+        delete s3fscurl;
+    }
+    return result;
+}
+
+//
+// Thread worker
+//
+void* CopyPartScheduler::Worker(void* arg)
+{
+    CopyPartScheduler* psingleton = static_cast<CopyPartScheduler*>(arg);
+
+    if(!psingleton){
+        S3FS_PRN_ERR("The parameter for worker thread is invalid.");
+        return reinterpret_cast<void*>(-EIO);
+    }
+    S3FS_PRN_INFO3("Start worker thread in CopyPartScheduler.");
+
+    while(true){
+        psingleton->jobs_sem.wait();
+
+        copypart_job* pjob = NULL;
+        {
+            AutoLock auto_lock(&(psingleton->jobs_lock));
+            if(psingleton->is_exit){
+                break;
+            }
+            if(!psingleton->jobs.empty()){
+                pjob = psingleton->jobs.front();
+                psingleton->jobs.pop_front();
+            }
+        }
+        if(pjob){
+            pjob->pgroup->Finish(CopyPart(pjob->s3fscurl, pjob->pgroup));
+            delete pjob;
+        }
+    }
+    return NULL;
+}
+
+//------------------------------------------------
+// CopyPartScheduler methods
+//------------------------------------------------
+CopyPartScheduler::CopyPartScheduler(int count) : is_exit(false), jobs_sem(0)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    int result;
+    if(0 != (result = pthread_mutex_init(&jobs_lock, &attr))){
+        S3FS_PRN_CRIT("failed to init jobs_lock: %d", result);
+        abort();
+    }
+    if(!StartThreads(count)){
+        S3FS_PRN_CRIT("Failed starting threads for copy part scheduler.");
+        abort();
+    }
+}
+
+CopyPartScheduler::~CopyPartScheduler()
+{
+    StopThreads();
+
+    int result;
+    if(0 != (result = pthread_mutex_destroy(&jobs_lock))){
+        S3FS_PRN_CRIT("failed to destroy jobs_lock: %d", result);
+        abort();
+    }
+}
+
+bool CopyPartScheduler::StartThreads(int count)
+{
+    if(count < 1){
+        S3FS_PRN_ERR("Failed to creating threads, because thread count(%d) is under 1.", count);
+        return false;
+    }
+    for(int cnt = 0; cnt < count; ++cnt){
+        pthread_t thread;
+        int       result;
+        if(0 != (result = pthread_create(&thread, NULL, CopyPartScheduler::Worker, static_cast<void*>(this)))){
+            S3FS_PRN_ERR("failed pthread_create with return code(%d)", result);
+            StopThreads();
+            return false;
+        }
+        threads.push_back(thread);
+    }
+    return true;
+}
+
+void CopyPartScheduler::StopThreads()
+{
+    {
+        AutoLock auto_lock(&jobs_lock);
+        is_exit = true;
+    }
+    for(size_t cnt = threads.size(); 0 < cnt; --cnt){
+        jobs_sem.post();
+    }
+    for(copypart_threads_t::const_iterator iter = threads.begin(); iter != threads.end(); ++iter){
+        int result;
+        if(0 != (result = pthread_join(*iter, NULL))){
+            S3FS_PRN_ERR("failed pthread_join - result(%d)", result);
+        }
+    }
+    threads.clear();
+
+    // the jobs which are not started are failed for the waiting callers.
+    for(copypart_jobs_t::iterator iter = jobs.begin(); iter != jobs.end(); ++iter){
+        copypart_job* pjob = *iter;
+        pjob->s3fscurl->DestroyCurlHandle();
+        delete pjob->s3fscurl;
+        pjob->pgroup->Finish(-EIO);
+        delete pjob;
+    }
+    jobs.clear();
+}
+
+void CopyPartScheduler::AddJob(copypart_job* pjob)
+{
+    {
+        AutoLock auto_lock(&jobs_lock);
+        jobs.push_back(pjob);
+    }
+    jobs_sem.post();
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,117 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_COPYPART_H_
+#define S3FS_COPYPART_H_
+
+#include <list>
+
+#include "psemaphore.h"
+
+class S3fsCurl;
+
+//------------------------------------------------
+// Structures
+//------------------------------------------------
+//
+// The group of parts which are copied for one object
+//
+// [NOTE]
+// The caller waits for the semaphore as many times as the parts.
+// If one of the parts fails, the result is set and the parts which
+// are not started yet are skipped.
+//
+struct copypart_group
+{
+    Semaphore        done;
+    pthread_mutex_t  lock;
+    int              result;
+
+    copypart_group();
+    ~copypart_group();
+
+    int GetResult();
+    void Finish(int part_result);
+};
+
+struct copypart_job
+{
+    S3fsCurl*        s3fscurl;
+    copypart_group*  pgroup;
+
+    copypart_job(S3fsCurl* s3fscurl, copypart_group* pgroup) : s3fscurl(s3fscurl), pgroup(pgroup) {}
+};
+
+typedef std::list<S3fsCurl*>     copypart_curls_t;
+typedef std::list<copypart_job*> copypart_jobs_t;
+typedef std::list<pthread_t>     copypart_threads_t;
+
+//------------------------------------------------
+// Class CopyPartScheduler
+//------------------------------------------------
+// This class has the worker threads which are dedicated to the server side
+// copy of parts(UploadPartCopy). The number of workers is independent of
+// parallel_count, and the parts of all objects are put in one queue, so
+// the copies of the objects which are renamed at the same time overlap
+// with each other.
+//
+class CopyPartScheduler
+{
+    private:
+        static CopyPartScheduler* singleton;
+        static int                worker_count;
+
+        bool                      is_exit;
+        Semaphore                 jobs_sem;
+        pthread_mutex_t           jobs_lock;
+        copypart_jobs_t           jobs;
+        copypart_threads_t        threads;
+
+    private:
+        static void* Worker(void* arg);
+        static int CopyPart(S3fsCurl* s3fscurl, copypart_group* pgroup);
+
+        explicit CopyPartScheduler(int count);
+        ~CopyPartScheduler();
+
+        bool StartThreads(int count);
+        void StopThreads();
+        void AddJob(copypart_job* pjob);
+
+    public:
+        static bool Initialize();
+        static void Destroy();
+        static bool IsRunning() { return (NULL != CopyPartScheduler::singleton); }
+        static int SetWorkerCount(int count);
+        static int GetWorkerCount() { return CopyPartScheduler::worker_count; }
+
+        static int Request(copypart_curls_t& parts);
+};
+
+#endif // S3FS_COPYPART_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
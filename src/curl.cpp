@@ -36,6 +36,11 @@
 #include "s3fs_util.h"
 #include "string_util.h"
 #include "addhead.h"
+#include "s3fs_xml.h"
+#include "copypart.h"
+#include "cache.h"
+#include "curl_retry.h"
+#include "curl_engine.h"
 
 //-------------------------------------------------------------------
 // Symbols
@@ -48,6 +53,7 @@ static const char EMPTY_MD5_BASE64_HASH[]           = "1B2M2Y8AsgTpgAmY7PhCfg=="
 //-------------------------------------------------------------------
 static const int MULTIPART_SIZE                     = 10 * 1024 * 1024;
 static const int GET_OBJECT_RESPONSE_LIMIT          = 1024;
+static const off_t MAX_MULTIPART_COPY_CNT           = 10 * 1000;   // OSS multipart max count
 
 // [NOTE] about default mime.types file
 // If no mime.types file is specified in the mime option, ossfs
@@ -69,14 +75,42 @@ static const char SPECIAL_DARWIN_MIME_FILE[]        = "/etc/apache2/mime.types";
 #define CURLSHE_NOT_BUILT_IN                        5
 #endif
 
+//-------------------------------------------------------------------
+// Utility
+//-------------------------------------------------------------------
+// returns milliseconds from start to now
+static long get_elapsed_ms(const struct timespec& start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / (1000 * 1000);
+}
+
+// takes the slots for the hedged request without waiting
+static bool try_acquire_hedge_slot(curl_req_class_t reqclass)
+{
+    if(!CurlConcurrency::TryAcquire(reqclass)){
+        return false;
+    }
+    if(!CurlRequestScheduler::TryAcquire(reqclass)){
+        CurlConcurrency::Release(reqclass, NULL, 0);
+        return false;
+    }
+    return true;
+}
+
+static void release_hedge_slot(curl_req_class_t reqclass)
+{
+    CurlRequestScheduler::Release(reqclass);
+    CurlConcurrency::Release(reqclass, NULL, 0);
+}
+
 //-------------------------------------------------------------------
 // Class S3fsCurl
 //-------------------------------------------------------------------
 const long       S3fsCurl::S3FSCURL_RESPONSECODE_NOTSET;
 const long       S3fsCurl::S3FSCURL_RESPONSECODE_FATAL_ERROR;
 const int        S3fsCurl::S3FSCURL_PERFORM_RESULT_NOTSET;
-pthread_mutex_t  S3fsCurl::curl_warnings_lock;
-pthread_mutex_t  S3fsCurl::curl_handles_lock;
 S3fsCurl::callback_locks_t S3fsCurl::callback_locks;
 bool             S3fsCurl::is_initglobal_done  = false;
 CurlHandlerPool* S3fsCurl::sCurlPool           = NULL;
@@ -101,12 +135,7 @@ bool             S3fsCurl::is_dump_body        = false;
 S3fsCred*        S3fsCurl::ps3fscred           = NULL;
 long             S3fsCurl::ssl_verify_hostname = 1;    // default(original code...)
 
-// protected by curl_warnings_lock
-bool             S3fsCurl::curl_warnings_once = false;
-
-// protected by curl_handles_lock
-curltime_t       S3fsCurl::curl_times;
-curlprogress_t   S3fsCurl::curl_progress;
+std::atomic<int> S3fsCurl::curl_unsupported_opts(0);
 
 std::string      S3fsCurl::curl_ca_bundle;
 mimes_t          S3fsCurl::mimeTypes;
@@ -120,6 +149,19 @@ bool             S3fsCurl::is_unsigned_payload = false;          // default
 bool             S3fsCurl::is_ua               = true;           // default
 bool             S3fsCurl::listobjectsv2       = false;          // default
 bool             S3fsCurl::requester_pays      = false;          // default
+bool             S3fsCurl::is_http2            = false;          // default
+long             S3fsCurl::http2_max_streams   = 100;            // default
+std::atomic<long> S3fsCurl::http2_streams(0);
+std::atomic<long> S3fsCurl::http1_fallbacks(0);
+std::atomic<long> S3fsCurl::http2_connects(0);
+long             S3fsCurl::connection_max_age  = 0;              // default(0 means no limit)
+int              S3fsCurl::warmup_count        = 0;
+time_t           S3fsCurl::warmup_interval     = 0;              // default(0 means only at mount)
+pthread_t        S3fsCurl::warmup_thread;
+bool             S3fsCurl::is_warmup_thread    = false;
+bool             S3fsCurl::is_warmup_exit      = false;
+pthread_mutex_t  S3fsCurl::warmup_lock;
+pthread_cond_t   S3fsCurl::warmup_cond;
 
 long             S3fsCurl::upload_traffic_limit      = 0;          // default
 long             S3fsCurl::download_traffic_limit    = 0;          // default
@@ -134,12 +176,6 @@ bool S3fsCurl::InitS3fsCurl()
 #if S3FS_PTHREAD_ERRORCHECK
     pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
 #endif
-    if(0 != pthread_mutex_init(&S3fsCurl::curl_warnings_lock, &attr)){
-        return false;
-    }
-    if(0 != pthread_mutex_init(&S3fsCurl::curl_handles_lock, &attr)){
-        return false;
-    }
     if(0 != pthread_mutex_init(&S3fsCurl::callback_locks.dns, &attr)){
         return false;
     }
@@ -156,11 +192,14 @@ bool S3fsCurl::InitS3fsCurl()
         return false;
     }
     // [NOTE]
-    // sCurlPoolSize must be over parallel(or multireq) count.
+    // sCurlPoolSize must be over parallel(or multireq, copy workers) count.
     //
     if(sCurlPoolSize < std::max(GetMaxParallelCount(), GetMaxMultiRequest())){
         sCurlPoolSize = std::max(GetMaxParallelCount(), GetMaxMultiRequest());
     }
+    if(sCurlPoolSize < CopyPartScheduler::GetWorkerCount()){
+        sCurlPoolSize = CopyPartScheduler::GetWorkerCount();
+    }
 
     if(direct_read && sCurlPoolSize < direct_read_max_prefetch_thread_count) {
         sCurlPoolSize = direct_read_max_prefetch_thread_count;
@@ -177,6 +216,9 @@ bool S3fsCurl::DestroyS3fsCurl()
 {
     bool result = true;
 
+    S3fsCurl::PrintHttp2Stats();
+    CurlHedge::Destroy();
+
     if(!S3fsCurl::DestroyCryptMutex()){
         result = false;
     }
@@ -197,12 +239,6 @@ bool S3fsCurl::DestroyS3fsCurl()
     if(0 != pthread_mutex_destroy(&S3fsCurl::callback_locks.ssl_session)){
         result = false;
     }
-    if(0 != pthread_mutex_destroy(&S3fsCurl::curl_handles_lock)){
-        result = false;
-    }
-    if(0 != pthread_mutex_destroy(&S3fsCurl::curl_warnings_lock)){
-        result = false;
-    }
     return result;
 }
 
@@ -345,24 +381,29 @@ bool S3fsCurl::DestroyCryptMutex()
 }
 
 // homegrown timeout mechanism
+//
+// [NOTE]
+// libcurl calls this at least once per second for each transfer even if
+// it does not progress, so the stall is detected here. The progress is
+// kept in the S3fsCurl object, and it is used only by the thread which
+// performs the transfer, then any lock is not needed.
+//
 int S3fsCurl::CurlProgress(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow)
 {
-    CURL*      curl = static_cast<CURL*>(clientp);
+    S3fsCurl*  s3fscurl = static_cast<S3fsCurl*>(clientp);
     time_t     now = time(0);
     progress_t p(dlnow, ulnow);
 
-    AutoLock   lock(&S3fsCurl::curl_handles_lock);
-
     // any progress?
-    if(p != S3fsCurl::curl_progress[curl]){
+    if(p != s3fscurl->last_progress){
         // yes!
-        S3fsCurl::curl_times[curl]    = now;
-        S3fsCurl::curl_progress[curl] = p;
+        s3fscurl->last_progress_time = now;
+        s3fscurl->last_progress      = p;
     }else{
         // timeout?
-        if(now - S3fsCurl::curl_times[curl] > readwrite_timeout){
-            S3FS_PRN_ERR("timeout now: %lld, curl_times[curl]: %lld, readwrite_timeout: %lld",
-                          static_cast<long long>(now), static_cast<long long>((S3fsCurl::curl_times[curl])), static_cast<long long>(readwrite_timeout));
+        if(now - s3fscurl->last_progress_time > readwrite_timeout){
+            S3FS_PRN_ERR("timeout now: %lld, last progress time: %lld, readwrite_timeout: %lld",
+                          static_cast<long long>(now), static_cast<long long>(s3fscurl->last_progress_time), static_cast<long long>(readwrite_timeout));
             return CURLE_ABORTED_BY_CALLBACK;
         }
     }
@@ -704,6 +745,25 @@ size_t S3fsCurl::DownloadWriteCallback(void* ptr, size_t size, size_t nmemb, voi
     return totalwrite;
 }
 
+size_t S3fsCurl::ListBucketWriteCallback(void* ptr, size_t size, size_t nmemb, void* userp)
+{
+    S3fsCurl* pCurl = static_cast<S3fsCurl*>(userp);
+
+    // Buffer initial bytes in case it is an XML error response.
+    if(pCurl->bodydata.size() < GET_OBJECT_RESPONSE_LIMIT){
+        pCurl->bodydata.append(static_cast<const char*>(ptr), std::min(size * nmemb, GET_OBJECT_RESPONSE_LIMIT - pCurl->bodydata.size()));
+    }
+
+    // [NOTE]
+    // Even if the parser fails, receive all of the response. The failure
+    // is checked after finishing the request.
+    //
+    if(pCurl->plistparser){
+        pCurl->plistparser->Parse(static_cast<const char*>(ptr), size * nmemb);
+    }
+    return (size * nmemb);
+}
+
 size_t S3fsCurl::DownloadWriteStreamCallback(void* ptr, size_t size, size_t nmemb, void* userp)
 {
     S3fsCurl* pCurl = static_cast<S3fsCurl*>(userp);
@@ -1042,6 +1102,196 @@ bool S3fsCurl::SetVerbose(bool flag)
     return old;
 }
 
+//
+// HTTP/2 is used only if the server supports it(ALPN for https, Upgrade
+// for http), otherwise libcurl falls back to HTTP/1.1.
+//
+bool S3fsCurl::SetHttp2(bool flag)
+{
+    if(flag){
+        const curl_version_info_data* pinfo = curl_version_info(CURLVERSION_NOW);
+        if(!pinfo || !(pinfo->features & CURL_VERSION_HTTP2)){
+            S3FS_PRN_WARN("libcurl does not support HTTP/2, then HTTP/1.1 is used.");
+            flag = false;
+        }
+    }
+    bool old = S3fsCurl::is_http2;
+    S3fsCurl::is_http2 = flag;
+    return old;
+}
+
+long S3fsCurl::SetHttp2MaxStreams(long count)
+{
+    long old = S3fsCurl::http2_max_streams;
+    S3fsCurl::http2_max_streams = count;
+    return old;
+}
+
+void S3fsCurl::GetHttp2Stats(long& streams, long& fallbacks, long& connects)
+{
+    streams   = S3fsCurl::http2_streams.load();
+    fallbacks = S3fsCurl::http1_fallbacks.load();
+    connects  = S3fsCurl::http2_connects.load();
+}
+
+//
+// This is called when new connections are opened as well as at the end,
+// so that the ratio of the requests to the connections(how much the
+// requests are multiplexed) can be seen while ossfs is running.
+//
+void S3fsCurl::PrintHttp2Stats()
+{
+    if(!S3fsCurl::is_http2){
+        return;
+    }
+    long streams, fallbacks, connects;
+    S3fsCurl::GetHttp2Stats(streams, fallbacks, connects);
+    S3FS_PRN_INFO("HTTP/2 stats: %ld requests by HTTP/2, %ld requests by HTTP/1.x, %ld new connections", streams, fallbacks, connects);
+}
+
+long S3fsCurl::SetConnectionMaxAge(long sec)
+{
+#if LIBCURL_VERSION_NUM < 0x075000
+    if(0 < sec){
+        S3FS_PRN_WARN("The connections can not be recycled by the age, you need to use libcurl 7.80.0 or later.");
+    }
+#endif
+    long old = S3fsCurl::connection_max_age;
+    S3fsCurl::connection_max_age = sec;
+    return old;
+}
+
+time_t S3fsCurl::SetWarmUpInterval(time_t sec)
+{
+    time_t old = S3fsCurl::warmup_interval;
+    S3fsCurl::warmup_interval = sec;
+    return old;
+}
+
+//
+// Open the connections before the first requests, by sending HEAD requests
+// for the bucket in parallel through S3fsMultiCurl.
+//
+// The requests sent by curl multi engine use the connections of the multi
+// handles in its I/O threads instead of the ones of the handles, so the
+// handles in the pool(which are used by the requests in FUSE threads) and
+// the engine are warmed up by each batch. The multi handles for hedged
+// requests are not warmed up.
+//
+static int send_warmup_requests(int count, bool use_engine)
+{
+    S3fsMultiCurl curlmulti(count, use_engine);
+    int           sent = 0;
+    for(int cnt = 0; cnt < count; ++cnt){
+        S3fsCurl* s3fscurl = new S3fsCurl();
+        if(!s3fscurl->PreHeadRequest("/")){
+            delete s3fscurl;
+            break;
+        }
+        curlmulti.SetS3fsCurlObject(s3fscurl);
+        ++sent;
+    }
+    int result;
+    if(0 != (result = curlmulti.Request())){
+        S3FS_PRN_WARN("failed to warm up the connections%s: %d", (use_engine ? " of curl multi engine" : ""), result);
+    }
+    return sent;
+}
+
+int S3fsCurl::WarmUpConnections(int count)
+{
+    count = std::min(count, S3fsCurl::sCurlPoolSize);
+
+    int pool_count   = send_warmup_requests(count, false);
+    int engine_count = CurlMultiEngine::IsRunning() ? send_warmup_requests(count, true) : 0;
+
+    S3FS_PRN_INFO("warmed up %d connections, and %d connections of curl multi engine.", pool_count, engine_count);
+    return pool_count + engine_count;
+}
+
+//
+// The first warm-up is done in this thread as soon as it starts, so that
+// the mount does not wait for the requests. Then the warm-up is repeated
+// every warmup_interval seconds, so that the connections are not closed as
+// idle by the server or libcurl(CURLOPT_MAXAGE_CONN) before the next burst
+// of requests.
+//
+void* S3fsCurl::WarmUpThread(void* arg)
+{
+    S3FS_PRN_INFO3("warm-up thread starts.");
+
+    while(true){
+        S3fsCurl::WarmUpConnections(S3fsCurl::warmup_count);
+
+        AutoLock auto_lock(&S3fsCurl::warmup_lock);
+        if(S3fsCurl::is_warmup_exit || S3fsCurl::warmup_interval <= 0){
+            break;
+        }
+        struct timespec abstime;
+        clock_gettime(CLOCK_REALTIME, &abstime);
+        abstime.tv_sec += S3fsCurl::warmup_interval;
+
+        int rc = 0;
+        while(!S3fsCurl::is_warmup_exit && ETIMEDOUT != rc){
+            rc = pthread_cond_timedwait(&S3fsCurl::warmup_cond, &S3fsCurl::warmup_lock, &abstime);
+        }
+        if(S3fsCurl::is_warmup_exit){
+            break;
+        }
+    }
+    S3FS_PRN_INFO3("warm-up thread exits.");
+    return NULL;
+}
+
+bool S3fsCurl::StartWarmUp(int count)
+{
+    if(count <= 0 || S3fsCurl::is_warmup_thread){
+        return true;
+    }
+    S3fsCurl::warmup_count = count;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    int rc;
+    if(0 != (rc = pthread_mutex_init(&S3fsCurl::warmup_lock, &attr))){
+        S3FS_PRN_ERR("failed to init warmup_lock: %d", rc);
+        return false;
+    }
+    if(0 != (rc = pthread_cond_init(&S3fsCurl::warmup_cond, NULL))){
+        S3FS_PRN_ERR("failed to init warmup_cond: %d", rc);
+        pthread_mutex_destroy(&S3fsCurl::warmup_lock);
+        return false;
+    }
+    S3fsCurl::is_warmup_exit = false;
+    if(0 != (rc = pthread_create(&S3fsCurl::warmup_thread, NULL, S3fsCurl::WarmUpThread, NULL))){
+        S3FS_PRN_ERR("failed pthread_create - rc(%d)", rc);
+        pthread_cond_destroy(&S3fsCurl::warmup_cond);
+        pthread_mutex_destroy(&S3fsCurl::warmup_lock);
+        return false;
+    }
+    S3fsCurl::is_warmup_thread = true;
+    return true;
+}
+
+void S3fsCurl::StopWarmUp()
+{
+    if(!S3fsCurl::is_warmup_thread){
+        return;
+    }
+    {
+        AutoLock auto_lock(&S3fsCurl::warmup_lock);
+        S3fsCurl::is_warmup_exit = true;
+        pthread_cond_broadcast(&S3fsCurl::warmup_cond);
+    }
+    pthread_join(S3fsCurl::warmup_thread, NULL);
+    pthread_cond_destroy(&S3fsCurl::warmup_cond);
+    pthread_mutex_destroy(&S3fsCurl::warmup_lock);
+    S3fsCurl::is_warmup_thread = false;
+}
+
 bool S3fsCurl::SetDumpBody(bool flag)
 {
     bool old = S3fsCurl::is_dump_body;
@@ -1812,12 +2062,14 @@ int S3fsCurl::RawCurlDebugFunc(const CURL* hcurl, curl_infotype type, char* data
 // Methods for S3fsCurl
 //-------------------------------------------------------------------
 S3fsCurl::S3fsCurl(bool ahbe) : 
-    hCurl(NULL), type(REQTYPE_UNSET), requestHeaders(NULL),
+    hCurl(NULL), type(REQTYPE_UNSET), requestHeaders(NULL), plistparser(NULL),
     LastResponseCode(S3FSCURL_RESPONSECODE_NOTSET), postdata(NULL), postdata_remaining(0), is_use_ahbe(ahbe),
     retry_count(0), b_infile(NULL), b_postdata(NULL), b_postdata_remaining(0), b_partdata_startpos(0), b_partdata_size(0),
     b_partdata_streambuff(NULL), b_partdata_streampos(0),
     b_ssekey_pos(-1), b_ssetype(sse_type_t::SSE_DISABLE),
-    sem(NULL), completed_tids_lock(NULL), completed_tids(NULL), fpLazySetup(NULL), curlCode(CURLE_OK)
+    sem(NULL), completed_tids_lock(NULL), completed_tids(NULL), fpLazySetup(NULL), curlCode(CURLE_OK),
+    last_progress(-1, -1), last_progress_time(0), retry_wait_ms(0),
+    is_congested(false), perform_time_ms(0), req_class(CURL_REQ_CLASS_COUNT), has_request_slot(false), connect_to(NULL)
 {
     if(!S3fsCurl::ps3fscred){
         S3FS_PRN_CRIT("The object of S3fs Credential class is not initialized.");
@@ -1830,15 +2082,10 @@ S3fsCurl::~S3fsCurl()
     DestroyCurlHandle();
 }
 
-bool S3fsCurl::ResetHandle(bool lock_already_held)
+bool S3fsCurl::ResetHandle()
 {
-    bool run_once;
-    {
-        AutoLock lock(&S3fsCurl::curl_warnings_lock);
-        run_once = curl_warnings_once;
-        curl_warnings_once = true;
-    }
-
+    // This is called for every request, so the options which the libcurl
+    // does not support are remembered and not set again.
     curl_easy_reset(hCurl);
     if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_NOSIGNAL, 1)){
         return false;
@@ -1855,17 +2102,48 @@ bool S3fsCurl::ResetHandle(bool lock_already_held)
     if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_PROGRESSFUNCTION, S3fsCurl::CurlProgress)){
         return false;
     }
-    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_PROGRESSDATA, hCurl)){
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_PROGRESSDATA, this)){
         return false;
     }
     // curl_easy_setopt(hCurl, CURLOPT_FORBID_REUSE, 1);
-    if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_TCP_KEEPALIVE, 1) && !run_once){
+    if(!S3fsCurl::IsUnsupportedOption(UNSUPPORTED_TCP_KEEPALIVE) && CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_TCP_KEEPALIVE, 1) && S3fsCurl::SetUnsupportedOption(UNSUPPORTED_TCP_KEEPALIVE)){
         S3FS_PRN_WARN("The CURLOPT_TCP_KEEPALIVE option could not be set. For maximize performance you need to enable this option and you should use libcurl 7.25.0 or later.");
     }
-    if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_SSL_ENABLE_ALPN, 0) && !run_once){
-        S3FS_PRN_WARN("The CURLOPT_SSL_ENABLE_ALPN option could not be unset. OSS server does not support ALPN, then this option should be disabled to maximize performance. you need to use libcurl 7.36.0 or later.");
+#if LIBCURL_VERSION_NUM >= 0x075000
+    if(0 < S3fsCurl::connection_max_age){
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_MAXLIFETIME_CONN, S3fsCurl::connection_max_age)){
+            return false;
+        }
+    }
+#endif
+#if LIBCURL_VERSION_NUM >= 0x074100
+    if(0 < S3fsCurl::warmup_count && 0 < S3fsCurl::warmup_interval){
+        // The idle connections are kept longer than the interval of the
+        // warm-up requests, otherwise libcurl closes them as too old(the
+        // default is 118 seconds) before they are warmed up again.
+        long maxage = std::max(118L, static_cast<long>(S3fsCurl::warmup_interval) * 2);
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_MAXAGE_CONN, maxage)){
+            return false;
+        }
+    }
+#endif
+    if(S3fsCurl::is_http2 && type != REQTYPE_IAMCRED && type != REQTYPE_IAMROLE){
+        // ALPN is needed for negotiating HTTP/2, and the requests wait for
+        // the connection which can be multiplexed instead of opening new one.
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0)){
+            return false;
+        }
+#if LIBCURL_VERSION_NUM >= 0x072b00
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_PIPEWAIT, 1L)){
+            return false;
+        }
+#endif
+    }else{
+        if(!S3fsCurl::IsUnsupportedOption(UNSUPPORTED_SSL_ENABLE_ALPN) && CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_SSL_ENABLE_ALPN, 0) && S3fsCurl::SetUnsupportedOption(UNSUPPORTED_SSL_ENABLE_ALPN)){
+            S3FS_PRN_WARN("The CURLOPT_SSL_ENABLE_ALPN option could not be unset. OSS server does not support ALPN, then this option should be disabled to maximize performance. you need to use libcurl 7.36.0 or later.");
+        }
     }
-    if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_KEEP_SENDING_ON_ERROR, 1) && !run_once){
+    if(!S3fsCurl::IsUnsupportedOption(UNSUPPORTED_KEEP_SENDING_ON_ERROR) && CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_KEEP_SENDING_ON_ERROR, 1) && S3fsCurl::SetUnsupportedOption(UNSUPPORTED_KEEP_SENDING_ON_ERROR)){
         S3FS_PRN_WARN("The S3FS_CURLOPT_KEEP_SENDING_ON_ERROR option could not be set. For maximize performance you need to enable this option and you should use libcurl 7.51.0 or later.");
     }
 
@@ -1908,19 +2186,16 @@ bool S3fsCurl::ResetHandle(bool lock_already_held)
         }
     }
 
-    AutoLock lock(&S3fsCurl::curl_handles_lock, lock_already_held ? AutoLock::ALREADY_LOCKED : AutoLock::NONE);
-    S3fsCurl::curl_times[hCurl]    = time(0);
-    S3fsCurl::curl_progress[hCurl] = progress_t(-1, -1);
+    last_progress_time = time(0);
+    last_progress      = progress_t(-1, -1);
 
     return true;
 }
 
 bool S3fsCurl::CreateCurlHandle(bool only_pool, bool remake)
 {
-    AutoLock lock(&S3fsCurl::curl_handles_lock);
-
     if(hCurl && remake){
-        if(!DestroyCurlHandle(false, true, /*lock_already_held=*/ true)){
+        if(!DestroyCurlHandle(false, true)){
             S3FS_PRN_ERR("could not destroy handle.");
             return false;
         }
@@ -1940,12 +2215,12 @@ bool S3fsCurl::CreateCurlHandle(bool only_pool, bool remake)
             }
         }
     }
-    ResetHandle(/*lock_already_held=*/ true);
+    ResetHandle();
 
     return true;
 }
 
-bool S3fsCurl::DestroyCurlHandle(bool restore_pool, bool clear_internal_data, bool lock_already_held)
+bool S3fsCurl::DestroyCurlHandle(bool restore_pool, bool clear_internal_data)
 {
     // [NOTE]
     // If type is REQTYPE_IAMCRED or REQTYPE_IAMROLE, do not clear type.
@@ -1961,10 +2236,6 @@ bool S3fsCurl::DestroyCurlHandle(bool restore_pool, bool clear_internal_data, bo
     }
 
     if(hCurl){
-        AutoLock lock(&S3fsCurl::curl_handles_lock, lock_already_held ? AutoLock::ALREADY_LOCKED : AutoLock::NONE);
-  
-        S3fsCurl::curl_times.erase(hCurl);
-        S3fsCurl::curl_progress.erase(hCurl);
         sCurlPool->ReturnHandler(hCurl, restore_pool);
         hCurl = NULL;
     }else{
@@ -1988,9 +2259,18 @@ bool S3fsCurl::ClearInternalData()
         curl_slist_free_all(requestHeaders);
         requestHeaders = NULL;
     }
+    if(!balance_target.empty()){
+        CurlEndpointBalancer::Cancel(balance_target);
+        balance_target.clear();
+    }
+    if(connect_to){
+        curl_slist_free_all(connect_to);
+        connect_to = NULL;
+    }
     responseHeaders.clear();
     bodydata.clear();
     headdata.clear();
+    plistparser          = NULL;
     LastResponseCode     = S3FSCURL_RESPONSECODE_NOTSET;
     postdata             = NULL;
     postdata_remaining   = 0;
@@ -2178,11 +2458,21 @@ bool S3fsCurl::RemakeHandle()
             if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_URL, url.c_str())){
                 return false;
             }
-            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)&bodydata)){
-                return false;
-            }
-            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback)){
-                return false;
+            if(plistparser){
+                plistparser->Reset();
+                if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)this)){
+                    return false;
+                }
+                if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, ListBucketWriteCallback)){
+                    return false;
+                }
+            }else{
+                if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)&bodydata)){
+                    return false;
+                }
+                if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback)){
+                    return false;
+                }
             }
             break;
 
@@ -2352,6 +2642,30 @@ bool S3fsCurl::RemakeHandle()
                 return false;
             }
             break;
+
+        case REQTYPE_DELETEMULTI:
+            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_URL, url.c_str())){
+                return false;
+            }
+            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_POST, true)){
+                return false;
+            }
+            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)&bodydata)){
+                return false;
+            }
+            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback)){
+                return false;
+            }
+            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_POSTFIELDSIZE, static_cast<curl_off_t>(postdata_remaining))){
+                return false;
+            }
+            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_READDATA, (void*)this)){
+                return false;
+            }
+            if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_READFUNCTION, S3fsCurl::ReadCallback)){
+                return false;
+            }
+            break;
         
         default:
             S3FS_PRN_ERR("request type is unknown(%d)", type);
@@ -2367,255 +2681,671 @@ bool S3fsCurl::RemakeHandle()
 //
 // returns curl return code
 //
-int S3fsCurl::RequestPerform(bool dontAddAuthHeaders /*=false*/)
+//
+// Prepare the request headers before each perform
+//
+bool S3fsCurl::PreparePerform(bool dontAddAuthHeaders, int retrycnt)
 {
-    if(S3fsLog::IsS3fsLogDbg()){
-        char* ptr_url = NULL;
-        curl_easy_getinfo(hCurl, CURLINFO_EFFECTIVE_URL , &ptr_url);
-        S3FS_PRN_DBG("connecting to URL %s", SAFESTRPTR(ptr_url));
+    // Insert headers
+    if(!dontAddAuthHeaders) {
+         insertAuthHeaders();
     }
 
-    LastResponseCode  = S3FSCURL_RESPONSECODE_NOTSET;
-    long responseCode = S3FSCURL_RESPONSECODE_NOTSET;
-    int result        = S3FSCURL_PERFORM_RESULT_NOTSET;
-
-    // 1 attempt + retries...
-    for(int retrycnt = 0; S3FSCURL_PERFORM_RESULT_NOTSET == result && retrycnt < S3fsCurl::retries; ++retrycnt){
-        // Reset response code
-        responseCode = S3FSCURL_RESPONSECODE_NOTSET;
-        
-        // Insert headers
-        if(!dontAddAuthHeaders) {
-             insertAuthHeaders();
-        }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_HTTPHEADER, requestHeaders)){
+        return false;
+    }
+    if(!SetBalanceTarget()){
+        return false;
+    }
 
-        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_HTTPHEADER, requestHeaders)){
-            return false;
-        }
+    if(0 == retrycnt){
+        retry_wait_ms = 0;
+        is_congested  = false;
+    }
 
-        // Requests
-        curlCode = curl_easy_perform(hCurl);
+    // The streaming parser must start from the beginning of the response at each retry.
+    if(plistparser && 0 < retrycnt){
+        plistparser->Reset();
+        bodydata.clear();
+    }
+    return true;
+}
 
-        // Check result
-        switch(curlCode){
-            case CURLE_OK:
-                // Need to look at the HTTP response code
-                if(0 != curl_easy_getinfo(hCurl, CURLINFO_RESPONSE_CODE, &responseCode)){
-                    S3FS_PRN_ERR("curl_easy_getinfo failed while trying to retrieve HTTP response code");
-                    responseCode = S3FSCURL_RESPONSECODE_FATAL_ERROR;
-                    result       = -EIO;
-                    break;
-                }
-                if(responseCode >= 200 && responseCode < 300){
-                    S3FS_PRN_INFO3("HTTP response code %ld", responseCode);
-                    result = 0;
-                    break;
-                }
+//
+// Connect to the address which is picked by CurlEndpointBalancer.
+// The address is picked again at each retry, then the request fails over
+// to the other address.
+//
+bool S3fsCurl::SetBalanceTarget()
+{
+    if(!balance_target.empty()){
+        CurlEndpointBalancer::Cancel(balance_target);
+        balance_target.clear();
+    }
+    if(connect_to){
+        curl_slist_free_all(connect_to);
+        connect_to = NULL;
+    }
+    // REQTYPE_IAMCRED and REQTYPE_IAMROLE are not sent to the bucket host
+    if(!CurlEndpointBalancer::IsEnabled() || REQTYPE_IAMCRED == type || REQTYPE_IAMROLE == type){
+        return true;
+    }
 
-                {
-                    // Try to parse more specific AWS error code otherwise fall back to HTTP error code.
-                    std::string value;
-                    if(simple_parse_xml(bodydata.c_str(), bodydata.size(), "Code", value)){
-                        // TODO: other error codes
-                        if(value == "EntityTooLarge"){
-                            result = -EFBIG;
-                            break;
-                        }else if(value == "InvalidObjectState"){
-                            result = -EREMOTE;
-                            break;
-                        }else if(value == "KeyTooLongError"){
-                            result = -ENAMETOOLONG;
-                            break;
-                        }
-                    }
-                }
+#if LIBCURL_VERSION_NUM >= 0x073100
+    std::string value;
+    if(!CurlEndpointBalancer::GetTarget(balance_target, value)){
+        return true;
+    }
+    if(NULL == (connect_to = curl_slist_append(NULL, value.c_str()))){
+        S3FS_PRN_ERR("failed to allocate the list for CURLOPT_CONNECT_TO.");
+        return false;
+    }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_CONNECT_TO, connect_to)){
+        return false;
+    }
+#endif
+    return true;
+}
 
-                // Service response codes which are >= 300 && < 500
-                switch(responseCode){
-                    case 301:
-                    case 307:
-                        S3FS_PRN_ERR("HTTP response code 301(Moved Permanently: also happens when bucket's region is incorrect), returning EIO. Body Text: %s", bodydata.c_str());
-                        S3FS_PRN_ERR("The options of url and endpoint may be useful for solving, please try to use both options.");
-                        result = -EIO;
-                        break;
+//
+// Give the result of the request to CurlEndpointBalancer, the latency is
+// the time to the first byte of the response.
+//
+void S3fsCurl::ReleaseBalanceTarget(bool is_success)
+{
+    if(balance_target.empty()){
+        return;
+    }
+    double ttfb = 0.0;
+    if(CURLE_OK != curl_easy_getinfo(hCurl, CURLINFO_STARTTRANSFER_TIME, &ttfb)){
+        ttfb = static_cast<double>(perform_time_ms) / 1000;
+    }
+    CurlEndpointBalancer::Release(balance_target, is_success, static_cast<long>(ttfb * 1000));
+    balance_target.clear();
+}
 
-                    case 400:
-                        if(op == "HEAD"){
-                            if(path.size() > 1024){
-                                S3FS_PRN_ERR("HEAD HTTP response code %ld with path longer than 1024, returning ENAMETOOLONG.", responseCode);
-                                return -ENAMETOOLONG;
-                            }
-                            S3FS_PRN_ERR("HEAD HTTP response code %ld, returning EPERM.", responseCode);
-                            result = -EPERM;
-                        }else{
-                            S3FS_PRN_ERR("HTTP response code %ld, returning EIO. Body Text: %s", responseCode, bodydata.c_str());
-                            result = -EIO;
-                        }
-                        break;
-
-                    case 403:
-                        S3FS_PRN_ERR("HTTP response code %ld, returning EPERM. Body Text: %s", responseCode, bodydata.c_str());
-                        result = -EPERM;
-                        break;
+//
+// Returns true and the kind of the request if the request can be hedged,
+// which is idempotent, small and waited for by the caller.
+//
+bool S3fsCurl::GetHedgeKind(curl_hedge_kind_t& kind) const
+{
+    if(!CurlHedge::IsEnabled() || !fpLazySetup){
+        return false;
+    }
+    if(REQTYPE_HEAD == type){
+        kind = CURL_HEDGE_HEAD;
+        return true;
+    }
+    if(REQTYPE_GET_STREAM == type && 0 < b_partdata_size && b_partdata_size <= CurlHedge::MAX_SIZE){
+        kind = CURL_HEDGE_GET;
+        return true;
+    }
+    return false;
+}
 
-                    case 404:
-                        S3FS_PRN_INFO3("HTTP response code 404 was returned, returning ENOENT");
-                        S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                        result = -ENOENT;
-                        break;
+//
+// Make the same request as this object.
+// The request headers(including the signature) of this object are used as
+// they are, then this object must not be destroyed before the request.
+// For GET, the response body is written to buf instead of the caller's
+// buffer.
+//
+S3fsCurl* S3fsCurl::CreateHedgeRequest(char* buf)
+{
+    S3fsCurl* hedge = new S3fsCurl(is_use_ahbe);
+    hedge->type     = type;
+    hedge->op       = op;
+    hedge->url      = url;
+    hedge->path     = path;
+    if(REQTYPE_GET_STREAM == type){
+        hedge->partdata.startpos     = b_partdata_startpos;
+        hedge->partdata.size         = b_partdata_size;
+        hedge->partdata.streambuffer = buf;
+        hedge->partdata.streampos    = 0;
+    }
+    if(!fpLazySetup(hedge) || CURLE_OK != curl_easy_setopt(hedge->hCurl, CURLOPT_HTTPHEADER, requestHeaders) || !hedge->SetBalanceTarget()){
+        S3FS_PRN_WARN("failed to set up the hedged request for %s.", path.c_str());
+        delete hedge;
+        return NULL;
+    }
+    return hedge;
+}
 
-                    case 416:
-                        S3FS_PRN_INFO3("HTTP response code 416 was returned, returning EIO");
-                        result = -EIO;
-                        break;
+//
+// The hedged request responded first, then take its handle and response
+// as the result of this object.
+//
+void S3fsCurl::TakeHedgeResult(S3fsCurl* hedge)
+{
+    std::swap(hCurl, hedge->hCurl);
+    std::swap(balance_target, hedge->balance_target);
+    std::swap(connect_to, hedge->connect_to);
+    responseHeaders.swap(hedge->responseHeaders);
+    bodydata.swap(hedge->bodydata);
+    headdata.swap(hedge->headdata);
+
+    if(REQTYPE_GET_STREAM == type){
+        memcpy(partdata.streambuffer, hedge->partdata.streambuffer, hedge->partdata.streampos);
+        partdata.startpos  = hedge->partdata.startpos;
+        partdata.size      = hedge->partdata.size;
+        partdata.streampos = hedge->partdata.streampos;
+    }
+}
 
-                    case 501:
-                        S3FS_PRN_INFO3("HTTP response code 501 was returned, returning ENOTSUP");
-                        S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                        result = -ENOTSUP;
-                        break;
+//
+// Perform the request, and send the same request again if it does not
+// respond within the delay by CurlHedge. The response which arrives
+// first is used, and the other request is cancelled.
+//
+// [NOTE]
+// The request which failed first does not win while the other is in
+// flight, so that the hedged request can also hide the error.
+//
+CURLcode S3fsCurl::HedgedPerform(curl_hedge_kind_t kind)
+{
+    long delay = CurlHedge::GetDelay(kind);
+    if(-1 == delay){
+        // too few samples, only measure the latency
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        CURLcode code = curl_easy_perform(hCurl);
+        if(CURLE_OK == code){
+            CurlHedge::AddLatency(kind, get_elapsed_ms(start));
+        }
+        return code;
+    }
+
+    CURLM* hMulti = CurlHedge::GetMultiHandle();
+    if(!hMulti){
+        return curl_easy_perform(hCurl);
+    }
+    if(CURLM_OK != curl_multi_add_handle(hMulti, hCurl)){
+        CurlHedge::ReturnMultiHandle(hMulti);
+        return curl_easy_perform(hCurl);
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    S3fsCurl*         hedge       = NULL;
+    std::vector<char> hedgebuf;
+    curl_req_class_t  reqclass    = GetRequestClass();
+    bool              has_slot    = false;    // the slots for the hedged request
+    long              hedge_start = 0;        // ms, the time when the hedged request is sent
+    bool              is_tried    = false;    // the hedged request is tried(or given up)
+    bool              is_done     = false;
+    bool              hedge_done  = false;
+    CURLcode          code        = CURLE_OK;
+    CURLcode          hedge_code  = CURLE_OK;
+    S3fsCurl*         winner      = NULL;
+
+    while(!winner){
+        int running = 0;
+        if(CURLM_OK != curl_multi_perform(hMulti, &running)){
+            code   = CURLE_FAILED_INIT;
+            winner = this;
+            break;
+        }
+        CURLMsg* msg;
+        int      remaining;
+        while(!winner && NULL != (msg = curl_multi_info_read(hMulti, &remaining))){
+            if(CURLMSG_DONE != msg->msg){
+                continue;
+            }
+            bool is_hedge = (hedge && msg->easy_handle == hedge->hCurl);
+            if(is_hedge){
+                hedge_done = true;
+                hedge_code = msg->data.result;
+            }else{
+                is_done = true;
+                code    = msg->data.result;
+            }
+            if(CURLE_OK == msg->data.result){
+                winner = (is_hedge ? hedge : this);
+            }else if(is_done && (!hedge || hedge_done)){
+                winner = this;
+            }
+        }
+        if(winner){
+            break;
+        }
 
-                    case 500:
-                    case 503: {
-                        S3FS_PRN_INFO3("HTTP response code %ld was returned, slowing down", responseCode);
-                        S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                        // Add jitter to avoid thundering herd.
-                        unsigned int sleep_time = 2 << retry_count;
-                        sleep(sleep_time + static_cast<unsigned int>(random()) % sleep_time);
-                        break;
+        long elapsed = get_elapsed_ms(start);
+        if(!is_tried && delay <= elapsed){
+            is_tried = true;
+            // The hedged request is sent only when it does not exceed the
+            // limits of the requests in flight.
+            if(!is_done && try_acquire_hedge_slot(reqclass)){
+                if(CurlHedge::AcquireHedge()){
+                    has_slot = true;
+                }else{
+                    release_hedge_slot(reqclass);
+                }
+            }
+            if(has_slot){
+                if(REQTYPE_GET_STREAM == type){
+                    hedgebuf.resize(static_cast<size_t>(b_partdata_size));
+                }
+                if(NULL != (hedge = CreateHedgeRequest(hedgebuf.empty() ? NULL : &hedgebuf[0]))){
+                    S3FS_PRN_INFO3("send the hedged request for %s after %ld ms.", path.c_str(), elapsed);
+                    hedge_start = elapsed;
+                    if(CURLM_OK != curl_multi_add_handle(hMulti, hedge->hCurl)){
+                        delete hedge;
+                        hedge = NULL;
                     }
-                    default:
-                        S3FS_PRN_ERR("HTTP response code %ld, returning EIO. Body Text: %s", responseCode, bodydata.c_str());
-                        result = -EIO;
-                        break;
                 }
-                break;
+            }
+            continue;
+        }
+        int timeout = static_cast<int>(is_tried ? 1000 : std::min(1000L, delay - elapsed));
+        curl_multi_wait(hMulti, NULL, 0, timeout, NULL);
+    }
 
-            case CURLE_WRITE_ERROR:
-                S3FS_PRN_ERR("### CURLE_WRITE_ERROR");
-                sleep(2);
-                break; 
-
-            case CURLE_OPERATION_TIMEDOUT:
-                S3FS_PRN_ERR("### CURLE_OPERATION_TIMEDOUT");
-                sleep(2);
-                break; 
-
-            case CURLE_COULDNT_RESOLVE_HOST:
-                S3FS_PRN_ERR("### CURLE_COULDNT_RESOLVE_HOST");
-                sleep(2);
-                break; 
-
-            case CURLE_COULDNT_CONNECT:
-                S3FS_PRN_ERR("### CURLE_COULDNT_CONNECT");
-                sleep(4);
-                break; 
-
-            case CURLE_GOT_NOTHING:
-                S3FS_PRN_ERR("### CURLE_GOT_NOTHING");
-                sleep(4);
-                break; 
-
-            case CURLE_ABORTED_BY_CALLBACK:
-                S3FS_PRN_ERR("### CURLE_ABORTED_BY_CALLBACK");
-                sleep(4);
-                {
-                    AutoLock lock(&S3fsCurl::curl_handles_lock);
-                    S3fsCurl::curl_times[hCurl] = time(0);
-                }
-                break; 
+    // the request which did not finish is cancelled by removing it
+    curl_multi_remove_handle(hMulti, hCurl);
+    if(hedge){
+        curl_multi_remove_handle(hMulti, hedge->hCurl);
+    }
+    CurlHedge::ReturnMultiHandle(hMulti);
+    if(has_slot){
+        release_hedge_slot(reqclass);
+    }
 
-            case CURLE_PARTIAL_FILE:
-                S3FS_PRN_ERR("### CURLE_PARTIAL_FILE");
-                sleep(4);
-                break; 
+    // the latency of the request which responded, not including the delay of the hedged request
+    long latency = get_elapsed_ms(start);
+    if(winner == hedge){
+        S3FS_PRN_INFO3("the hedged request for %s responded first.", path.c_str());
+        TakeHedgeResult(hedge);
+        CurlHedge::AddWin();
+        code     = hedge_code;
+        latency -= hedge_start;
+    }
+    if(CURLE_OK == code){
+        CurlHedge::AddLatency(kind, latency);
+    }
+    delete hedge;
 
-            case CURLE_SEND_ERROR:
-                S3FS_PRN_ERR("### CURLE_SEND_ERROR");
-                sleep(2);
-                break;
+    return code;
+}
+
+//
+// Returns the time(ms) which is specified by Retry-After response header
+//
+long S3fsCurl::GetRetryAfter()
+{
+#if LIBCURL_VERSION_NUM >= 0x074200
+    curl_off_t retry_after = 0;
+    if(CURLE_OK == curl_easy_getinfo(hCurl, CURLINFO_RETRY_AFTER, &retry_after) && 0 < retry_after){
+        return static_cast<long>(std::min(retry_after, static_cast<curl_off_t>(CurlRetryScheduler::MAX_HINT_MS / 1000))) * 1000;
+    }
+#endif
+    // libcurl before 7.66.0, or the response headers are only kept for some requests.
+    headers_t::const_iterator iter = responseHeaders.find("Retry-After");
+    if(iter != responseHeaders.end()){
+        long sec = static_cast<long>(cvt_strtoofft(iter->second.c_str(), /*base=*/ 10));
+        if(0 < sec){
+            return std::min(sec * 1000, CurlRetryScheduler::MAX_HINT_MS);
+        }
+    }
+    return 0;
+}
 
-            case CURLE_RECV_ERROR:
-                S3FS_PRN_ERR("### CURLE_RECV_ERROR");
-                sleep(2);
+//
+// Check the result(curlCode) of the perform
+//
+// Returns S3FSCURL_PERFORM_RESULT_NOTSET if the request should be retried,
+// and waitms is set to the time which the caller should wait before
+// retrying. The caller must not block for waitms in the thread which
+// performs other requests.
+//
+int S3fsCurl::ParsePerformResult(int retrycnt, long& responseCode, long& waitms)
+{
+    int  result          = S3FSCURL_PERFORM_RESULT_NOTSET;
+    long base_ms         = 0;
+    bool throttled       = false;
+    bool throttling_code = false;   // throttled by the error code, not by the health of the server
+
+    responseCode = S3FSCURL_RESPONSECODE_NOTSET;
+    waitms       = 0;
+
+    double total_time = 0.0;
+    if(CURLE_OK == curl_easy_getinfo(hCurl, CURLINFO_TOTAL_TIME, &total_time)){
+        perform_time_ms = static_cast<long>(total_time * 1000);
+    }
+
+    long connects = 0;
+    if(CURLE_OK == curlCode && CURLE_OK == curl_easy_getinfo(hCurl, CURLINFO_NUM_CONNECTS, &connects)){
+        sCurlPool->AddConnectStats(connects);
+    }
+
+#if LIBCURL_VERSION_NUM >= 0x073200
+    if(S3fsCurl::is_http2 && CURLE_OK == curlCode){
+        long http_version = CURL_HTTP_VERSION_NONE;
+        if(CURLE_OK == curl_easy_getinfo(hCurl, CURLINFO_HTTP_VERSION, &http_version)){
+            if(CURL_HTTP_VERSION_2_0 == http_version){
+                ++S3fsCurl::http2_streams;
+            }else{
+                ++S3fsCurl::http1_fallbacks;
+            }
+        }
+        if(0 < connects){
+            S3fsCurl::http2_connects += connects;
+            S3fsCurl::PrintHttp2Stats();
+        }
+    }
+#endif
+
+    // Check result
+    switch(curlCode){
+        case CURLE_OK:
+            // Need to look at the HTTP response code
+            if(0 != curl_easy_getinfo(hCurl, CURLINFO_RESPONSE_CODE, &responseCode)){
+                S3FS_PRN_ERR("curl_easy_getinfo failed while trying to retrieve HTTP response code");
+                responseCode = S3FSCURL_RESPONSECODE_FATAL_ERROR;
+                result       = -EIO;
+                break;
+            }
+            if(responseCode >= 200 && responseCode < 300){
+                S3FS_PRN_INFO3("HTTP response code %ld", responseCode);
+                result = 0;
                 break;
+            }
 
-            case CURLE_SSL_CONNECT_ERROR:
-                S3FS_PRN_ERR("### CURLE_SSL_CONNECT_ERROR");
-                sleep(2);
+            {
+                // Try to parse more specific AWS error code otherwise fall back to HTTP error code.
+                std::string value;
+                if(simple_parse_xml(bodydata.c_str(), bodydata.size(), "Code", value)){
+                    // TODO: other error codes
+                    if(value == "EntityTooLarge"){
+                        result = -EFBIG;
+                        break;
+                    }else if(value == "InvalidObjectState"){
+                        result = -EREMOTE;
+                        break;
+                    }else if(value == "KeyTooLongError"){
+                        result = -ENAMETOOLONG;
+                        break;
+                    }else if(CurlRetryScheduler::IsThrottlingCode(value)){
+                        throttled       = true;
+                        throttling_code = true;
+                    }
+                }
+            }
+            if(throttled){
+                S3FS_PRN_INFO3("HTTP response code %ld was returned with throttling, slowing down", responseCode);
+                S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                base_ms = CurlRetryScheduler::THROTTLED_WAIT_MS;
                 break;
+            }
 
-            case CURLE_SSL_CACERT:
-                S3FS_PRN_ERR("### CURLE_SSL_CACERT");
+            // Service response codes which are >= 300 && < 500
+            switch(responseCode){
+                case 301:
+                case 307:
+                    S3FS_PRN_ERR("HTTP response code 301(Moved Permanently: also happens when bucket's region is incorrect), returning EIO. Body Text: %s", bodydata.c_str());
+                    S3FS_PRN_ERR("The options of url and endpoint may be useful for solving, please try to use both options.");
+                    result = -EIO;
+                    break;
 
-                // try to locate cert, if successful, then set the
-                // option and continue
-                if(S3fsCurl::curl_ca_bundle.empty()){
-                    if(!S3fsCurl::LocateBundle()){
-                        S3FS_PRN_ERR("could not get CURL_CA_BUNDLE.");
+                case 400:
+                    if(op == "HEAD"){
+                        if(path.size() > 1024){
+                            S3FS_PRN_ERR("HEAD HTTP response code %ld with path longer than 1024, returning ENAMETOOLONG.", responseCode);
+                            result = -ENAMETOOLONG;
+                            break;
+                        }
+                        S3FS_PRN_ERR("HEAD HTTP response code %ld, returning EPERM.", responseCode);
+                        result = -EPERM;
+                    }else{
+                        S3FS_PRN_ERR("HTTP response code %ld, returning EIO. Body Text: %s", responseCode, bodydata.c_str());
                         result = -EIO;
                     }
-                    // retry with CAINFO
-                }else{
-                    S3FS_PRN_ERR("curlCode: %d  msg: %s", curlCode, curl_easy_strerror(curlCode));
+                    break;
+
+                case 403:
+                    S3FS_PRN_ERR("HTTP response code %ld, returning EPERM. Body Text: %s", responseCode, bodydata.c_str());
+                    result = -EPERM;
+                    break;
+
+                case 404:
+                    S3FS_PRN_INFO3("HTTP response code 404 was returned, returning ENOENT");
+                    S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                    result = -ENOENT;
+                    break;
+
+                case 416:
+                    S3FS_PRN_INFO3("HTTP response code 416 was returned, returning EIO");
                     result = -EIO;
-                }
-                break;
+                    break;
 
-#ifdef CURLE_PEER_FAILED_VERIFICATION
-            case CURLE_PEER_FAILED_VERIFICATION:
-                S3FS_PRN_ERR("### CURLE_PEER_FAILED_VERIFICATION");
-
-                first_pos = S3fsCred::GetBucket().find_first_of('.');
-                if(first_pos != std::string::npos){
-                    S3FS_PRN_INFO("curl returned a CURL_PEER_FAILED_VERIFICATION error");
-                    S3FS_PRN_INFO("security issue found: buckets with periods in their name are incompatible with http");
-                    S3FS_PRN_INFO("This check can be over-ridden by using the -o ssl_verify_hostname=0");
-                    S3FS_PRN_INFO("The certificate will still be checked but the hostname will not be verified.");
-                    S3FS_PRN_INFO("A more secure method would be to use a bucket name without periods.");
-                }else{
-                    S3FS_PRN_INFO("my_curl_easy_perform: curlCode: %d -- %s", curlCode, curl_easy_strerror(curlCode));
+                case 501:
+                    S3FS_PRN_INFO3("HTTP response code 501 was returned, returning ENOTSUP");
+                    S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                    result = -ENOTSUP;
+                    break;
+
+                case 429:
+                case 500:
+                case 503:
+                    S3FS_PRN_INFO3("HTTP response code %ld was returned, slowing down", responseCode);
+                    S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                    throttled = true;
+                    base_ms   = CurlRetryScheduler::THROTTLED_WAIT_MS;
+                    break;
+
+                default:
+                    S3FS_PRN_ERR("HTTP response code %ld, returning EIO. Body Text: %s", responseCode, bodydata.c_str());
+                    result = -EIO;
+                    break;
+            }
+            break;
+
+        case CURLE_WRITE_ERROR:
+            S3FS_PRN_ERR("### CURLE_WRITE_ERROR");
+            base_ms = 2000;
+            break; 
+
+        case CURLE_OPERATION_TIMEDOUT:
+            S3FS_PRN_ERR("### CURLE_OPERATION_TIMEDOUT");
+            base_ms      = 2000;
+            is_congested = true;
+            break; 
+
+        case CURLE_COULDNT_RESOLVE_HOST:
+            S3FS_PRN_ERR("### CURLE_COULDNT_RESOLVE_HOST");
+            base_ms = 2000;
+            break; 
+
+        case CURLE_COULDNT_CONNECT:
+            S3FS_PRN_ERR("### CURLE_COULDNT_CONNECT");
+            base_ms = 4000;
+            break; 
+
+        case CURLE_GOT_NOTHING:
+            S3FS_PRN_ERR("### CURLE_GOT_NOTHING");
+            base_ms = 4000;
+            break; 
+
+        case CURLE_ABORTED_BY_CALLBACK:
+            S3FS_PRN_ERR("### CURLE_ABORTED_BY_CALLBACK");
+            base_ms            = 4000;
+            last_progress_time = time(0);
+            is_congested       = true;
+            break; 
+
+        case CURLE_PARTIAL_FILE:
+            S3FS_PRN_ERR("### CURLE_PARTIAL_FILE");
+            base_ms = 4000;
+            break; 
+
+        case CURLE_SEND_ERROR:
+            S3FS_PRN_ERR("### CURLE_SEND_ERROR");
+            base_ms = 2000;
+            break;
+
+        case CURLE_RECV_ERROR:
+            S3FS_PRN_ERR("### CURLE_RECV_ERROR");
+            base_ms = 2000;
+            break;
+
+        case CURLE_SSL_CONNECT_ERROR:
+            S3FS_PRN_ERR("### CURLE_SSL_CONNECT_ERROR");
+            base_ms = 2000;
+            break;
+
+        case CURLE_SSL_CACERT:
+            S3FS_PRN_ERR("### CURLE_SSL_CACERT");
+
+            // try to locate cert, if successful, then set the
+            // option and continue
+            if(S3fsCurl::curl_ca_bundle.empty()){
+                if(!S3fsCurl::LocateBundle()){
+                    S3FS_PRN_ERR("could not get CURL_CA_BUNDLE.");
+                    result = -EIO;
                 }
+                // retry with CAINFO
+            }else{
+                S3FS_PRN_ERR("curlCode: %d  msg: %s", curlCode, curl_easy_strerror(curlCode));
                 result = -EIO;
-                break;
+            }
+            break;
+
+#ifdef CURLE_PEER_FAILED_VERIFICATION
+        case CURLE_PEER_FAILED_VERIFICATION:
+            S3FS_PRN_ERR("### CURLE_PEER_FAILED_VERIFICATION");
+
+            first_pos = S3fsCred::GetBucket().find_first_of('.');
+            if(first_pos != std::string::npos){
+                S3FS_PRN_INFO("curl returned a CURL_PEER_FAILED_VERIFICATION error");
+                S3FS_PRN_INFO("security issue found: buckets with periods in their name are incompatible with http");
+                S3FS_PRN_INFO("This check can be over-ridden by using the -o ssl_verify_hostname=0");
+                S3FS_PRN_INFO("The certificate will still be checked but the hostname will not be verified.");
+                S3FS_PRN_INFO("A more secure method would be to use a bucket name without periods.");
+            }else{
+                S3FS_PRN_INFO("my_curl_easy_perform: curlCode: %d -- %s", curlCode, curl_easy_strerror(curlCode));
+            }
+            result = -EIO;
+            break;
 #endif
 
-            // This should be invalid since curl option HTTP FAILONERROR is now off
-            case CURLE_HTTP_RETURNED_ERROR:
-                S3FS_PRN_ERR("### CURLE_HTTP_RETURNED_ERROR");
+        // This should be invalid since curl option HTTP FAILONERROR is now off
+        case CURLE_HTTP_RETURNED_ERROR:
+            S3FS_PRN_ERR("### CURLE_HTTP_RETURNED_ERROR");
 
-                if(0 != curl_easy_getinfo(hCurl, CURLINFO_RESPONSE_CODE, &responseCode)){
-                    result = -EIO;
-                }else{
-                    S3FS_PRN_INFO3("HTTP response code =%ld", responseCode);
+            if(0 != curl_easy_getinfo(hCurl, CURLINFO_RESPONSE_CODE, &responseCode)){
+                result = -EIO;
+            }else{
+                S3FS_PRN_INFO3("HTTP response code =%ld", responseCode);
 
-                    // Let's try to retrieve the 
-                    if(404 == responseCode){
-                        result = -ENOENT;
-                    }else if(500 > responseCode){
-                        result = -EIO;
-                    }
+                // Let's try to retrieve the 
+                if(404 == responseCode){
+                    result = -ENOENT;
+                }else if(500 > responseCode){
+                    result = -EIO;
                 }
-                break;
+            }
+            break;
 
-            // Unknown CURL return code
-            default:
-                S3FS_PRN_ERR("###curlCode: %d  msg: %s", curlCode, curl_easy_strerror(curlCode));
-                result = -EIO;
-                break;
-        } // switch
+        // Unknown CURL return code
+        default:
+            S3FS_PRN_ERR("###curlCode: %d  msg: %s", curlCode, curl_easy_strerror(curlCode));
+            result = -EIO;
+            break;
+    } // switch
 
-        if(S3FSCURL_PERFORM_RESULT_NOTSET == result){
-            S3FS_PRN_INFO("### retrying...");
+    // [NOTE]
+    // The retry budget is taken only when the request is retried actually,
+    // and it is given back when the server responded without retrying.
+    //
+    if(throttled){
+        is_congested = true;
+    }
 
-            if(!RemakeHandle()){
-                S3FS_PRN_INFO("Failed to reset handle and internal data for retrying.");
+    // The address is regarded as failed by the errors of the connection
+    // and the server errors, but not by throttling which is for all
+    // addresses.
+    if(CURLE_OK == curlCode){
+        ReleaseBalanceTarget(responseCode < 500 || 501 == responseCode || throttling_code);
+    }else{
+        ReleaseBalanceTarget(CURLE_WRITE_ERROR == curlCode || CURLE_COULDNT_RESOLVE_HOST == curlCode);
+    }
+
+    std::string endpoint = CurlRetryScheduler::GetEndpoint(url);
+    if(S3FSCURL_PERFORM_RESULT_NOTSET == result){
+        if((retrycnt + 1) < S3fsCurl::retries){
+            if(!CurlRetryScheduler::AcquireRetry(endpoint)){
+                S3FS_PRN_ERR("could not retry the request because the retry budget is exhausted.");
                 result = -EIO;
-                break;
+            }else{
+                waitms        = CurlRetryScheduler::GetWaitTime(base_ms, retry_wait_ms, (throttled ? GetRetryAfter() : 0));
+                retry_wait_ms = waitms;
+                S3FS_PRN_INFO3("wait %ld ms before retrying.", waitms);
             }
         }
-    } // for
+    }else if(S3FSCURL_RESPONSECODE_NOTSET != responseCode && 0 == retrycnt){
+        CurlRetryScheduler::AddSuccess(endpoint);
+    }
+    return result;
+}
+
+//
+// Returns the class of the request for the concurrency control
+//
+curl_req_class_t S3fsCurl::GetRequestClass() const
+{
+    if(CURL_REQ_CLASS_COUNT != req_class){
+        return req_class;
+    }
+    switch(type){
+        case REQTYPE_GET:
+        case REQTYPE_GET_STREAM:
+            return CURL_REQ_READ;
+
+        case REQTYPE_PUT:
+        case REQTYPE_PREMULTIPOST:
+        case REQTYPE_COMPLETEMULTIPOST:
+        case REQTYPE_UPLOADMULTIPOST:
+        case REQTYPE_COPYMULTIPOST:
+        case REQTYPE_ABORTMULTIUPLOAD:
+            return CURL_REQ_WRITE;
+
+        default:
+            break;
+    }
+    return CURL_REQ_META;
+}
+
+//
+// Get the slot of CurlRequestScheduler before sending the request.
+//
+// [NOTE]
+// The requests for the credentials are not scheduled, because they may
+// be sent while the other request has the slot.
+//
+void S3fsCurl::AcquireRequestSlot()
+{
+    if(has_request_slot || !CurlRequestScheduler::IsEnabled() || REQTYPE_IAMCRED == type || REQTYPE_IAMROLE == type){
+        return;
+    }
+    CurlRequestScheduler::Acquire(GetRequestClass());
+    has_request_slot = true;
+}
 
+void S3fsCurl::ReleaseRequestSlot()
+{
+    if(!has_request_slot){
+        return;
+    }
+    CurlRequestScheduler::Release(GetRequestClass());
+    has_request_slot = false;
+}
+
+//
+// Set the last response code and the result after all retries
+//
+int S3fsCurl::FinishPerform(long responseCode, int result)
+{
     // set last response code
     if(S3FSCURL_RESPONSECODE_NOTSET == responseCode){
         LastResponseCode = S3FSCURL_RESPONSECODE_FATAL_ERROR;
@@ -2630,6 +3360,75 @@ int S3fsCurl::RequestPerform(bool dontAddAuthHeaders /*=false*/)
     return result;
 }
 
+int S3fsCurl::RequestPerform(bool dontAddAuthHeaders /*=false*/)
+{
+    if(S3fsLog::IsS3fsLogDbg()){
+        char* ptr_url = NULL;
+        curl_easy_getinfo(hCurl, CURLINFO_EFFECTIVE_URL , &ptr_url);
+        S3FS_PRN_DBG("connecting to URL %s", SAFESTRPTR(ptr_url));
+    }
+
+    LastResponseCode  = S3FSCURL_RESPONSECODE_NOTSET;
+    long responseCode = S3FSCURL_RESPONSECODE_NOTSET;
+    int result        = S3FSCURL_PERFORM_RESULT_NOTSET;
+
+    // the slot is already acquired if this is called for the parallel requests
+    bool is_own_slot = !has_request_slot;
+    if(is_own_slot){
+        AcquireRequestSlot();
+    }
+
+    // 1 attempt + retries...
+    for(int retrycnt = 0; S3FSCURL_PERFORM_RESULT_NOTSET == result && retrycnt < S3fsCurl::retries; ++retrycnt){
+        if(!PreparePerform(dontAddAuthHeaders, retrycnt)){
+            result = -EIO;
+            break;
+        }
+
+        // Requests
+        curl_hedge_kind_t hedge_kind;
+        if(0 == retrycnt && GetHedgeKind(hedge_kind)){
+            curlCode = HedgedPerform(hedge_kind);
+        }else{
+            curlCode = curl_easy_perform(hCurl);
+        }
+
+        // Check result
+        long waitms = 0;
+        result = ParsePerformResult(retrycnt, responseCode, waitms);
+
+        if(S3FSCURL_PERFORM_RESULT_NOTSET == result){
+            S3FS_PRN_INFO("### retrying...");
+
+            if(0 < waitms){
+                // The slot is not held while waiting(it may be long by
+                // Retry-After), so that the other requests can be sent.
+                bool has_slot = has_request_slot;
+                if(has_slot){
+                    ReleaseRequestSlot();
+                }
+                struct timespec sleeptime;
+                sleeptime.tv_sec  = waitms / 1000;
+                sleeptime.tv_nsec = (waitms % 1000) * 1000 * 1000;
+                nanosleep(&sleeptime, NULL);
+                if(has_slot){
+                    AcquireRequestSlot();
+                }
+            }
+            if(!RemakeHandle()){
+                S3FS_PRN_INFO("Failed to reset handle and internal data for retrying.");
+                result = -EIO;
+                break;
+            }
+        }
+    } // for
+
+    if(is_own_slot){
+        ReleaseRequestSlot();
+    }
+    return FinishPerform(responseCode, result);
+}
+
 //
 // Returns the Amazon AWS signature for the given parameters.
 //
@@ -2895,7 +3694,150 @@ int S3fsCurl::DeleteRequest(const char* tpath)
         return -EIO;
     }
 
-    return RequestPerform();
+    int result = RequestPerform();
+    if(0 == result || -ENOENT == result){
+        ListCache::getListCacheData()->DelObject(tpath);
+    }else{
+        ListCache::getListCacheData()->Invalidate(tpath);
+    }
+    return result;
+}
+
+//
+// Delete multiple objects by one request(DeleteMultipleObjects)
+//
+// The paths must not be over S3FSCURL_DELETEMULTI_MAX_KEYS. The request
+// is sent in quiet mode, so that the response has only the keys which
+// could not be deleted, those are set into errors with errno.
+// The key which is not found is regarded as deleted.
+//
+int S3fsCurl::DeleteMultipleObjectsRequest(const std::vector<std::string>& paths, delete_errors_t& errors)
+{
+    S3FS_PRN_INFO3("[paths=%zu]", paths.size());
+
+    errors.clear();
+    if(paths.empty()){
+        return 0;
+    }
+    if(S3FSCURL_DELETEMULTI_MAX_KEYS < paths.size()){
+        S3FS_PRN_ERR("too many keys(%zu) for one request.", paths.size());
+        return -EINVAL;
+    }
+
+    // make contents
+    std::map<std::string, std::string> realpaths;     // key=real path, value=path
+    std::string postContent;
+    postContent += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    postContent += "<Delete>\n";
+    postContent += "  <Quiet>true</Quiet>\n";
+    for(std::vector<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter){
+        std::string realpath = get_realpath(iter->c_str());
+        realpaths[realpath]  = *iter;
+        postContent += "  <Object><Key>" + xml_escape(realpath.substr(1)) + "</Key></Object>\n";
+    }
+    postContent += "</Delete>\n";
+
+    // Content-MD5 is required
+    std::string strMd5;
+    if(!make_md5_from_binary(postContent.c_str(), postContent.length(), strMd5)){
+        S3FS_PRN_ERR("Could not make MD5 from delete request body.");
+        return -EIO;
+    }
+
+    // set postdata
+    postdata             = reinterpret_cast<const unsigned char*>(postContent.c_str());
+    b_postdata           = postdata;
+    postdata_remaining   = postContent.size(); // without null
+    b_postdata_remaining = postdata_remaining;
+
+    if(!CreateCurlHandle()){
+        postdata   = NULL;
+        b_postdata = NULL;
+        return -EIO;
+    }
+    std::string resource;
+    std::string turl;
+    MakeUrlResource("", resource, turl);    // NOTICE: path is "".
+
+    query_string         = "delete";
+    turl                += "?" + query_string;
+    url                  = prepare_url(turl.c_str());
+    path                 = "/";
+    requestHeaders       = NULL;
+    bodydata.clear();
+    responseHeaders.clear();
+
+    requestHeaders = curl_slist_sort_insert(requestHeaders, "Accept", NULL);
+    requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-Type", "application/xml");
+    requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-MD5", strMd5.c_str());
+
+    op = "POST";
+    type = REQTYPE_DELETEMULTI;
+
+    // setopt
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_URL, url.c_str())){
+        return -EIO;
+    }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_POST, true)){              // POST
+        return -EIO;
+    }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)&bodydata)){
+        return -EIO;
+    }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback)){
+        return -EIO;
+    }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_POSTFIELDSIZE, static_cast<curl_off_t>(postdata_remaining))){
+        return -EIO;
+    }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_READDATA, (void*)this)){
+        return -EIO;
+    }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_READFUNCTION, S3fsCurl::ReadCallback)){
+        return -EIO;
+    }
+    if(!S3fsCurl::AddUserAgent(hCurl)){                            // put User-Agent
+        return -EIO;
+    }
+
+    // request
+    int result = RequestPerform();
+    postdata   = NULL;
+    b_postdata = NULL;
+    if(0 != result){
+        bodydata.clear();
+        for(std::vector<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter){
+            ListCache::getListCacheData()->Invalidate(iter->c_str());
+        }
+        return result;
+    }
+
+    // check the keys which could not be deleted
+    std::map<std::string, std::string> codes;
+    if(!get_delete_errors_xml(bodydata.c_str(), bodydata.size(), codes)){
+        S3FS_PRN_ERR("Could not parse the response of delete request: %s", bodydata.c_str());
+        bodydata.clear();
+        return -EIO;
+    }
+    bodydata.clear();
+
+    for(std::map<std::string, std::string>::const_iterator iter = codes.begin(); iter != codes.end(); ++iter){
+        if(iter->second == "NoSuchKey"){
+            continue;
+        }
+        std::map<std::string, std::string>::const_iterator piter = realpaths.find(iter->first);
+        std::string strpath = (piter != realpaths.end() ? piter->second : iter->first);
+        S3FS_PRN_WARN("could not delete %s object(%s).", strpath.c_str(), iter->second.c_str());
+        errors[strpath] = (iter->second == "AccessDenied" ? -EPERM : -EIO);
+    }
+    for(std::vector<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter){
+        if(errors.end() == errors.find(*iter)){
+            ListCache::getListCacheData()->DelObject(iter->c_str());
+        }else{
+            ListCache::getListCacheData()->Invalidate(iter->c_str());
+        }
+    }
+    return 0;
 }
 
 int S3fsCurl::GetIAMv2ApiToken(const char* token_url, int token_ttl, const char* token_ttl_hdr, std::string& response)
@@ -3221,9 +4163,18 @@ int S3fsCurl::HeadRequest(const char* tpath, headers_t& meta)
     }
 
     // file exists in s3
+    GetHeadResponseMeta(meta);
+    return 0;
+}
+
+//
+// Get the meta of the object from the response headers of HEAD request
+//
+void S3fsCurl::GetHeadResponseMeta(headers_t& meta) const
+{
     // fixme: clean this up.
     meta.clear();
-    for(headers_t::iterator iter = responseHeaders.begin(); iter != responseHeaders.end(); ++iter){
+    for(headers_t::const_iterator iter = responseHeaders.begin(); iter != responseHeaders.end(); ++iter){
         std::string key   = lower(iter->first);
         std::string value = iter->second;
         if(key == "content-type"){
@@ -3238,7 +4189,6 @@ int S3fsCurl::HeadRequest(const char* tpath, headers_t& meta)
             meta[key] = value;        // key is lower case for "x-oss"
         }
     }
-    return 0;
 }
 
 int S3fsCurl::PutHeadRequest(const char* tpath, headers_t& meta, bool is_copy)
@@ -3341,6 +4291,7 @@ int S3fsCurl::PutHeadRequest(const char* tpath, headers_t& meta, bool is_copy)
     int result = RequestPerform();
     result = MapPutErrorResponse(result);
     bodydata.clear();
+    ListCache::getListCacheData()->Invalidate(tpath);
 
     return result;
 }
@@ -3485,6 +4436,7 @@ int S3fsCurl::PutRequest(const char* tpath, headers_t& meta, int fd)
     if(file){
         fclose(file);
     }
+    ListCache::getListCacheData()->Invalidate(tpath);
     return result;
 }
 
@@ -3716,7 +4668,7 @@ int S3fsCurl::CheckBucket(const char* check_path)
     return result;
 }
 
-int S3fsCurl::ListBucketRequest(const char* tpath, const char* query)
+int S3fsCurl::PreListBucketRequest(const char* tpath, const char* query, ListBucketParser* parser)
 {
     S3FS_PRN_INFO3("[tpath=%s]", SAFESTRPTR(tpath));
 
@@ -3740,6 +4692,7 @@ int S3fsCurl::ListBucketRequest(const char* tpath, const char* query)
     requestHeaders  = NULL;
     responseHeaders.clear();
     bodydata.clear();
+    plistparser     = parser;
 
     op = "GET";
     type = REQTYPE_LISTBUCKET;
@@ -3748,11 +4701,21 @@ int S3fsCurl::ListBucketRequest(const char* tpath, const char* query)
     if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_URL, url.c_str())){
         return -EIO;
     }
-    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)&bodydata)){
-        return -EIO;
-    }
-    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback)){
-        return -EIO;
+    if(plistparser){
+        // the response is parsed by the streaming parser while receiving it.
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)this)){
+            return -EIO;
+        }
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, ListBucketWriteCallback)){
+            return -EIO;
+        }
+    }else{
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)&bodydata)){
+            return -EIO;
+        }
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback)){
+            return -EIO;
+        }
     }
     if(S3fsCurl::is_verbose){
         if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_DEBUGFUNCTION, S3fsCurl::CurlDebugBodyInFunc)){     // replace debug function
@@ -3762,8 +4725,21 @@ int S3fsCurl::ListBucketRequest(const char* tpath, const char* query)
     if(!S3fsCurl::AddUserAgent(hCurl)){                            // put User-Agent
         return -EIO;
     }
+    return 0;
+}
 
-    return RequestPerform();
+int S3fsCurl::ListBucketRequest(const char* tpath, const char* query, ListBucketParser* parser)
+{
+    int result;
+    if(0 != (result = PreListBucketRequest(tpath, query, parser))){
+        return result;
+    }
+    result = RequestPerform();
+    if(0 == result && plistparser && !plistparser->Finish()){
+        S3FS_PRN_ERR("Could not parse the response of list bucket request.");
+        result = -EIO;
+    }
+    return result;
 }
 
 //
@@ -3978,6 +4954,7 @@ int S3fsCurl::CompleteMultipartPostRequest(const char* tpath, const std::string&
     bodydata.clear();
     postdata   = NULL;
     b_postdata = NULL;
+    ListCache::getListCacheData()->Invalidate(tpath);
 
     return result;
 }
@@ -4283,28 +5260,46 @@ bool S3fsCurl::MixMultipartPostComplete()
     return result;
 }
 
-int S3fsCurl::MultipartHeadRequest(const char* tpath, off_t size, headers_t& meta, bool is_copy)
+//
+// Decide the part size for copying the object
+//
+// The part size is multipart_copy_size basically, but it is
+// - shrunk so that the middle size object is spread to all copy workers,
+//   because the server side copy of small parts is as fast as large parts.
+// - grown so that the huge object does not exceed the maximum part count.
+//
+off_t S3fsCurl::GetCopyPartSize(off_t size)
 {
-    int            result;
-    std::string    upload_id;
-    off_t          chunk;
-    off_t          bytes_remaining;
-    etaglist_t     list;
-
-    S3FS_PRN_INFO3("[tpath=%s]", SAFESTRPTR(tpath));
+    off_t part_size = GetMultipartCopySize();
+    off_t workers   = static_cast<off_t>(CopyPartScheduler::IsRunning() ? CopyPartScheduler::GetWorkerCount() : GetMaxParallelCount());
 
-    if(0 != (result = PreMultipartPostRequest(tpath, meta, upload_id, is_copy))){
-        return result;
+    if(0 < workers && size < part_size * workers){
+        part_size = std::max(MIN_MULTIPART_SIZE, (size + workers - 1) / workers);
     }
-    DestroyCurlHandle();
+    if(part_size * MAX_MULTIPART_COPY_CNT < size){
+        part_size = (size + MAX_MULTIPART_COPY_CNT - 1) / MAX_MULTIPART_COPY_CNT;
+    }
+    return std::min(part_size, static_cast<off_t>(FIVE_GB));
+}
 
-    // Initialize S3fsMultiCurl
-    S3fsMultiCurl curlmulti(GetMaxParallelCount());
-    curlmulti.SetSuccessCallback(S3fsCurl::CopyMultipartPostCallback);
-    curlmulti.SetRetryCallback(S3fsCurl::CopyMultipartPostRetryCallback);
+//
+// Copy all parts of the object by UploadPartCopy requests
+//
+// The parts are copied by CopyPartScheduler which has the dedicated workers
+// for the server side copy, if it is not running, S3fsMultiCurl is used.
+//
+int S3fsCurl::CopyMultipartParts(const char* from, const char* to, const std::string& upload_id, headers_t& meta, off_t size, etaglist_t& list)
+{
+    int              result;
+    off_t            chunk;
+    off_t            bytes_remaining;
+    off_t            part_size = GetCopyPartSize(size);
+    copypart_curls_t parts;
+
+    S3FS_PRN_INFO3("[from=%s][to=%s][size=%lld][part size=%lld]", SAFESTRPTR(from), SAFESTRPTR(to), static_cast<long long int>(size), static_cast<long long int>(part_size));
 
     for(bytes_remaining = size, chunk = 0; 0 < bytes_remaining; bytes_remaining -= chunk){
-        chunk = bytes_remaining > GetMultipartCopySize() ? GetMultipartCopySize() : bytes_remaining;
+        chunk = bytes_remaining > part_size ? part_size : bytes_remaining;
 
         std::ostringstream strrange;
         strrange << "bytes=" << (size - bytes_remaining) << "-" << (size - bytes_remaining + chunk - 1);
@@ -4312,28 +5307,63 @@ int S3fsCurl::MultipartHeadRequest(const char* tpath, off_t size, headers_t& met
 
         // s3fscurl sub object
         S3fsCurl* s3fscurl_para = new S3fsCurl(true);
-        s3fscurl_para->b_from   = SAFESTRPTR(tpath);
+        s3fscurl_para->b_from   = SAFESTRPTR(from);
         s3fscurl_para->b_meta   = meta;
         s3fscurl_para->partdata.add_etag_list(list);
 
         // initiate upload part for parallel
-        if(0 != (result = s3fscurl_para->CopyMultipartPostSetup(tpath, tpath, s3fscurl_para->partdata.get_part_number(), upload_id, meta))){
+        if(0 != (result = s3fscurl_para->CopyMultipartPostSetup(from, to, s3fscurl_para->partdata.get_part_number(), upload_id, meta))){
             S3FS_PRN_ERR("failed uploading part setup(%d)", result);
             delete s3fscurl_para;
+            for(copypart_curls_t::iterator iter = parts.begin(); iter != parts.end(); ++iter){
+                delete *iter;
+            }
             return result;
         }
+        parts.push_back(s3fscurl_para);
+    }
+
+    if(CopyPartScheduler::IsRunning()){
+        return CopyPartScheduler::Request(parts);
+    }
+
+    // Initialize S3fsMultiCurl
+    S3fsMultiCurl curlmulti(GetMaxParallelCount());
+    curlmulti.SetSuccessCallback(S3fsCurl::CopyMultipartPostCallback);
+    curlmulti.SetRetryCallback(S3fsCurl::CopyMultipartPostRetryCallback);
+
+    while(!parts.empty()){
+        S3fsCurl* s3fscurl_para = parts.front();
+        parts.pop_front();
 
         // set into parallel object
         if(!curlmulti.SetS3fsCurlObject(s3fscurl_para)){
-            S3FS_PRN_ERR("Could not make curl object into multi curl(%s).", tpath);
+            S3FS_PRN_ERR("Could not make curl object into multi curl(%s).", to);
             delete s3fscurl_para;
+            for(copypart_curls_t::iterator iter = parts.begin(); iter != parts.end(); ++iter){
+                delete *iter;
+            }
             return -EIO;
         }
     }
+    return curlmulti.Request();
+}
 
-    // Multi request
-    if(0 != (result = curlmulti.Request())){
-        S3FS_PRN_ERR("error occurred in multi request(errno=%d).", result);
+int S3fsCurl::MultipartHeadRequest(const char* tpath, off_t size, headers_t& meta, bool is_copy)
+{
+    int            result;
+    std::string    upload_id;
+    etaglist_t     list;
+
+    S3FS_PRN_INFO3("[tpath=%s]", SAFESTRPTR(tpath));
+
+    if(0 != (result = PreMultipartPostRequest(tpath, meta, upload_id, is_copy))){
+        return result;
+    }
+    DestroyCurlHandle();
+
+    if(0 != (result = CopyMultipartParts(tpath, tpath, upload_id, meta, size, list))){
+        S3FS_PRN_ERR("error occurred in copying parts(errno=%d).", result);
 
         S3fsCurl s3fscurl_abort(true);
         int result2 = s3fscurl_abort.AbortMultipartUpload(tpath, upload_id);
@@ -4389,8 +5419,6 @@ int S3fsCurl::MultipartRenameRequest(const char* from, const char* to, headers_t
 {
     int            result;
     std::string    upload_id;
-    off_t          chunk;
-    off_t          bytes_remaining;
     etaglist_t     list;
 
     S3FS_PRN_INFO3("[from=%s][to=%s]", SAFESTRPTR(from), SAFESTRPTR(to));
@@ -4407,42 +5435,8 @@ int S3fsCurl::MultipartRenameRequest(const char* from, const char* to, headers_t
     }
     DestroyCurlHandle();
 
-    // Initialize S3fsMultiCurl
-    S3fsMultiCurl curlmulti(GetMaxParallelCount());
-    curlmulti.SetSuccessCallback(S3fsCurl::CopyMultipartPostCallback);
-    curlmulti.SetRetryCallback(S3fsCurl::CopyMultipartPostRetryCallback);
-
-    for(bytes_remaining = size, chunk = 0; 0 < bytes_remaining; bytes_remaining -= chunk){
-        chunk = bytes_remaining > GetMultipartCopySize() ? GetMultipartCopySize() : bytes_remaining;
-
-        std::ostringstream strrange;
-        strrange << "bytes=" << (size - bytes_remaining) << "-" << (size - bytes_remaining + chunk - 1);
-        meta["x-oss-copy-source-range"] = strrange.str();
-
-        // s3fscurl sub object
-        S3fsCurl* s3fscurl_para = new S3fsCurl(true);
-        s3fscurl_para->b_from   = SAFESTRPTR(from);
-        s3fscurl_para->b_meta   = meta;
-        s3fscurl_para->partdata.add_etag_list(list);
-
-        // initiate upload part for parallel
-        if(0 != (result = s3fscurl_para->CopyMultipartPostSetup(from, to, s3fscurl_para->partdata.get_part_number(), upload_id, meta))){
-            S3FS_PRN_ERR("failed uploading part setup(%d)", result);
-            delete s3fscurl_para;
-            return result;
-        }
-
-        // set into parallel object
-        if(!curlmulti.SetS3fsCurlObject(s3fscurl_para)){
-            S3FS_PRN_ERR("Could not make curl object into multi curl(%s).", to);
-            delete s3fscurl_para;
-            return -EIO;
-        }
-    }
-
-    // Multi request
-    if(0 != (result = curlmulti.Request())){
-        S3FS_PRN_ERR("error occurred in multi request(errno=%d).", result);
+    if(0 != (result = CopyMultipartParts(from, to, upload_id, meta, size, list))){
+        S3FS_PRN_ERR("error occurred in copying parts(errno=%d).", result);
 
         S3fsCurl s3fscurl_abort(true);
         int result2 = s3fscurl_abort.AbortMultipartUpload(to, upload_id);
@@ -21,6 +21,7 @@
 #ifndef S3FS_CURL_H_
 #define S3FS_CURL_H_
 
+#include <atomic>
 #include <cassert>
 #include <curl/curl.h>
 #include <list>
@@ -34,6 +35,10 @@
 #include "metaheader.h"
 #include "fdcache_page.h"
 #include "s3fs_cred.h"
+#include "curl_concurrency.h"
+#include "curl_scheduler.h"
+#include "curl_balancer.h"
+#include "curl_hedge.h"
 
 //----------------------------------------------
 // Avoid dependency on libcurl version
@@ -72,13 +77,12 @@
 // Structure / Typedefs
 //----------------------------------------------
 typedef std::pair<double, double>   progress_t;
-typedef std::map<CURL*, time_t>     curltime_t;
-typedef std::map<CURL*, progress_t> curlprogress_t;
 
 //----------------------------------------------
 // class S3fsCurl
 //----------------------------------------------
 class S3fsCurl;
+class ListBucketParser;
 
 // Prototype function for lazy setup options for curl handle
 typedef bool (*s3fscurl_lazy_setup)(S3fsCurl* s3fscurl);
@@ -86,11 +90,15 @@ typedef bool (*s3fscurl_lazy_setup)(S3fsCurl* s3fscurl);
 typedef std::map<std::string, std::string> sseckeymap_t;
 typedef std::list<sseckeymap_t>            sseckeylist_t;
 
+typedef std::map<std::string, int>         delete_errors_t;    // key=path, value=-errno of the key which is not deleted
+
 // Class for lapping curl
 //
 class S3fsCurl
 {
     friend class S3fsMultiCurl;
+    friend class CopyPartScheduler;
+    friend class CurlMultiEngine;
 
     private:
         enum REQTYPE {
@@ -110,13 +118,18 @@ class S3fsCurl
             REQTYPE_IAMCRED,
             REQTYPE_ABORTMULTIUPLOAD,
             REQTYPE_IAMROLE,
-            REQTYPE_GET_STREAM
+            REQTYPE_GET_STREAM,
+            REQTYPE_DELETEMULTI
         };
 
         // class variables
-        static pthread_mutex_t  curl_warnings_lock;
-        static bool             curl_warnings_once;  // emit older curl warnings only once
-        static pthread_mutex_t  curl_handles_lock;
+        // the options which the older libcurl does not support
+        enum curl_unsupported_opt_t {
+            UNSUPPORTED_TCP_KEEPALIVE         = 1,
+            UNSUPPORTED_SSL_ENABLE_ALPN       = 2,
+            UNSUPPORTED_KEEP_SENDING_ON_ERROR = 4
+        };
+        static std::atomic<int> curl_unsupported_opts;  // not set again and warned only once
         static struct callback_locks_t {
             pthread_mutex_t dns;
             pthread_mutex_t ssl_session;
@@ -143,8 +156,6 @@ class S3fsCurl
         static bool             is_dump_body;
         static S3fsCred*        ps3fscred;
         static long             ssl_verify_hostname;
-        static curltime_t       curl_times;
-        static curlprogress_t   curl_progress;
         static std::string      curl_ca_bundle;
         static mimes_t          mimeTypes;
         static std::string      userAgent;
@@ -159,6 +170,19 @@ class S3fsCurl
         static bool             requester_pays;    
         static long             upload_traffic_limit;
         static long             download_traffic_limit;
+        static bool             is_http2;
+        static long             http2_max_streams;
+        static std::atomic<long> http2_streams;       // requests sent by HTTP/2
+        static std::atomic<long> http1_fallbacks;     // requests sent by HTTP/1.x while HTTP/2 is enabled
+        static std::atomic<long> http2_connects;      // new connections while HTTP/2 is enabled
+        static long             connection_max_age;
+        static int              warmup_count;
+        static time_t           warmup_interval;
+        static pthread_t        warmup_thread;
+        static bool             is_warmup_thread;
+        static bool             is_warmup_exit;
+        static pthread_mutex_t  warmup_lock;
+        static pthread_cond_t   warmup_cond;
 
         // variables
         CURL*                hCurl;
@@ -171,6 +195,7 @@ class S3fsCurl
         headers_t            responseHeaders;      // header data by HeaderCallback
         std::string          bodydata;             // body data by WriteMemoryCallback
         std::string          headdata;             // header data by WriteMemoryCallback
+        ListBucketParser*    plistparser;          // streaming parser for list bucket response(if NULL, body is stored in bodydata)
         long                 LastResponseCode;
         const unsigned char* postdata;             // use by post method and read callback function.
         off_t                postdata_remaining;   // use by post method and read callback function.
@@ -196,11 +221,21 @@ class S3fsCurl
         std::vector<pthread_t> *completed_tids;
         s3fscurl_lazy_setup  fpLazySetup;          // curl options for lazy setting function
         CURLcode             curlCode;             // handle curl return
+        progress_t           last_progress;        // the last progress of the transfer(only used by the thread performing it)
+        time_t               last_progress_time;   // the time when the transfer progressed at last
+        long                 retry_wait_ms;        // the last wait time before retrying(for jittered backoff)
+        bool                 is_congested;         // the request was throttled or timed out at least once
+        long                 perform_time_ms;      // the total time of the last perform
+        curl_req_class_t     req_class;            // the class of the request, CURL_REQ_CLASS_COUNT means by the type
+        bool                 has_request_slot;     // the slot of CurlRequestScheduler is acquired
+        std::string          balance_target;       // the address picked by CurlEndpointBalancer
+        struct curl_slist*   connect_to;           // for CURLOPT_CONNECT_TO
     
     public:
         static const long S3FSCURL_RESPONSECODE_NOTSET      = -1;
         static const long S3FSCURL_RESPONSECODE_FATAL_ERROR = -2;
         static const int  S3FSCURL_PERFORM_RESULT_NOTSET    = 1;
+        static const size_t S3FSCURL_DELETEMULTI_MAX_KEYS   = 1000;  // the maximum keys in one DeleteMultipleObjects request
 
     public:
         // constructor/destructor
@@ -218,13 +253,17 @@ class S3fsCurl
         static bool InitCryptMutex();
         static bool DestroyCryptMutex();
         static int CurlProgress(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow);
+        static bool IsUnsupportedOption(curl_unsupported_opt_t opt) { return (0 != (S3fsCurl::curl_unsupported_opts.load(std::memory_order_relaxed) & opt)); }
+        static bool SetUnsupportedOption(curl_unsupported_opt_t opt) { return (0 == (S3fsCurl::curl_unsupported_opts.fetch_or(opt) & opt)); }
 
         static bool LocateBundle();
+        static void* WarmUpThread(void* arg);
         static size_t HeaderCallback(void *data, size_t blockSize, size_t numBlocks, void *userPtr);
         static size_t WriteMemoryCallback(void *ptr, size_t blockSize, size_t numBlocks, void *data);
         static size_t ReadCallback(void *ptr, size_t size, size_t nmemb, void *userp);
         static size_t UploadReadCallback(void *ptr, size_t size, size_t nmemb, void *userp);
         static size_t DownloadWriteCallback(void* ptr, size_t size, size_t nmemb, void* userp);
+        static size_t ListBucketWriteCallback(void* ptr, size_t size, size_t nmemb, void* userp);
         static size_t DownloadWriteStreamCallback(void* ptr, size_t size, size_t nmenb, void* userp);
 
         static bool UploadMultipartPostCallback(S3fsCurl* s3fscurl);
@@ -253,8 +292,18 @@ class S3fsCurl
         static int RawCurlDebugFunc(const CURL* hcurl, curl_infotype type, char* data, size_t size, void* userptr, curl_infotype datatype);
 
         // methods
-        bool ResetHandle(bool lock_already_held = false);
+        bool ResetHandle();
         bool RemakeHandle();
+        bool PreparePerform(bool dontAddAuthHeaders, int retrycnt);
+        long GetRetryAfter();
+        int ParsePerformResult(int retrycnt, long& responseCode, long& waitms);
+        bool SetBalanceTarget();
+        void ReleaseBalanceTarget(bool is_success);
+        bool GetHedgeKind(curl_hedge_kind_t& kind) const;
+        S3fsCurl* CreateHedgeRequest(char* buf);
+        void TakeHedgeResult(S3fsCurl* hedge);
+        CURLcode HedgedPerform(curl_hedge_kind_t kind);
+        int FinishPerform(long responseCode, int result);
         bool ClearInternalData();
         void insertV4Headers(const std::string& access_key_id, const std::string& secret_access_key, const std::string& access_token);
         void insertV2Headers(const std::string& access_key_id, const std::string& secret_access_key, const std::string& access_token);
@@ -264,6 +313,7 @@ class S3fsCurl
         std::string CalcSignature(const std::string& method, const std::string& canonical_uri, const std::string& query_string, const std::string& strdate, const std::string& payload_hash, const std::string& date8601, const std::string& secret_access_key, const std::string& access_token);
         int UploadMultipartPostSetup(const char* tpath, int part_num, const std::string& upload_id);
         int CopyMultipartPostSetup(const char* from, const char* to, int part_num, const std::string& upload_id, headers_t& meta);
+        int CopyMultipartParts(const char* from, const char* to, const std::string& upload_id, headers_t& meta, off_t size, etaglist_t& list);
         bool UploadMultipartPostComplete();
         bool CopyMultipartPostComplete();
         bool MixMultipartPostComplete();
@@ -319,6 +369,19 @@ class S3fsCurl
         static bool IsSetSseCMK() { return S3fsCurl::is_sse_cmk; }
         static bool SetVerbose(bool flag);
         static bool GetVerbose() { return S3fsCurl::is_verbose; }
+        static bool SetHttp2(bool flag);
+        static bool IsHttp2() { return S3fsCurl::is_http2; }
+        static long SetHttp2MaxStreams(long count);
+        static long GetHttp2MaxStreams() { return S3fsCurl::http2_max_streams; }
+        static void GetHttp2Stats(long& streams, long& fallbacks, long& connects);
+        static void PrintHttp2Stats();
+        static long SetConnectionMaxAge(long sec);
+        static long GetConnectionMaxAge() { return S3fsCurl::connection_max_age; }
+        static time_t SetWarmUpInterval(time_t sec);
+        static time_t GetWarmUpInterval() { return S3fsCurl::warmup_interval; }
+        static int WarmUpConnections(int count);
+        static bool StartWarmUp(int count);
+        static void StopWarmUp();
         static bool SetDumpBody(bool flag);
         static bool IsDumpBody() { return S3fsCurl::is_dump_body; }
         static long SetSslVerifyHostname(long value);
@@ -334,6 +397,7 @@ class S3fsCurl
         static off_t GetMultipartSize() { return S3fsCurl::multipart_size; }
         static bool SetMultipartCopySize(off_t size);
         static off_t GetMultipartCopySize() { return S3fsCurl::multipart_copy_size; }
+        static off_t GetCopyPartSize(off_t size);
         static signature_type_t SetSignatureType(signature_type_t signature_type) { signature_type_t bresult = S3fsCurl::signature_type; S3fsCurl::signature_type = signature_type; return bresult; }
         static signature_type_t GetSignatureType() { return S3fsCurl::signature_type; }
         static bool SetUnsignedPayload(bool issset) { bool bresult = S3fsCurl::is_unsigned_payload; S3fsCurl::is_unsigned_payload = issset; return bresult; }
@@ -350,7 +414,7 @@ class S3fsCurl
 
         // methods
         bool CreateCurlHandle(bool only_pool = false, bool remake = false);
-        bool DestroyCurlHandle(bool restore_pool = true, bool clear_internal_data = true, bool lock_already_held = false);
+        bool DestroyCurlHandle(bool restore_pool = true, bool clear_internal_data = true);
 
         bool GetRAMCredentials(const char* cred_url, const char* iam_v2_token, const char* ibm_secret_access_key, std::string& response);
         bool GetRAMRoleFromMetaData(const char* cred_url, const char* iam_v2_token, std::string& token);
@@ -358,18 +422,21 @@ class S3fsCurl
         bool GetResponseCode(long& responseCode, bool from_curl_handle = true);
         int RequestPerform(bool dontAddAuthHeaders=false);
         int DeleteRequest(const char* tpath);
+        int DeleteMultipleObjectsRequest(const std::vector<std::string>& paths, delete_errors_t& errors);
         int GetIAMv2ApiToken(const char* token_url, int token_ttl, const char* token_ttl_hdr, std::string& response);
         bool PreHeadRequest(const char* tpath, const char* bpath = NULL, const char* savedpath = NULL, size_t ssekey_pos = -1);
         bool PreHeadRequest(const std::string& tpath, const std::string& bpath, const std::string& savedpath, size_t ssekey_pos = -1) {
           return PreHeadRequest(tpath.c_str(), bpath.c_str(), savedpath.c_str(), ssekey_pos);
         }
         int HeadRequest(const char* tpath, headers_t& meta);
+        void GetHeadResponseMeta(headers_t& meta) const;
         int PutHeadRequest(const char* tpath, headers_t& meta, bool is_copy);
         int PutRequest(const char* tpath, headers_t& meta, int fd);
         int PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue);
         int GetObjectRequest(const char* tpath, int fd, off_t start = -1, off_t size = -1);
         int CheckBucket(const char* check_path);
-        int ListBucketRequest(const char* tpath, const char* query);
+        int PreListBucketRequest(const char* tpath, const char* query, ListBucketParser* parser = NULL);
+        int ListBucketRequest(const char* tpath, const char* query, ListBucketParser* parser = NULL);
         int PreMultipartPostRequest(const char* tpath, headers_t& meta, std::string& upload_id, bool is_copy);
         int CompleteMultipartPostRequest(const char* tpath, const std::string& upload_id, etaglist_t& parts);
         int UploadMultipartPostRequest(const char* tpath, int part_num, const std::string& upload_id);
@@ -401,6 +468,12 @@ class S3fsCurl
         void SetMultipartRetryCount(int retrycnt) { retry_count = retrycnt; }
         bool IsOverMultipartRetryCount() const { return (retry_count >= S3fsCurl::retries); }
         size_t GetLastPreHeadSeecKeyPos() const { return b_ssekey_pos; }
+        bool IsCongested() const { return is_congested; }
+        long GetPerformTime() const { return perform_time_ms; }
+        curl_req_class_t GetRequestClass() const;
+        void SetRequestClass(curl_req_class_t reqclass) { req_class = reqclass; }
+        void AcquireRequestSlot();
+        void ReleaseRequestSlot();
 };
 
 #endif // S3FS_CURL_H_
@@ -0,0 +1,356 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <curl/curl.h>
+
+#include "common.h"
+#include "s3fs.h"
+#include "curl_balancer.h"
+#include "string_util.h"
+#include "autolock.h"
+
+//------------------------------------------------
+// Utility
+//------------------------------------------------
+// Returns the host name without the port
+static std::string get_balancer_hostname(const std::string& bucket_host)
+{
+    if(!bucket_host.empty() && '[' == bucket_host[0]){
+        std::string::size_type pos = bucket_host.find(']');
+        return (std::string::npos == pos ? bucket_host : bucket_host.substr(1, pos - 1));
+    }
+    return bucket_host.substr(0, bucket_host.find(':'));
+}
+
+//------------------------------------------------
+// Class CurlEndpointBalancer
+//------------------------------------------------
+CurlEndpointBalancer CurlEndpointBalancer::singleton;
+pthread_mutex_t      CurlEndpointBalancer::balancer_lock;
+bool                 CurlEndpointBalancer::is_enabled = false;
+std::string          CurlEndpointBalancer::conf_targets;
+const int            CurlEndpointBalancer::EJECT_FAILURES;
+const time_t         CurlEndpointBalancer::EJECT_TIME;
+const time_t         CurlEndpointBalancer::MAX_EJECT_TIME;
+const time_t         CurlEndpointBalancer::PROBE_INTERVAL;
+const time_t         CurlEndpointBalancer::RESOLVE_INTERVAL;
+
+CurlEndpointBalancer::CurlEndpointBalancer() : resolved_time(0), is_resolving(false)
+{
+    if(this == &CurlEndpointBalancer::singleton){
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+        int result;
+        if(0 != (result = pthread_mutex_init(&CurlEndpointBalancer::balancer_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init balancer_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+CurlEndpointBalancer::~CurlEndpointBalancer()
+{
+    if(this == &CurlEndpointBalancer::singleton){
+        int result = pthread_mutex_destroy(&CurlEndpointBalancer::balancer_lock);
+        if(result != 0){
+            S3FS_PRN_CRIT("failed to destroy balancer_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+bool CurlEndpointBalancer::SetEnabled(bool flag)
+{
+    bool old = CurlEndpointBalancer::is_enabled;
+    CurlEndpointBalancer::is_enabled = flag;
+    return old;
+}
+
+void CurlEndpointBalancer::SetTargets(const char* targets)
+{
+    CurlEndpointBalancer::conf_targets = targets ? targets : "";
+    CurlEndpointBalancer::is_enabled   = !CurlEndpointBalancer::conf_targets.empty();
+}
+
+//
+// Get the addresses of the host, or the addresses by the option.
+//
+bool CurlEndpointBalancer::ResolveTargets(const std::string& host, curl_targets_t& resolved)
+{
+    if(!CurlEndpointBalancer::conf_targets.empty()){
+        std::string::size_type pos = 0;
+        while(pos <= CurlEndpointBalancer::conf_targets.size()){
+            std::string::size_type next = CurlEndpointBalancer::conf_targets.find(',', pos);
+            if(std::string::npos == next){
+                next = CurlEndpointBalancer::conf_targets.size();
+            }
+            std::string target = trim(CurlEndpointBalancer::conf_targets.substr(pos, next - pos));
+            if(!target.empty()){
+                resolved[target] = curl_target_t();
+            }
+            pos = next + 1;
+        }
+        return !resolved.empty();
+    }
+
+    struct addrinfo  hints;
+    struct addrinfo* res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int result;
+    if(0 != (result = getaddrinfo(host.c_str(), NULL, &hints, &res))){
+        S3FS_PRN_WARN("could not resolve %s for balancing: %s", host.c_str(), gai_strerror(result));
+        return false;
+    }
+    for(struct addrinfo* ai = res; ai; ai = ai->ai_next){
+        char        addr[INET6_ADDRSTRLEN];
+        const void* paddr;
+        if(AF_INET == ai->ai_family){
+            paddr = &(reinterpret_cast<struct sockaddr_in*>(ai->ai_addr)->sin_addr);
+        }else if(AF_INET6 == ai->ai_family){
+            paddr = &(reinterpret_cast<struct sockaddr_in6*>(ai->ai_addr)->sin6_addr);
+        }else{
+            continue;
+        }
+        if(inet_ntop(ai->ai_family, paddr, addr, sizeof(addr))){
+            // IPv6 address must be enclosed in brackets for CURLOPT_CONNECT_TO
+            resolved[AF_INET6 == ai->ai_family ? std::string("[") + addr + "]" : std::string(addr)] = curl_target_t();
+        }
+    }
+    freeaddrinfo(res);
+    return !resolved.empty();
+}
+
+//
+// Replace the addresses with the resolved ones, the statistics of the
+// addresses which still exist are kept.
+//
+void CurlEndpointBalancer::UpdateTargets(const curl_targets_t& resolved)
+{
+    AutoLock auto_lock(&CurlEndpointBalancer::balancer_lock);
+
+    CurlEndpointBalancer& balancer = CurlEndpointBalancer::singleton;
+    curl_targets_t        targets;
+    for(curl_targets_t::const_iterator iter = resolved.begin(); iter != resolved.end(); ++iter){
+        curl_targets_t::const_iterator old = balancer.targets.find(iter->first);
+        targets[iter->first] = (old != balancer.targets.end() ? old->second : iter->second);
+    }
+    if(balancer.targets.size() != targets.size()){
+        S3FS_PRN_INFO("addresses of %s for balancing: %zu -> %zu", balancer.host.c_str(), balancer.targets.size(), targets.size());
+    }
+    balancer.targets.swap(targets);
+}
+
+void* CurlEndpointBalancer::ResolveWorker(void* arg)
+{
+    std::string*   phost = static_cast<std::string*>(arg);
+    curl_targets_t resolved;
+    if(CurlEndpointBalancer::ResolveTargets(*phost, resolved)){
+        CurlEndpointBalancer::UpdateTargets(resolved);
+    }
+    delete phost;
+
+    AutoLock auto_lock(&CurlEndpointBalancer::balancer_lock);
+    CurlEndpointBalancer::singleton.resolved_time = time(0);
+    CurlEndpointBalancer::singleton.is_resolving  = false;
+    return NULL;
+}
+
+//
+// This is called after the bucket host is fixed.
+//
+bool CurlEndpointBalancer::Initialize(const std::string& bucket_host)
+{
+    if(!CurlEndpointBalancer::is_enabled){
+        return true;
+    }
+#if LIBCURL_VERSION_NUM < 0x073100
+    S3FS_PRN_WARN("balancing the requests across the addresses needs libcurl 7.49.0 or later, then it is disabled.");
+    CurlEndpointBalancer::is_enabled = false;
+    return true;
+#else
+    std::string    hostname = get_balancer_hostname(bucket_host);
+    curl_targets_t resolved;
+    if(!CurlEndpointBalancer::ResolveTargets(hostname, resolved)){
+        S3FS_PRN_ERR("could not get the addresses of %s for balancing.", hostname.c_str());
+        return false;
+    }
+    {
+        AutoLock auto_lock(&CurlEndpointBalancer::balancer_lock);
+        CurlEndpointBalancer::singleton.host          = hostname;
+        CurlEndpointBalancer::singleton.resolved_time = time(0);
+    }
+    CurlEndpointBalancer::UpdateTargets(resolved);
+    return true;
+#endif
+}
+
+long CurlEndpointBalancer::GetScore(const curl_target_t& target, time_t now)
+{
+    long latency = (CurlEndpointBalancer::PROBE_INTERVAL < (now - target.last_time) ? 0 : target.latency);
+    return latency * (target.inflight + 1);
+}
+
+//
+// Pick the address for the request, and set the value for
+// CURLOPT_CONNECT_TO to connect_to. Release or Cancel must be called
+// with the address after the request.
+//
+// Returns false if the requests are not balanced.
+//
+bool CurlEndpointBalancer::GetTarget(std::string& target, std::string& connect_to)
+{
+    if(!CurlEndpointBalancer::is_enabled){
+        return false;
+    }
+    AutoLock auto_lock(&CurlEndpointBalancer::balancer_lock);
+
+    CurlEndpointBalancer& balancer = CurlEndpointBalancer::singleton;
+    time_t                now      = time(0);
+
+    // the addresses are resolved again in the background
+    if(CurlEndpointBalancer::conf_targets.empty() && !balancer.is_resolving && !balancer.host.empty() && CurlEndpointBalancer::RESOLVE_INTERVAL < (now - balancer.resolved_time)){
+        pthread_attr_t attr;
+        pthread_t      thread;
+        std::string*   phost = new std::string(balancer.host);
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if(0 == pthread_create(&thread, &attr, CurlEndpointBalancer::ResolveWorker, phost)){
+            balancer.is_resolving = true;
+        }else{
+            S3FS_PRN_WARN("failed to create the thread for resolving %s.", balancer.host.c_str());
+            balancer.resolved_time = now;
+            delete phost;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    // a resolved address is not balanced
+    if(balancer.targets.empty() || (CurlEndpointBalancer::conf_targets.empty() && 1 == balancer.targets.size())){
+        return false;
+    }
+
+    std::vector<curl_targets_t::iterator> healthy;
+    curl_targets_t::iterator              earliest = balancer.targets.end();
+    for(curl_targets_t::iterator iter = balancer.targets.begin(); iter != balancer.targets.end(); ++iter){
+        if(iter->second.eject_until <= now){
+            healthy.push_back(iter);
+        }else if(earliest == balancer.targets.end() || iter->second.eject_until < earliest->second.eject_until){
+            earliest = iter;
+        }
+    }
+
+    curl_targets_t::iterator pick;
+    if(healthy.empty()){
+        pick = earliest;
+    }else if(1 == healthy.size()){
+        pick = healthy[0];
+    }else{
+        size_t first  = random() % healthy.size();
+        size_t second = (first + 1 + random() % (healthy.size() - 1)) % healthy.size();
+        pick          = (CurlEndpointBalancer::GetScore(healthy[second]->second, now) < CurlEndpointBalancer::GetScore(healthy[first]->second, now) ? healthy[second] : healthy[first]);
+    }
+    ++(pick->second.inflight);
+    ++(pick->second.requests);
+
+    target     = pick->first;
+    connect_to = balancer.host + "::" + pick->first + ":";
+    return true;
+}
+
+void CurlEndpointBalancer::Release(const std::string& target, bool is_success, long latency)
+{
+    AutoLock auto_lock(&CurlEndpointBalancer::balancer_lock);
+
+    CurlEndpointBalancer&    balancer = CurlEndpointBalancer::singleton;
+    curl_targets_t::iterator iter     = balancer.targets.find(target);
+    if(iter == balancer.targets.end()){
+        // the address was removed by resolving again
+        return;
+    }
+    curl_target_t& ct  = iter->second;
+    time_t          now = time(0);
+    if(0 < ct.inflight){
+        --ct.inflight;
+    }
+
+    if(is_success){
+        latency      = std::max(1L, latency);
+        ct.latency   = ((0 == ct.latency || CurlEndpointBalancer::PROBE_INTERVAL < (now - ct.last_time)) ? latency : (ct.latency * 4 + latency) / 5);
+        ct.last_time = now;
+        ct.failures  = 0;
+        ct.ejections = 0;
+        return;
+    }
+
+    ++ct.errors;
+    if(++ct.failures < CurlEndpointBalancer::EJECT_FAILURES || now < ct.eject_until){
+        return;
+    }
+    time_t eject_time = CurlEndpointBalancer::EJECT_TIME;
+    for(int cnt = 0; cnt < ct.ejections && eject_time < CurlEndpointBalancer::MAX_EJECT_TIME; ++cnt){
+        eject_time *= 2;
+    }
+    eject_time     = std::min(eject_time, CurlEndpointBalancer::MAX_EJECT_TIME);
+    ct.eject_until = now + eject_time;
+    ct.failures    = 0;
+    ++ct.ejections;
+    S3FS_PRN_WARN("address %s of %s is not used for %lld sec because of the errors(%ld errors in %ld requests).", target.c_str(), balancer.host.c_str(), static_cast<long long>(eject_time), ct.errors, ct.requests);
+}
+
+//
+// The request was not sent, or it was cancelled.
+//
+void CurlEndpointBalancer::Cancel(const std::string& target)
+{
+    AutoLock auto_lock(&CurlEndpointBalancer::balancer_lock);
+
+    curl_targets_t::iterator iter = CurlEndpointBalancer::singleton.targets.find(target);
+    if(iter != CurlEndpointBalancer::singleton.targets.end() && 0 < iter->second.inflight){
+        --(iter->second.inflight);
+    }
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,113 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_BALANCER_H_
+#define S3FS_CURL_BALANCER_H_
+
+#include <ctime>
+#include <map>
+#include <string>
+
+//------------------------------------------------
+// Structures
+//------------------------------------------------
+struct curl_target_t
+{
+    long    latency;            // ms, EWMA of the time to the first byte(0 means not measured)
+    time_t  last_time;          // last time the latency was measured
+    int     inflight;
+    int     failures;           // consecutive failures
+    int     ejections;          // consecutive ejections, the ejection time is doubled by each
+    time_t  eject_until;
+    long    requests;
+    long    errors;
+
+    curl_target_t() : latency(0), last_time(0), inflight(0), failures(0), ejections(0), eject_until(0), requests(0), errors(0) {}
+};
+
+typedef std::map<std::string, curl_target_t> curl_targets_t;
+
+//------------------------------------------------
+// Class CurlEndpointBalancer
+//------------------------------------------------
+// This class spreads the requests to the bucket host across the addresses
+// of it, which are the A(AAAA) records of the host or the addresses
+// specified by the endpoint_targets option.
+//
+// The address is picked by the power of two choices: two healthy
+// addresses are picked at random and the one which has the lower latency
+// times the requests in flight is used. The address which was not used for
+// PROBE_INTERVAL is regarded as not measured, so that it is tried again.
+// The address which failed EJECT_FAILURES times in a row is not used for
+// EJECT_TIME, and the time is doubled by each ejection up to
+// MAX_EJECT_TIME. If all addresses are ejected, the one which is released
+// first is used.
+//
+// The address is given to libcurl by CURLOPT_CONNECT_TO, because
+// CURLOPT_RESOLVE changes the DNS cache which is shared by all handles.
+//
+class CurlEndpointBalancer
+{
+    private:
+        static CurlEndpointBalancer singleton;
+        static pthread_mutex_t      balancer_lock;
+        static bool                 is_enabled;
+        static std::string          conf_targets;   // comma separated addresses by the option
+        std::string                 host;
+        curl_targets_t              targets;
+        time_t                      resolved_time;
+        bool                        is_resolving;
+
+    private:
+        CurlEndpointBalancer();
+        ~CurlEndpointBalancer();
+
+        static bool ResolveTargets(const std::string& host, curl_targets_t& resolved);
+        static void* ResolveWorker(void* arg);
+        static void UpdateTargets(const curl_targets_t& resolved);
+        static long GetScore(const curl_target_t& target, time_t now);
+
+    public:
+        static const int    EJECT_FAILURES   = 3;
+        static const time_t EJECT_TIME       = 10;
+        static const time_t MAX_EJECT_TIME   = 300;
+        static const time_t PROBE_INTERVAL   = 10;
+        static const time_t RESOLVE_INTERVAL = 60;
+
+        static bool SetEnabled(bool flag);
+        static bool IsEnabled() { return CurlEndpointBalancer::is_enabled; }
+        static void SetTargets(const char* targets);
+
+        static bool Initialize(const std::string& bucket_host);
+        static bool GetTarget(std::string& target, std::string& connect_to);
+        static void Release(const std::string& target, bool is_success, long latency);
+        static void Cancel(const std::string& target);
+};
+
+#endif // S3FS_CURL_BALANCER_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,242 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <errno.h>
+#include <algorithm>
+
+#include "common.h"
+#include "s3fs.h"
+#include "curl_concurrency.h"
+#include "curl.h"
+#include "autolock.h"
+
+//------------------------------------------------
+// Utility
+//------------------------------------------------
+static void get_concurrency_time(struct timespec& ts)
+{
+    if(-1 == clock_gettime(CLOCK_MONOTONIC, &ts)){
+        S3FS_PRN_CRIT("clock_gettime failed: %d", errno);
+        abort();
+    }
+}
+
+// returns milliseconds from ts1 to ts2
+static long diff_concurrency_time(const struct timespec& ts1, const struct timespec& ts2)
+{
+    return (ts2.tv_sec - ts1.tv_sec) * 1000 + (ts2.tv_nsec - ts1.tv_nsec) / (1000 * 1000);
+}
+
+//------------------------------------------------
+// Class CurlConcurrency
+//------------------------------------------------
+CurlConcurrency CurlConcurrency::singleton;
+pthread_mutex_t CurlConcurrency::concurrency_lock;
+bool            CurlConcurrency::is_enabled = false;
+const int       CurlConcurrency::MAX_RATIO;
+const long      CurlConcurrency::DECREASE_INTERVAL_MS;
+const long      CurlConcurrency::LATENCY_RATIO;
+const time_t    CurlConcurrency::MIN_LATENCY_PERIOD;
+
+CurlConcurrency::CurlConcurrency()
+{
+    if(this == &CurlConcurrency::singleton){
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+        int result;
+        if(0 != (result = pthread_mutex_init(&CurlConcurrency::concurrency_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init concurrency_lock: %d", result);
+            abort();
+        }
+        for(int cnt = 0; cnt < CURL_REQ_CLASS_COUNT; ++cnt){
+            if(0 != (result = pthread_cond_init(&classes[cnt].cond, NULL))){
+                S3FS_PRN_CRIT("failed to init concurrency cond: %d", result);
+                abort();
+            }
+        }
+    }else{
+        abort();
+    }
+}
+
+CurlConcurrency::~CurlConcurrency()
+{
+    if(this == &CurlConcurrency::singleton){
+        int result;
+        for(int cnt = 0; cnt < CURL_REQ_CLASS_COUNT; ++cnt){
+            if(0 != (result = pthread_cond_destroy(&classes[cnt].cond))){
+                S3FS_PRN_CRIT("failed to destroy concurrency cond: %d", result);
+                abort();
+            }
+        }
+        if(0 != (result = pthread_mutex_destroy(&CurlConcurrency::concurrency_lock))){
+            S3FS_PRN_CRIT("failed to destroy concurrency_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+const char* CurlConcurrency::GetClassName(curl_req_class_t reqclass)
+{
+    switch(reqclass){
+        case CURL_REQ_META:
+            return "meta";
+        case CURL_REQ_READ:
+            return "read";
+        case CURL_REQ_WRITE:
+            return "write";
+        case CURL_REQ_PREFETCH:
+            return "prefetch";
+        default:
+            break;
+    }
+    return "unknown";
+}
+
+bool CurlConcurrency::SetEnabled(bool flag)
+{
+    bool old = CurlConcurrency::is_enabled;
+    CurlConcurrency::is_enabled = flag;
+    return old;
+}
+
+//
+// Set the initial limit and the maximum limit.
+// This must be called before any requests are sent.
+//
+void CurlConcurrency::SetLimit(curl_req_class_t reqclass, int limit, int max_limit)
+{
+    AutoLock auto_lock(&CurlConcurrency::concurrency_lock);
+
+    curl_concurrency_t& cc = CurlConcurrency::singleton.classes[reqclass];
+    cc.max_limit           = std::max(1, max_limit);
+    cc.limit               = static_cast<double>(std::min(std::max(1, limit), cc.max_limit));
+}
+
+int CurlConcurrency::GetLimit(curl_req_class_t reqclass)
+{
+    AutoLock auto_lock(&CurlConcurrency::concurrency_lock);
+
+    return static_cast<int>(CurlConcurrency::singleton.classes[reqclass].limit);
+}
+
+//
+// Returns the number of requests which the caller may send at the same
+// time, the actual number is limited by Acquire.
+//
+int CurlConcurrency::GetParallelism(int parallelism)
+{
+    return (CurlConcurrency::is_enabled ? parallelism * CurlConcurrency::MAX_RATIO : parallelism);
+}
+
+//
+// Wait until the number of in-flight requests of the class is less than
+// the limit. Release must be called after the request is finished.
+//
+void CurlConcurrency::Acquire(curl_req_class_t reqclass)
+{
+    if(!CurlConcurrency::is_enabled){
+        return;
+    }
+    AutoLock auto_lock(&CurlConcurrency::concurrency_lock);
+
+    curl_concurrency_t& cc = CurlConcurrency::singleton.classes[reqclass];
+    while(static_cast<int>(cc.limit) <= cc.inflight){
+        pthread_cond_wait(&cc.cond, &CurlConcurrency::concurrency_lock);
+    }
+    ++cc.inflight;
+}
+
+//
+// Take the slot only if the number of in-flight requests is less than the
+// limit now. Returns true if the slot is taken(or this is disabled).
+//
+bool CurlConcurrency::TryAcquire(curl_req_class_t reqclass)
+{
+    if(!CurlConcurrency::is_enabled){
+        return true;
+    }
+    AutoLock auto_lock(&CurlConcurrency::concurrency_lock);
+
+    curl_concurrency_t& cc = CurlConcurrency::singleton.classes[reqclass];
+    if(static_cast<int>(cc.limit) <= cc.inflight){
+        return false;
+    }
+    ++cc.inflight;
+    return true;
+}
+
+void CurlConcurrency::Release(curl_req_class_t reqclass, const S3fsCurl* s3fscurl, int result)
+{
+    if(!CurlConcurrency::is_enabled){
+        return;
+    }
+    AutoLock auto_lock(&CurlConcurrency::concurrency_lock);
+
+    curl_concurrency_t& cc       = CurlConcurrency::singleton.classes[reqclass];
+    int                 oldlimit = static_cast<int>(cc.limit);
+    bool                is_full  = (oldlimit <= cc.inflight);
+
+    if(0 < cc.inflight){
+        --cc.inflight;
+    }
+
+    if(s3fscurl && s3fscurl->IsCongested()){
+        // multiplicative decrease, but only once for the requests in flight at the same time
+        struct timespec now;
+        get_concurrency_time(now);
+        if(0 == cc.last_decrease.tv_sec || CurlConcurrency::DECREASE_INTERVAL_MS <= diff_concurrency_time(cc.last_decrease, now)){
+            cc.limit         = std::max(1.0, cc.limit / 2);
+            cc.last_decrease = now;
+        }
+    }else if(s3fscurl && 0 == result){
+        long   latency = s3fscurl->GetPerformTime();
+        time_t now     = time(0);
+        if(0 == cc.min_latency || latency < cc.min_latency || CurlConcurrency::MIN_LATENCY_PERIOD < (now - cc.min_latency_time)){
+            cc.min_latency      = std::max(1L, latency);
+            cc.min_latency_time = now;
+        }
+        // additive increase, only when the limit is used up and the latency is not growing
+        if(is_full && latency <= cc.min_latency * CurlConcurrency::LATENCY_RATIO){
+            cc.limit = std::min(static_cast<double>(cc.max_limit), cc.limit + 1.0 / cc.limit);
+        }
+    }
+
+    if(oldlimit != static_cast<int>(cc.limit)){
+        S3FS_PRN_INFO("concurrency limit of %s requests is changed: %d -> %d", CurlConcurrency::GetClassName(reqclass), oldlimit, static_cast<int>(cc.limit));
+    }
+    pthread_cond_broadcast(&cc.cond);
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
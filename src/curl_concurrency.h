@@ -0,0 +1,111 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_CONCURRENCY_H_
+#define S3FS_CURL_CONCURRENCY_H_
+
+#include <ctime>
+
+class S3fsCurl;
+
+//------------------------------------------------
+// Structures
+//------------------------------------------------
+enum curl_req_class_t {
+    CURL_REQ_META = 0,          // HEAD, listing, delete and so on
+    CURL_REQ_READ,              // GET object(range)
+    CURL_REQ_WRITE,             // PUT object, multipart upload and copy
+    CURL_REQ_PREFETCH,          // prefetch for direct read
+    CURL_REQ_CLASS_COUNT
+};
+
+struct curl_concurrency_t
+{
+    int             max_limit;
+    double          limit;              // in-flight request limit, it is changed by AIMD
+    int             inflight;
+    long            min_latency;        // ms, the minimum latency in the recent period
+    time_t          min_latency_time;
+    struct timespec last_decrease;
+    pthread_cond_t  cond;
+
+    curl_concurrency_t() : max_limit(1), limit(1.0), inflight(0), min_latency(0), min_latency_time(0)
+    {
+        last_decrease.tv_sec  = 0;
+        last_decrease.tv_nsec = 0;
+    }
+};
+
+//------------------------------------------------
+// Class CurlConcurrency
+//------------------------------------------------
+// This class limits the number of in-flight requests for each request
+// class, and adjusts the limits by additive increase and multiplicative
+// decrease(AIMD).
+//
+// The limit starts at the value by the options(multireq_max,
+// parallel_count and direct_read_prefetch_thread), and it can be up to
+// MAX_RATIO times it. When a request is throttled or timed out, the limit
+// is halved at most once in DECREASE_INTERVAL. When a request succeeded
+// while all of the limit was used and its latency was not much longer than
+// the recent minimum, the limit is increased by 1/limit, that is about one
+// for each round of requests.
+//
+class CurlConcurrency
+{
+    private:
+        static CurlConcurrency singleton;
+        static pthread_mutex_t concurrency_lock;
+        static bool            is_enabled;
+        curl_concurrency_t     classes[CURL_REQ_CLASS_COUNT];
+
+    private:
+        CurlConcurrency();
+        ~CurlConcurrency();
+
+        static const char* GetClassName(curl_req_class_t reqclass);
+
+    public:
+        static const int    MAX_RATIO            = 2;
+        static const long   DECREASE_INTERVAL_MS = 1000;
+        static const long   LATENCY_RATIO        = 2;
+        static const time_t MIN_LATENCY_PERIOD   = 60;
+
+        static bool SetEnabled(bool flag);
+        static bool IsEnabled() { return CurlConcurrency::is_enabled; }
+        static void SetLimit(curl_req_class_t reqclass, int limit, int max_limit);
+        static int GetLimit(curl_req_class_t reqclass);
+        static int GetParallelism(int parallelism);
+
+        static void Acquire(curl_req_class_t reqclass);
+        static bool TryAcquire(curl_req_class_t reqclass);
+        static void Release(curl_req_class_t reqclass, const S3fsCurl* s3fscurl, int result);
+};
+
+#endif // S3FS_CURL_CONCURRENCY_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
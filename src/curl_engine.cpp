@@ -0,0 +1,681 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "common.h"
+#include "s3fs.h"
+#include "curl_engine.h"
+#include "curl.h"
+#include "autolock.h"
+
+// (HAVE_SYS_EPOLL_H is defined in config.h)
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+//------------------------------------------------
+// Symbols
+//------------------------------------------------
+static const int CURL_ENGINE_MAX_EVENTS  = 64;
+static const int CURL_ENGINE_MAX_WAIT_MS = 1000;   // wait time limit for epoll_wait
+
+//------------------------------------------------
+// Utility
+//------------------------------------------------
+static void get_engine_time(struct timespec& ts)
+{
+    if(-1 == clock_gettime(CLOCK_MONOTONIC, &ts)){
+        S3FS_PRN_CRIT("clock_gettime failed: %d", errno);
+        abort();
+    }
+}
+
+static void add_engine_time(struct timespec& ts, long msec)
+{
+    ts.tv_sec  += msec / 1000;
+    ts.tv_nsec += (msec % 1000) * 1000 * 1000;
+    if(1000 * 1000 * 1000 <= ts.tv_nsec){
+        ts.tv_sec  += 1;
+        ts.tv_nsec -= 1000 * 1000 * 1000;
+    }
+}
+
+// returns milliseconds from ts1 to ts2, it is 0 if ts2 is past.
+static long diff_engine_time(const struct timespec& ts1, const struct timespec& ts2)
+{
+    long msec = (ts2.tv_sec - ts1.tv_sec) * 1000 + (ts2.tv_nsec - ts1.tv_nsec) / (1000 * 1000);
+    return (0 < msec ? msec : 0);
+}
+
+//------------------------------------------------
+// curl_io_thread methods
+//------------------------------------------------
+curl_io_thread::curl_io_thread() : hMulti(NULL), epoll_fd(-1), is_exit(false), is_timer(false)
+{
+    wakeup_fd[0]  = -1;
+    wakeup_fd[1]  = -1;
+    timer.tv_sec  = 0;
+    timer.tv_nsec = 0;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    pthread_mutex_init(&lock, &attr);
+}
+
+curl_io_thread::~curl_io_thread()
+{
+    if(hMulti){
+        curl_multi_cleanup(hMulti);
+    }
+    if(-1 != epoll_fd){
+        close(epoll_fd);
+    }
+    if(-1 != wakeup_fd[0]){
+        close(wakeup_fd[0]);
+    }
+    if(-1 != wakeup_fd[1]){
+        close(wakeup_fd[1]);
+    }
+    pthread_mutex_destroy(&lock);
+}
+
+//------------------------------------------------
+// CurlMultiEngine class variables
+//------------------------------------------------
+CurlMultiEngine* CurlMultiEngine::singleton    = NULL;
+int              CurlMultiEngine::thread_count = 2;     // default
+
+//------------------------------------------------
+// CurlMultiEngine class methods
+//------------------------------------------------
+bool CurlMultiEngine::Initialize()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if(CurlMultiEngine::singleton){
+        S3FS_PRN_WARN("Already singleton for curl multi engine is existed, then re-create it.");
+        CurlMultiEngine::Destroy();
+    }
+    if(0 >= CurlMultiEngine::thread_count){
+        return false;
+    }
+    CurlMultiEngine* pengine = new CurlMultiEngine(CurlMultiEngine::thread_count);
+    if(pengine->iothreads.empty()){
+        S3FS_PRN_ERR("Could not start any I/O thread for curl multi engine.");
+        delete pengine;
+        return false;
+    }
+    CurlMultiEngine::singleton = pengine;
+    return true;
+#else
+    S3FS_PRN_WARN("curl multi engine needs epoll, then requests are sent by a thread per request.");
+    return false;
+#endif
+}
+
+void CurlMultiEngine::Destroy()
+{
+    if(CurlMultiEngine::singleton){
+        delete CurlMultiEngine::singleton;
+        CurlMultiEngine::singleton = NULL;
+    }
+}
+
+int CurlMultiEngine::SetThreadCount(int count)
+{
+    int old = CurlMultiEngine::thread_count;
+    CurlMultiEngine::thread_count = count;
+    return old;
+}
+
+//
+// Send the request by one of the I/O threads.
+//
+// The request is set up with its curl handle as same as calling
+// RequestPerform, and the callback is called with the result after the
+// request is finished. If this returns false, the callback is not called.
+//
+// The lazy setup and the signing are done in this thread, because the
+// signing may refresh the credentials by a request and it must not block
+// the other transfers in the I/O thread.
+//
+bool CurlMultiEngine::Request(S3fsCurl* s3fscurl, curl_engine_callback callback, void* param)
+{
+    if(!s3fscurl){
+        return false;
+    }
+    if(!CurlMultiEngine::singleton){
+        S3FS_PRN_ERR("The singleton object is not initialized yet.");
+        return false;
+    }
+    if(s3fscurl->fpLazySetup && !s3fscurl->fpLazySetup(s3fscurl)){
+        S3FS_PRN_ERR("Failed to lazy setup.");
+        return false;
+    }
+    s3fscurl->LastResponseCode = S3fsCurl::S3FSCURL_RESPONSECODE_NOTSET;
+    if(!s3fscurl->PreparePerform(false, 0)){
+        return false;
+    }
+
+    curl_engine_request* preq = new curl_engine_request(s3fscurl, callback, param);
+    if(!CurlMultiEngine::singleton->AddRequest(preq)){
+        delete preq;
+        return false;
+    }
+    return true;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+void* CurlMultiEngine::IoThread(void* arg)
+{
+    curl_io_thread*    piot = static_cast<curl_io_thread*>(arg);
+    struct epoll_event events[CURL_ENGINE_MAX_EVENTS];
+
+    S3FS_PRN_INFO3("Start I/O thread for curl multi engine.");
+
+    while(true){
+        {
+            AutoLock auto_lock(&piot->lock);
+            if(piot->is_exit){
+                break;
+            }
+        }
+        CurlMultiEngine::ProcessRequests(piot);
+
+        int count = epoll_wait(piot->epoll_fd, events, CURL_ENGINE_MAX_EVENTS, CurlMultiEngine::GetWaitTime(piot));
+        if(-1 == count){
+            if(EINTR != errno){
+                S3FS_PRN_ERR("epoll_wait failed: %d", errno);
+            }
+            continue;
+        }
+
+        int running_handles = 0;
+        for(int cnt = 0; cnt < count; ++cnt){
+            if(events[cnt].data.fd == piot->wakeup_fd[0]){
+                char buf[64];
+                while(0 < read(piot->wakeup_fd[0], buf, sizeof(buf)));
+                continue;
+            }
+            int action = 0;
+            if(events[cnt].events & EPOLLIN){
+                action |= CURL_CSELECT_IN;
+            }
+            if(events[cnt].events & EPOLLOUT){
+                action |= CURL_CSELECT_OUT;
+            }
+            if(events[cnt].events & (EPOLLERR | EPOLLHUP)){
+                action |= CURL_CSELECT_ERR;
+            }
+            curl_multi_socket_action(piot->hMulti, events[cnt].data.fd, action, &running_handles);
+        }
+        if(piot->is_timer){
+            struct timespec now;
+            get_engine_time(now);
+            if(0 == diff_engine_time(now, piot->timer)){
+                piot->is_timer = false;
+                curl_multi_socket_action(piot->hMulti, CURL_SOCKET_TIMEOUT, 0, &running_handles);
+            }
+        }
+        CurlMultiEngine::ProcessMessages(piot);
+    }
+    CurlMultiEngine::CancelRequests(piot);
+
+    S3FS_PRN_INFO3("Exit I/O thread for curl multi engine.");
+    return NULL;
+}
+
+int CurlMultiEngine::SocketCallback(CURL* hCurl, curl_socket_t sock, int what, void* userp, void* socketp)
+{
+    curl_io_thread* piot = static_cast<curl_io_thread*>(userp);
+
+    if(CURL_POLL_REMOVE == what){
+        // the socket may be already closed, then the error is ignored.
+        epoll_ctl(piot->epoll_fd, EPOLL_CTL_DEL, sock, NULL);
+        return 0;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = ((what & CURL_POLL_IN) ? EPOLLIN : 0) | ((what & CURL_POLL_OUT) ? EPOLLOUT : 0);
+    ev.data.fd = sock;
+
+    if(!socketp){
+        if(0 != epoll_ctl(piot->epoll_fd, EPOLL_CTL_ADD, sock, &ev) && EEXIST == errno){
+            epoll_ctl(piot->epoll_fd, EPOLL_CTL_MOD, sock, &ev);
+        }
+        curl_multi_assign(piot->hMulti, sock, piot);
+    }else{
+        if(0 != epoll_ctl(piot->epoll_fd, EPOLL_CTL_MOD, sock, &ev) && ENOENT == errno){
+            epoll_ctl(piot->epoll_fd, EPOLL_CTL_ADD, sock, &ev);
+        }
+    }
+    return 0;
+}
+
+int CurlMultiEngine::TimerCallback(CURLM* hMulti, long timeout_ms, void* userp)
+{
+    curl_io_thread* piot = static_cast<curl_io_thread*>(userp);
+
+    if(timeout_ms < 0){
+        piot->is_timer = false;
+    }else{
+        get_engine_time(piot->timer);
+        add_engine_time(piot->timer, timeout_ms);
+        piot->is_timer = true;
+    }
+    return 0;
+}
+
+void CurlMultiEngine::WakeUp(curl_io_thread* piot)
+{
+    // the pipe is non-blocking, and it is enough that one byte is in it.
+    if(-1 == write(piot->wakeup_fd[1], "", 1) && EAGAIN != errno){
+        S3FS_PRN_WARN("Could not wake up I/O thread: %d", errno);
+    }
+}
+
+//
+// Returns the time(ms) for epoll_wait, which is until the timeout of
+// libcurl or the retry time of waiting requests.
+//
+int CurlMultiEngine::GetWaitTime(curl_io_thread* piot)
+{
+    struct timespec now;
+    long            wait = CURL_ENGINE_MAX_WAIT_MS;
+
+    get_engine_time(now);
+    if(piot->is_timer){
+        wait = std::min(wait, diff_engine_time(now, piot->timer));
+    }
+    for(curl_engine_requests_t::const_iterator iter = piot->waiting.begin(); iter != piot->waiting.end(); ++iter){
+        wait = std::min(wait, diff_engine_time(now, (*iter)->retry_time));
+    }
+    return static_cast<int>(wait);
+}
+
+//
+// The request is already prepared(signed), then only adds it.
+//
+void CurlMultiEngine::StartRequest(curl_io_thread* piot, curl_engine_request* preq)
+{
+    S3fsCurl* s3fscurl = preq->s3fscurl;
+
+    CURLMcode code;
+    if(CURLM_OK != (code = curl_multi_add_handle(piot->hMulti, s3fscurl->hCurl))){
+        S3FS_PRN_ERR("curl_multi_add_handle failed: %s", curl_multi_strerror(code));
+        CurlMultiEngine::CompleteRequest(preq, -EIO);
+        return;
+    }
+    piot->running[s3fscurl->hCurl] = preq;
+}
+
+//
+// Check the result of the request as same as RequestPerform, and retry
+// it if needed. The retry which needs to wait is put in the waiting list.
+//
+void CurlMultiEngine::FinishRequest(curl_io_thread* piot, CURL* hCurl, CURLcode code)
+{
+    curl_multi_remove_handle(piot->hMulti, hCurl);
+
+    curl_engine_running_t::iterator iter = piot->running.find(hCurl);
+    if(iter == piot->running.end()){
+        S3FS_PRN_WARN("Unknown curl handle is finished.");
+        return;
+    }
+    curl_engine_request* preq     = iter->second;
+    S3fsCurl*            s3fscurl = preq->s3fscurl;
+    piot->running.erase(iter);
+
+    long responseCode = S3fsCurl::S3FSCURL_RESPONSECODE_NOTSET;
+    long waitms       = 0;
+    int  result;
+
+    s3fscurl->curlCode = code;
+    result             = s3fscurl->ParsePerformResult(preq->retrycnt, responseCode, waitms);
+
+    if(S3fsCurl::S3FSCURL_PERFORM_RESULT_NOTSET == result && ++preq->retrycnt < S3fsCurl::retries){
+        S3FS_PRN_INFO("### retrying...");
+
+        if(!s3fscurl->RemakeHandle()){
+            S3FS_PRN_INFO("Failed to reset handle and internal data for retrying.");
+            result = -EIO;
+        }else if(0 < waitms){
+            get_engine_time(preq->retry_time);
+            add_engine_time(preq->retry_time, waitms);
+            piot->waiting.push_back(preq);
+            return;
+        }else{
+            CurlMultiEngine::RetryRequest(preq);
+            return;
+        }
+    }
+    CurlMultiEngine::CompleteRequest(preq, s3fscurl->FinishPerform(responseCode, result));
+}
+
+void CurlMultiEngine::CompleteRequest(curl_engine_request* preq, int result)
+{
+    S3fsCurl* s3fscurl = preq->s3fscurl;
+
+    s3fscurl->DestroyCurlHandle(true, false);
+    if(preq->callback){
+        preq->callback(s3fscurl, result, preq->param);
+    }
+    delete preq;
+}
+
+//
+// Start the new requests and the waiting requests whose retry time has come.
+//
+void CurlMultiEngine::ProcessRequests(curl_io_thread* piot)
+{
+    curl_engine_requests_t newreqs;
+    {
+        AutoLock auto_lock(&piot->lock);
+        newreqs.swap(piot->requests);
+    }
+    for(curl_engine_requests_t::iterator iter = newreqs.begin(); iter != newreqs.end(); ++iter){
+        CurlMultiEngine::StartRequest(piot, *iter);
+    }
+
+    if(!piot->waiting.empty()){
+        struct timespec now;
+        get_engine_time(now);
+        for(curl_engine_requests_t::iterator iter = piot->waiting.begin(); iter != piot->waiting.end(); ){
+            if(0 == diff_engine_time(now, (*iter)->retry_time)){
+                curl_engine_request* preq = *iter;
+                iter = piot->waiting.erase(iter);
+                CurlMultiEngine::RetryRequest(preq);
+            }else{
+                ++iter;
+            }
+        }
+    }
+}
+
+void CurlMultiEngine::ProcessMessages(curl_io_thread* piot)
+{
+    CURLMsg* msg;
+    int      remains = 0;
+    while(NULL != (msg = curl_multi_info_read(piot->hMulti, &remains))){
+        if(CURLMSG_DONE == msg->msg){
+            CurlMultiEngine::FinishRequest(piot, msg->easy_handle, msg->data.result);
+        }
+    }
+}
+
+//
+// All requests in the thread are finished with EIO at exiting.
+//
+void CurlMultiEngine::CancelRequests(curl_io_thread* piot)
+{
+    for(curl_engine_running_t::iterator iter = piot->running.begin(); iter != piot->running.end(); ++iter){
+        curl_multi_remove_handle(piot->hMulti, iter->first);
+        CurlMultiEngine::CompleteRequest(iter->second, -EIO);
+    }
+    piot->running.clear();
+
+    for(curl_engine_requests_t::iterator iter = piot->waiting.begin(); iter != piot->waiting.end(); ++iter){
+        CurlMultiEngine::CompleteRequest(*iter, -EIO);
+    }
+    piot->waiting.clear();
+
+    curl_engine_requests_t newreqs;
+    {
+        AutoLock auto_lock(&piot->lock);
+        newreqs.swap(piot->requests);
+    }
+    for(curl_engine_requests_t::iterator iter = newreqs.begin(); iter != newreqs.end(); ++iter){
+        CurlMultiEngine::CompleteRequest(*iter, -EIO);
+    }
+}
+
+//
+// The retry is signed again in the prepare thread instead of the I/O
+// thread, and then it is sent as a new request.
+//
+void CurlMultiEngine::RetryRequest(curl_engine_request* preq)
+{
+    CurlMultiEngine* pengine = CurlMultiEngine::singleton;
+    {
+        AutoLock auto_lock(&pengine->prepare_lock);
+        if(!pengine->is_prepare_exit){
+            pengine->prepares.push_back(preq);
+            pthread_cond_signal(&pengine->prepare_cond);
+            return;
+        }
+    }
+    CurlMultiEngine::CompleteRequest(preq, -EIO);
+}
+
+void* CurlMultiEngine::PrepareThread(void* arg)
+{
+    CurlMultiEngine* pengine = static_cast<CurlMultiEngine*>(arg);
+
+    S3FS_PRN_INFO3("Start prepare thread for curl multi engine.");
+
+    while(true){
+        curl_engine_request* preq;
+        {
+            AutoLock auto_lock(&pengine->prepare_lock);
+            while(pengine->prepares.empty() && !pengine->is_prepare_exit){
+                pthread_cond_wait(&pengine->prepare_cond, &pengine->prepare_lock);
+            }
+            if(pengine->prepares.empty()){
+                break;
+            }
+            preq = pengine->prepares.front();
+            pengine->prepares.pop_front();
+        }
+        if(!preq->s3fscurl->PreparePerform(false, preq->retrycnt) || !pengine->AddRequest(preq)){
+            CurlMultiEngine::CompleteRequest(preq, -EIO);
+        }
+    }
+
+    S3FS_PRN_INFO3("Exit prepare thread for curl multi engine.");
+    return NULL;
+}
+#endif  // HAVE_SYS_EPOLL_H
+
+//------------------------------------------------
+// CurlMultiEngine methods
+//------------------------------------------------
+CurlMultiEngine::CurlMultiEngine(int count) : next_thread(0), is_prepare_thread(false), is_prepare_exit(false)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    pthread_mutex_init(&next_lock, &attr);
+    pthread_mutex_init(&prepare_lock, &attr);
+    pthread_cond_init(&prepare_cond, NULL);
+
+    StartThreads(count);
+}
+
+CurlMultiEngine::~CurlMultiEngine()
+{
+    StopThreads();
+    pthread_cond_destroy(&prepare_cond);
+    pthread_mutex_destroy(&prepare_lock);
+    pthread_mutex_destroy(&next_lock);
+}
+
+bool CurlMultiEngine::StartThreads(int count)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    int result;
+    if(0 != (result = pthread_create(&prepare_thread, NULL, CurlMultiEngine::PrepareThread, this))){
+        S3FS_PRN_ERR("failed pthread_create - rc(%d)", result);
+        return false;
+    }
+    is_prepare_thread = true;
+
+    for(int cnt = 0; cnt < count; ++cnt){
+        curl_io_thread* piot = new curl_io_thread();
+
+        if(NULL == (piot->hMulti = curl_multi_init())){
+            S3FS_PRN_ERR("curl_multi_init failed.");
+            delete piot;
+            return false;
+        }
+        if(-1 == (piot->epoll_fd = epoll_create1(EPOLL_CLOEXEC))){
+            S3FS_PRN_ERR("epoll_create1 failed: %d", errno);
+            delete piot;
+            return false;
+        }
+        if(-1 == pipe(piot->wakeup_fd)){
+            S3FS_PRN_ERR("pipe failed: %d", errno);
+            delete piot;
+            return false;
+        }
+        for(int pos = 0; pos < 2; ++pos){
+            fcntl(piot->wakeup_fd[pos], F_SETFL, fcntl(piot->wakeup_fd[pos], F_GETFL) | O_NONBLOCK);
+            fcntl(piot->wakeup_fd[pos], F_SETFD, FD_CLOEXEC);
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events  = EPOLLIN;
+        ev.data.fd = piot->wakeup_fd[0];
+        if(0 != epoll_ctl(piot->epoll_fd, EPOLL_CTL_ADD, piot->wakeup_fd[0], &ev)){
+            S3FS_PRN_ERR("epoll_ctl failed: %d", errno);
+            delete piot;
+            return false;
+        }
+
+        if(CURLM_OK != curl_multi_setopt(piot->hMulti, CURLMOPT_SOCKETFUNCTION, CurlMultiEngine::SocketCallback) ||
+           CURLM_OK != curl_multi_setopt(piot->hMulti, CURLMOPT_SOCKETDATA, piot) ||
+           CURLM_OK != curl_multi_setopt(piot->hMulti, CURLMOPT_TIMERFUNCTION, CurlMultiEngine::TimerCallback) ||
+           CURLM_OK != curl_multi_setopt(piot->hMulti, CURLMOPT_TIMERDATA, piot) )
+        {
+            S3FS_PRN_ERR("curl_multi_setopt failed.");
+            delete piot;
+            return false;
+        }
+
+        // HTTP/2 streams are multiplexed on a connection up to the limit
+        if(S3fsCurl::IsHttp2()){
+            if(CURLM_OK != curl_multi_setopt(piot->hMulti, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX)){
+                S3FS_PRN_WARN("could not enable multiplexing for HTTP/2.");
+            }
+#if LIBCURL_VERSION_NUM >= 0x074300
+            if(CURLM_OK != curl_multi_setopt(piot->hMulti, CURLMOPT_MAX_CONCURRENT_STREAMS, S3fsCurl::GetHttp2MaxStreams())){
+                S3FS_PRN_WARN("could not set the max concurrent streams for HTTP/2.");
+            }
+#endif
+        }
+
+        if(0 != (result = pthread_create(&piot->thread, NULL, CurlMultiEngine::IoThread, piot))){
+            S3FS_PRN_ERR("failed pthread_create - rc(%d)", result);
+            delete piot;
+            return false;
+        }
+        iothreads.push_back(piot);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CurlMultiEngine::StopThreads()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    for(std::vector<curl_io_thread*>::iterator iter = iothreads.begin(); iter != iothreads.end(); ++iter){
+        {
+            AutoLock auto_lock(&(*iter)->lock);
+            (*iter)->is_exit = true;
+        }
+        CurlMultiEngine::WakeUp(*iter);
+    }
+    for(std::vector<curl_io_thread*>::iterator iter = iothreads.begin(); iter != iothreads.end(); ++iter){
+        void* retval = NULL;
+        int   result;
+        if(0 != (result = pthread_join((*iter)->thread, &retval))){
+            S3FS_PRN_ERR("failed pthread_join - rc(%d)", result);
+        }
+        delete *iter;
+    }
+    iothreads.clear();
+
+    // the retries which are not sent yet are finished with EIO
+    if(is_prepare_thread){
+        {
+            AutoLock auto_lock(&prepare_lock);
+            is_prepare_exit = true;
+            pthread_cond_signal(&prepare_cond);
+        }
+        void* retval = NULL;
+        int   result;
+        if(0 != (result = pthread_join(prepare_thread, &retval))){
+            S3FS_PRN_ERR("failed pthread_join - rc(%d)", result);
+        }
+        is_prepare_thread = false;
+    }
+    for(curl_engine_requests_t::iterator iter = prepares.begin(); iter != prepares.end(); ++iter){
+        CurlMultiEngine::CompleteRequest(*iter, -EIO);
+    }
+    prepares.clear();
+#else
+    iothreads.clear();
+#endif
+}
+
+bool CurlMultiEngine::AddRequest(curl_engine_request* preq)
+{
+    if(iothreads.empty()){
+        return false;
+    }
+    curl_io_thread* piot;
+    {
+        AutoLock auto_lock(&next_lock);
+        piot = iothreads[next_thread++ % iothreads.size()];
+    }
+    {
+        AutoLock auto_lock(&piot->lock);
+        if(piot->is_exit){
+            return false;
+        }
+        piot->requests.push_back(preq);
+    }
+#ifdef HAVE_SYS_EPOLL_H
+    CurlMultiEngine::WakeUp(piot);
+#endif
+    return true;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,150 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_ENGINE_H_
+#define S3FS_CURL_ENGINE_H_
+
+#include <list>
+#include <map>
+#include <vector>
+#include <curl/curl.h>
+
+class S3fsCurl;
+
+//------------------------------------------------
+// Structures
+//------------------------------------------------
+// The callback is called in the I/O thread(or the prepare thread if the
+// retry could not be sent) when the request is finished with all retries.
+// The result is 0 or -errno as same as RequestPerform.
+//
+typedef void (*curl_engine_callback)(S3fsCurl* s3fscurl, int result, void* param);
+
+struct curl_engine_request
+{
+    S3fsCurl*             s3fscurl;
+    curl_engine_callback  callback;
+    void*                 param;
+    int                   retrycnt;
+    struct timespec       retry_time;     // the time to send again after waiting
+
+    curl_engine_request(S3fsCurl* s3fscurl, curl_engine_callback callback, void* param) : s3fscurl(s3fscurl), callback(callback), param(param), retrycnt(0)
+    {
+        retry_time.tv_sec  = 0;
+        retry_time.tv_nsec = 0;
+    }
+};
+
+typedef std::list<curl_engine_request*>       curl_engine_requests_t;
+typedef std::map<CURL*, curl_engine_request*> curl_engine_running_t;
+
+//
+// One I/O thread has one multi handle and one epoll instance.
+//
+struct curl_io_thread
+{
+    pthread_t               thread;
+    CURLM*                  hMulti;
+    int                     epoll_fd;
+    int                     wakeup_fd[2];   // pipe for waking up the thread
+    bool                    is_exit;
+    struct timespec         timer;          // the timeout which is set by libcurl
+    bool                    is_timer;
+    pthread_mutex_t         lock;           // for requests
+    curl_engine_requests_t  requests;       // new requests from other threads
+    curl_engine_requests_t  waiting;        // retry requests waiting for retry_time
+    curl_engine_running_t   running;
+
+    curl_io_thread();
+    ~curl_io_thread();
+};
+
+//------------------------------------------------
+// Class CurlMultiEngine
+//------------------------------------------------
+// This class performs the requests with curl multi interface on a small
+// fixed number of I/O threads. Each thread waits for the sockets by epoll
+// and drives the transfers by curl_multi_socket_action, so that many
+// requests in parallel do not need as many threads.
+// The retry of the request is done as same as RequestPerform, but the
+// thread does not sleep for it, the request waits in the thread without
+// blocking other requests.
+// The requests are signed before they are passed to the I/O threads, and
+// the retries are signed again by the prepare thread, because the signing
+// may refresh the credentials by a request.
+//
+class CurlMultiEngine
+{
+    private:
+        static CurlMultiEngine* singleton;
+        static int              thread_count;
+
+        std::vector<curl_io_thread*> iothreads;
+        pthread_mutex_t         next_lock;
+        size_t                  next_thread;
+        pthread_t               prepare_thread;     // signs the retries again
+        bool                    is_prepare_thread;
+        pthread_mutex_t         prepare_lock;
+        pthread_cond_t          prepare_cond;
+        curl_engine_requests_t  prepares;
+        bool                    is_prepare_exit;
+
+    private:
+        static void* IoThread(void* arg);
+        static int SocketCallback(CURL* hCurl, curl_socket_t sock, int what, void* userp, void* socketp);
+        static int TimerCallback(CURLM* hMulti, long timeout_ms, void* userp);
+        static void WakeUp(curl_io_thread* piot);
+        static int GetWaitTime(curl_io_thread* piot);
+        static void StartRequest(curl_io_thread* piot, curl_engine_request* preq);
+        static void FinishRequest(curl_io_thread* piot, CURL* hCurl, CURLcode code);
+        static void CompleteRequest(curl_engine_request* preq, int result);
+        static void ProcessRequests(curl_io_thread* piot);
+        static void ProcessMessages(curl_io_thread* piot);
+        static void CancelRequests(curl_io_thread* piot);
+        static void RetryRequest(curl_engine_request* preq);
+        static void* PrepareThread(void* arg);
+
+        explicit CurlMultiEngine(int count);
+        ~CurlMultiEngine();
+
+        bool StartThreads(int count);
+        void StopThreads();
+        bool AddRequest(curl_engine_request* preq);
+
+    public:
+        static bool Initialize();
+        static void Destroy();
+        static bool IsRunning() { return (NULL != CurlMultiEngine::singleton); }
+        static int SetThreadCount(int count);
+        static int GetThreadCount() { return CurlMultiEngine::thread_count; }
+
+        static bool Request(S3fsCurl* s3fscurl, curl_engine_callback callback, void* param);
+};
+
+#endif // S3FS_CURL_ENGINE_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -55,6 +55,11 @@ bool CurlHandlerPool::Init()
 
 bool CurlHandlerPool::Destroy()
 {
+    long reused;
+    long connected;
+    GetConnectStats(reused, connected);
+    S3FS_PRN_INFO("connection stats: %ld requests reused the connections, %ld connections were opened.", reused, connected);
+
     while(!mPool.empty()){
         CURL* hCurl = mPool.back();
         mPool.pop_back();
@@ -117,6 +122,24 @@ void CurlHandlerPool::ReturnHandler(CURL* hCurl, bool restore_pool)
     }
 }
 
+//
+// connects is the number of new connections for a request(CURLINFO_NUM_CONNECTS)
+//
+void CurlHandlerPool::AddConnectStats(long connects)
+{
+    if(0 == connects){
+        ++mReusedCount;
+    }else{
+        mConnectCount += connects;
+    }
+}
+
+void CurlHandlerPool::GetConnectStats(long& reused, long& connected) const
+{
+    reused    = mReusedCount.load();
+    connected = mConnectCount.load();
+}
+
 /*
 * Local variables:
 * tab-width: 4
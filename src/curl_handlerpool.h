@@ -21,6 +21,7 @@
 #ifndef S3FS_CURL_HANDLERPOOL_H_
 #define S3FS_CURL_HANDLERPOOL_H_
 
+#include <atomic>
 #include <cassert>
 #include <curl/curl.h>
 
@@ -35,7 +36,7 @@ typedef std::list<CURL*>            hcurllist_t;
 class CurlHandlerPool
 {
     public:
-        explicit CurlHandlerPool(int maxHandlers) : mMaxHandlers(maxHandlers)
+        explicit CurlHandlerPool(int maxHandlers) : mMaxHandlers(maxHandlers), mReusedCount(0), mConnectCount(0)
         {
             assert(maxHandlers > 0);
         }
@@ -46,10 +47,16 @@ class CurlHandlerPool
         CURL* GetHandler(bool only_pool);
         void ReturnHandler(CURL* hCurl, bool restore_pool);
 
+        // connection reuse statistics
+        void AddConnectStats(long connects);
+        void GetConnectStats(long& reused, long& connected) const;
+
     private:
         int             mMaxHandlers;
         pthread_mutex_t mLock;
         hcurllist_t     mPool;
+        std::atomic<long> mReusedCount;     // requests which reused the connection
+        std::atomic<long> mConnectCount;    // new connections
 };
 
 #endif // S3FS_CURL_HANDLERPOOL_H_
@@ -0,0 +1,209 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "common.h"
+#include "s3fs.h"
+#include "curl_hedge.h"
+#include "autolock.h"
+
+//------------------------------------------------
+// Class CurlHedge
+//------------------------------------------------
+CurlHedge       CurlHedge::singleton;
+pthread_mutex_t CurlHedge::hedge_lock;
+bool            CurlHedge::is_enabled = false;
+int             CurlHedge::percentile = 95;     // default
+int             CurlHedge::budget     = 5;      // default
+const size_t    CurlHedge::SAMPLE_COUNT;
+const int       CurlHedge::MIN_SAMPLES;
+const int       CurlHedge::UPDATE_COUNT;
+const long      CurlHedge::MIN_DELAY_MS;
+const long      CurlHedge::MAX_TOKENS;
+const off_t     CurlHedge::MAX_SIZE;
+
+CurlHedge::CurlHedge() : tokens(0), hedged_count(0), win_count(0)
+{
+    if(this == &CurlHedge::singleton){
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+        int result;
+        if(0 != (result = pthread_mutex_init(&CurlHedge::hedge_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init hedge_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+CurlHedge::~CurlHedge()
+{
+    if(this == &CurlHedge::singleton){
+        int result = pthread_mutex_destroy(&CurlHedge::hedge_lock);
+        if(result != 0){
+            S3FS_PRN_CRIT("failed to destroy hedge_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+bool CurlHedge::SetEnabled(bool flag)
+{
+    bool old = CurlHedge::is_enabled;
+    CurlHedge::is_enabled = flag;
+    return old;
+}
+
+bool CurlHedge::SetPercentile(int value)
+{
+    if(value < 1 || 99 < value){
+        return false;
+    }
+    CurlHedge::percentile = value;
+    return true;
+}
+
+bool CurlHedge::SetBudget(int value)
+{
+    if(value < 0 || 100 < value){
+        return false;
+    }
+    CurlHedge::budget = value;
+    return true;
+}
+
+//
+// Returns the time(ms) to wait before sending the hedged request, or -1
+// if the request should not be hedged because of too few samples.
+// This is called once for each request, and the budget is added.
+//
+long CurlHedge::GetDelay(curl_hedge_kind_t kind)
+{
+    AutoLock auto_lock(&CurlHedge::hedge_lock);
+
+    CurlHedge& hedge = CurlHedge::singleton;
+    hedge.tokens     = std::min(CurlHedge::MAX_TOKENS, hedge.tokens + CurlHedge::budget);
+
+    curl_hedge_stat_t& stat = hedge.stats[kind];
+    if(stat.samples.size() < static_cast<size_t>(CurlHedge::MIN_SAMPLES)){
+        return -1;
+    }
+    if(-1 == stat.delay || CurlHedge::UPDATE_COUNT <= stat.updated){
+        std::vector<long> sorted(stat.samples);
+        size_t            nth = (sorted.size() * CurlHedge::percentile) / 100;
+        std::nth_element(sorted.begin(), sorted.begin() + nth, sorted.end());
+        stat.delay   = std::max(CurlHedge::MIN_DELAY_MS, sorted[nth]);
+        stat.updated = 0;
+    }
+    return stat.delay;
+}
+
+bool CurlHedge::AcquireHedge()
+{
+    AutoLock auto_lock(&CurlHedge::hedge_lock);
+
+    CurlHedge& hedge = CurlHedge::singleton;
+    if(hedge.tokens < 100){
+        return false;
+    }
+    hedge.tokens -= 100;
+    ++hedge.hedged_count;
+    return true;
+}
+
+void CurlHedge::AddLatency(curl_hedge_kind_t kind, long latency)
+{
+    AutoLock auto_lock(&CurlHedge::hedge_lock);
+
+    curl_hedge_stat_t& stat = CurlHedge::singleton.stats[kind];
+    if(stat.samples.size() < CurlHedge::SAMPLE_COUNT){
+        stat.samples.push_back(latency);
+    }else{
+        stat.samples[stat.pos] = latency;
+        stat.pos               = (stat.pos + 1) % CurlHedge::SAMPLE_COUNT;
+    }
+    ++stat.updated;
+}
+
+void CurlHedge::AddWin()
+{
+    AutoLock auto_lock(&CurlHedge::hedge_lock);
+    ++CurlHedge::singleton.win_count;
+}
+
+CURLM* CurlHedge::GetMultiHandle()
+{
+    {
+        AutoLock auto_lock(&CurlHedge::hedge_lock);
+
+        std::vector<CURLM*>& handles = CurlHedge::singleton.multi_handles;
+        if(!handles.empty()){
+            CURLM* hMulti = handles.back();
+            handles.pop_back();
+            return hMulti;
+        }
+    }
+    return curl_multi_init();
+}
+
+void CurlHedge::ReturnMultiHandle(CURLM* hMulti)
+{
+    if(!hMulti){
+        return;
+    }
+    AutoLock auto_lock(&CurlHedge::hedge_lock);
+    CurlHedge::singleton.multi_handles.push_back(hMulti);
+}
+
+//
+// This must be called before libcurl is cleaned up.
+//
+void CurlHedge::Destroy()
+{
+    AutoLock auto_lock(&CurlHedge::hedge_lock);
+
+    CurlHedge& hedge = CurlHedge::singleton;
+    for(std::vector<CURLM*>::iterator iter = hedge.multi_handles.begin(); iter != hedge.multi_handles.end(); ++iter){
+        curl_multi_cleanup(*iter);
+    }
+    hedge.multi_handles.clear();
+
+    if(CurlHedge::is_enabled){
+        S3FS_PRN_INFO("hedged requests: %ld, responded first: %ld", hedge.hedged_count, hedge.win_count);
+    }
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
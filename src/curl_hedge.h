@@ -0,0 +1,112 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_HEDGE_H_
+#define S3FS_CURL_HEDGE_H_
+
+#include <curl/curl.h>
+#include <sys/types.h>
+#include <vector>
+
+//------------------------------------------------
+// Structures
+//------------------------------------------------
+enum curl_hedge_kind_t {
+    CURL_HEDGE_HEAD = 0,        // HEAD object
+    CURL_HEDGE_GET,             // GET object(small range) into the buffer
+    CURL_HEDGE_KIND_COUNT
+};
+
+struct curl_hedge_stat_t
+{
+    std::vector<long> samples;  // ms, the latencies of the recent requests(ring buffer)
+    size_t            pos;
+    int               updated;  // samples after the delay was calculated
+    long              delay;    // ms, the percentile of the samples(-1 means not calculated)
+
+    curl_hedge_stat_t() : pos(0), updated(0), delay(-1) {}
+};
+
+//------------------------------------------------
+// Class CurlHedge
+//------------------------------------------------
+// This class decides when the duplicate(hedged) request is sent for the
+// small requests which the caller waits for.
+//
+// If the request is not finished within the percentile(hedge_percentile)
+// of the latencies of the recent SAMPLE_COUNT requests of the same kind,
+// the same request is sent again and the response which arrives first is
+// used. The hedged requests are limited by the budget: each request adds
+// hedge_budget percent of a token, and a hedged request takes one token.
+//
+// The requests are performed by the curl multi handles in this class, so
+// that the connections are kept for the next requests.
+//
+class CurlHedge
+{
+    private:
+        static CurlHedge       singleton;
+        static pthread_mutex_t hedge_lock;
+        static bool            is_enabled;
+        static int             percentile;
+        static int             budget;          // percent of the requests
+        curl_hedge_stat_t      stats[CURL_HEDGE_KIND_COUNT];
+        long                   tokens;          // 100 means a hedged request
+        std::vector<CURLM*>    multi_handles;
+        long                   hedged_count;
+        long                   win_count;       // the hedged request responded first
+
+    private:
+        CurlHedge();
+        ~CurlHedge();
+
+    public:
+        static const size_t SAMPLE_COUNT = 256;
+        static const int    MIN_SAMPLES  = 20;
+        static const int    UPDATE_COUNT = 16;
+        static const long   MIN_DELAY_MS = 5;
+        static const long   MAX_TOKENS   = 1000;
+        static const off_t  MAX_SIZE     = 1024 * 1024;
+
+        static bool SetEnabled(bool flag);
+        static bool IsEnabled() { return CurlHedge::is_enabled; }
+        static bool SetPercentile(int value);
+        static bool SetBudget(int value);
+
+        static long GetDelay(curl_hedge_kind_t kind);
+        static bool AcquireHedge();
+        static void AddLatency(curl_hedge_kind_t kind, long latency);
+        static void AddWin();
+
+        static CURLM* GetMultiHandle();
+        static void ReturnMultiHandle(CURLM* hMulti);
+        static void Destroy();
+};
+
+#endif // S3FS_CURL_HEDGE_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -26,12 +26,13 @@
 #include "s3fs.h"
 #include "curl_multi.h"
 #include "curl.h"
+#include "curl_engine.h"
 #include "autolock.h"
 
 //-------------------------------------------------------------------
 // Class S3fsMultiCurl 
 //-------------------------------------------------------------------
-S3fsMultiCurl::S3fsMultiCurl(int maxParallelism) : maxParallelism(maxParallelism), SuccessCallback(NULL), RetryCallback(NULL)
+S3fsMultiCurl::S3fsMultiCurl(int maxParallelism, bool useEngine) : maxParallelism(maxParallelism), useEngine(useEngine), SuccessCallback(NULL), RetryCallback(NULL)
 {
     int result;
     pthread_mutexattr_t attr;
@@ -104,12 +105,57 @@ bool S3fsMultiCurl::SetS3fsCurlObject(S3fsCurl* s3fscurl)
     return true;
 }
 
+//
+// Send the requests by the I/O threads of CurlMultiEngine, and wait for
+// all of them. The number of requests which are sent at the same time is
+// limited to maxParallelism as same as the thread per request.
+//
 int S3fsMultiCurl::MultiPerform()
+{
+    if(!useEngine || !CurlMultiEngine::IsRunning()){
+        return MultiPerformThreads();
+    }
+
+    int       parallelism = CurlConcurrency::GetParallelism(GetMaxParallelism());
+    Semaphore sem(parallelism);
+    bool      success     = true;
+
+    for(s3fscurllist_t::iterator iter = clist_req.begin(); iter != clist_req.end(); ++iter){
+        S3fsCurl* s3fscurl = *iter;
+        if(!s3fscurl){
+            continue;
+        }
+        sem.wait();
+        CurlConcurrency::Acquire(s3fscurl->GetRequestClass());
+        s3fscurl->AcquireRequestSlot();
+
+        if(!CurlMultiEngine::Request(s3fscurl, S3fsMultiCurl::RequestDoneCallback, &sem)){
+            S3FS_PRN_ERR("failed to send a request by curl multi engine.");
+            s3fscurl->ReleaseRequestSlot();
+            CurlConcurrency::Release(s3fscurl->GetRequestClass(), NULL, -EIO);
+            sem.post();
+            success = false;
+            break;
+        }
+    }
+
+    // wait for all requests
+    for(int cnt = 0; cnt < parallelism; ++cnt){
+        sem.wait();
+    }
+    return success ? 0 : -EIO;
+}
+
+//
+// Send the requests by a thread per request.
+// This is used when curl multi engine is not running or not used.
+//
+int S3fsMultiCurl::MultiPerformThreads()
 {
     std::vector<pthread_t>   threads;
     bool                     success = true;
     bool                     isMultiHead = false;
-    Semaphore                sem(GetMaxParallelism());
+    Semaphore                sem(CurlConcurrency::GetParallelism(GetMaxParallelism()));
     int                      rc;
 
     for(s3fscurllist_t::iterator iter = clist_req.begin(); iter != clist_req.end(); ++iter) {
@@ -145,8 +191,12 @@ int S3fsMultiCurl::MultiPerform()
 
         isMultiHead |= s3fscurl->GetOp() == "HEAD";
 
+        CurlConcurrency::Acquire(s3fscurl->GetRequestClass());
+        s3fscurl->AcquireRequestSlot();
         rc = pthread_create(&thread, NULL, S3fsMultiCurl::RequestPerformWrapper, static_cast<void*>(s3fscurl));
         if (rc != 0) {
+            s3fscurl->ReleaseRequestSlot();
+            CurlConcurrency::Release(s3fscurl->GetRequestClass(), NULL, -EIO);
             success = false;
             S3FS_PRN_ERR("failed pthread_create - rc(%d)", rc);
             break;
@@ -350,6 +400,8 @@ void* S3fsMultiCurl::RequestPerformWrapper(void* arg)
         result = (void*)(intptr_t)(s3fscurl->RequestPerform());
         s3fscurl->DestroyCurlHandle(true, false);
     }
+    s3fscurl->ReleaseRequestSlot();
+    CurlConcurrency::Release(s3fscurl->GetRequestClass(), s3fscurl, static_cast<int>(reinterpret_cast<intptr_t>(result)));
 
     AutoLock  lock(s3fscurl->completed_tids_lock);
     s3fscurl->completed_tids->push_back(pthread_self());
@@ -358,6 +410,19 @@ void* S3fsMultiCurl::RequestPerformWrapper(void* arg)
     return result;
 }
 
+//
+// callback function from curl multi engine
+//
+void S3fsMultiCurl::RequestDoneCallback(S3fsCurl* s3fscurl, int result, void* param)
+{
+    if(result && !(-ENOENT == result && s3fscurl->GetOp() == "HEAD")){
+        S3FS_PRN_WARN("request terminated with non-zero return code: %d", result);
+    }
+    s3fscurl->ReleaseRequestSlot();
+    CurlConcurrency::Release(s3fscurl->GetRequestClass(), s3fscurl, result);
+    static_cast<Semaphore*>(param)->post();
+}
+
 /*
 * Local variables:
 * tab-width: 4
@@ -37,6 +37,7 @@ class S3fsMultiCurl
 {
     private:
         const int maxParallelism;
+        const bool useEngine;      // false means that the requests are sent by the handles in the pool even if curl multi engine is running
 
         s3fscurllist_t clist_all;  // all of curl requests
         s3fscurllist_t clist_req;  // curl requests are sent
@@ -50,12 +51,14 @@ class S3fsMultiCurl
     private:
         bool ClearEx(bool is_all);
         int MultiPerform();
+        int MultiPerformThreads();
         int MultiRead();
 
         static void* RequestPerformWrapper(void* arg);
+        static void RequestDoneCallback(S3fsCurl* s3fscurl, int result, void* param);
 
     public:
-        explicit S3fsMultiCurl(int maxParallelism);
+        explicit S3fsMultiCurl(int maxParallelism, bool useEngine = true);
         ~S3fsMultiCurl();
 
         int GetMaxParallelism() { return maxParallelism; }
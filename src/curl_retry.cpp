@@ -0,0 +1,179 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "common.h"
+#include "s3fs.h"
+#include "curl_retry.h"
+#include "autolock.h"
+
+//------------------------------------------------
+// Symbols
+//------------------------------------------------
+// The error codes which are returned by the server for throttling
+static const char* throttling_codes[] = {
+    "SlowDown",
+    "TooManyRequests",
+    "QpsLimitExceeded",
+    "DownloadTrafficRateLimitExceeded",
+    "UploadTrafficRateLimitExceeded",
+    "ServerBusy",
+    NULL
+};
+
+//------------------------------------------------
+// Class CurlRetryScheduler
+//------------------------------------------------
+CurlRetryScheduler CurlRetryScheduler::singleton;
+pthread_mutex_t    CurlRetryScheduler::retry_lock;
+long               CurlRetryScheduler::budget = 100;        // default
+const long         CurlRetryScheduler::THROTTLED_WAIT_MS;
+const long         CurlRetryScheduler::MAX_WAIT_MS;
+const long         CurlRetryScheduler::MAX_HINT_MS;
+
+CurlRetryScheduler::CurlRetryScheduler()
+{
+    if(this == &CurlRetryScheduler::singleton){
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+        int result;
+        if(0 != (result = pthread_mutex_init(&CurlRetryScheduler::retry_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init retry_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+CurlRetryScheduler::~CurlRetryScheduler()
+{
+    if(this == &CurlRetryScheduler::singleton){
+        int result = pthread_mutex_destroy(&CurlRetryScheduler::retry_lock);
+        if(result != 0){
+            S3FS_PRN_CRIT("failed to destroy retry_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+long CurlRetryScheduler::SetBudget(long count)
+{
+    AutoLock auto_lock(&CurlRetryScheduler::retry_lock);
+
+    long old = CurlRetryScheduler::budget;
+    CurlRetryScheduler::budget = count;
+    CurlRetryScheduler::singleton.budgets.clear();
+    return old;
+}
+
+//
+// Returns "scheme://host[:port]" part of the url
+//
+std::string CurlRetryScheduler::GetEndpoint(const std::string& url)
+{
+    std::string::size_type pos = url.find("://");
+    pos = (std::string::npos == pos ? 0 : pos + 3);
+    return url.substr(0, url.find('/', pos));
+}
+
+bool CurlRetryScheduler::IsThrottlingCode(const std::string& code)
+{
+    for(int cnt = 0; throttling_codes[cnt]; ++cnt){
+        if(code == throttling_codes[cnt]){
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Returns the wait time(ms) before retrying.
+// last_ms is the last wait time of the request, it is 0 at the first retry.
+// hint_ms is the time which is specified by Retry-After, 0 if not.
+//
+long CurlRetryScheduler::GetWaitTime(long base_ms, long last_ms, long hint_ms)
+{
+    long upper = std::max(base_ms, last_ms) * 3;
+    long wait  = base_ms;
+    if(base_ms < upper){
+        wait += random() % (upper - base_ms);
+    }
+    wait = std::min(wait, CurlRetryScheduler::MAX_WAIT_MS);
+
+    if(0 < hint_ms){
+        wait = std::max(wait, std::min(hint_ms, CurlRetryScheduler::MAX_HINT_MS));
+    }
+    return wait;
+}
+
+bool CurlRetryScheduler::AcquireRetry(const std::string& endpoint)
+{
+    AutoLock auto_lock(&CurlRetryScheduler::retry_lock);
+
+    if(0 == CurlRetryScheduler::budget){
+        return true;
+    }
+    long maxtokens = CurlRetryScheduler::budget * 10;
+
+    retry_budget_t&          budgets = CurlRetryScheduler::singleton.budgets;
+    retry_budget_t::iterator iter    = budgets.find(endpoint);
+    if(iter == budgets.end()){
+        iter = budgets.insert(std::make_pair(endpoint, maxtokens)).first;
+    }
+    if(iter->second <= maxtokens / 2){
+        S3FS_PRN_WARN("retry budget for %s is exhausted.", endpoint.c_str());
+        return false;
+    }
+    iter->second -= 10;
+    return true;
+}
+
+void CurlRetryScheduler::AddSuccess(const std::string& endpoint)
+{
+    AutoLock auto_lock(&CurlRetryScheduler::retry_lock);
+
+    if(0 == CurlRetryScheduler::budget){
+        return;
+    }
+    // the endpoint which has never retried has full tokens
+    retry_budget_t&          budgets = CurlRetryScheduler::singleton.budgets;
+    retry_budget_t::iterator iter    = budgets.find(endpoint);
+    if(iter != budgets.end() && iter->second < CurlRetryScheduler::budget * 10){
+        ++(iter->second);
+    }
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
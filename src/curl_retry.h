@@ -0,0 +1,85 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_RETRY_H_
+#define S3FS_CURL_RETRY_H_
+
+#include <map>
+#include <string>
+
+//------------------------------------------------
+// Structures
+//------------------------------------------------
+typedef std::map<std::string, long> retry_budget_t;    // key=endpoint, value=tokens(x10)
+
+//------------------------------------------------
+// Class CurlRetryScheduler
+//------------------------------------------------
+// This class decides the wait time before retrying the request and
+// whether the request can be retried.
+//
+// The wait time is the decorrelated jitter backoff, it is a random time
+// between the base time and three times the last wait time. If the server
+// returns Retry-After, the wait time is not shorter than it.
+//
+// Each endpoint has the retry budget(tokens). A retry takes one token and
+// a request which is finished without retrying gives back 1/10 token, and
+// the requests are not retried while the tokens are less than half of
+// the budget. This prevents the retries from multiplying the load when
+// the server is throttling or failing.
+//
+class CurlRetryScheduler
+{
+    private:
+        static CurlRetryScheduler singleton;
+        static pthread_mutex_t    retry_lock;
+        static long               budget;           // max tokens for each endpoint, 0 means unlimited
+        retry_budget_t            budgets;
+
+    private:
+        CurlRetryScheduler();
+        ~CurlRetryScheduler();
+
+    public:
+        static const long THROTTLED_WAIT_MS = 1000;
+        static const long MAX_WAIT_MS       = 20 * 1000;
+        static const long MAX_HINT_MS       = 60 * 1000;
+
+        static long SetBudget(long count);
+        static long GetBudget() { return CurlRetryScheduler::budget; }
+
+        static std::string GetEndpoint(const std::string& url);
+        static bool IsThrottlingCode(const std::string& code);
+        static long GetWaitTime(long base_ms, long last_ms, long hint_ms);
+
+        static bool AcquireRetry(const std::string& endpoint);
+        static void AddSuccess(const std::string& endpoint);
+};
+
+#endif // S3FS_CURL_RETRY_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,239 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "common.h"
+#include "s3fs.h"
+#include "curl_scheduler.h"
+#include "autolock.h"
+
+//------------------------------------------------
+// Symbols
+//------------------------------------------------
+// weights of the classes(the order of curl_req_class_t)
+static const int sched_weights[CURL_REQ_CLASS_COUNT] = {
+    8,      // CURL_REQ_META
+    4,      // CURL_REQ_READ
+    1,      // CURL_REQ_WRITE
+    2       // CURL_REQ_PREFETCH
+};
+
+// reserved slots of the classes are 1/N of all slots(0 means no reservation)
+static const int sched_reserved_ratio[CURL_REQ_CLASS_COUNT] = {
+    4,      // CURL_REQ_META
+    8,      // CURL_REQ_READ
+    0,      // CURL_REQ_WRITE
+    0       // CURL_REQ_PREFETCH
+};
+
+//------------------------------------------------
+// Class CurlRequestScheduler
+//------------------------------------------------
+CurlRequestScheduler CurlRequestScheduler::singleton;
+pthread_mutex_t      CurlRequestScheduler::sched_lock;
+int                  CurlRequestScheduler::max_slots = 0;     // default
+
+CurlRequestScheduler::CurlRequestScheduler() : inflight(0), vtime(0.0)
+{
+    if(this == &CurlRequestScheduler::singleton){
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+        int result;
+        if(0 != (result = pthread_mutex_init(&CurlRequestScheduler::sched_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init sched_lock: %d", result);
+            abort();
+        }
+        for(int cnt = 0; cnt < CURL_REQ_CLASS_COUNT; ++cnt){
+            if(0 != (result = pthread_cond_init(&classes[cnt].cond, NULL))){
+                S3FS_PRN_CRIT("failed to init scheduler cond: %d", result);
+                abort();
+            }
+            classes[cnt].weight = sched_weights[cnt];
+        }
+    }else{
+        abort();
+    }
+}
+
+CurlRequestScheduler::~CurlRequestScheduler()
+{
+    if(this == &CurlRequestScheduler::singleton){
+        int result;
+        for(int cnt = 0; cnt < CURL_REQ_CLASS_COUNT; ++cnt){
+            if(0 != (result = pthread_cond_destroy(&classes[cnt].cond))){
+                S3FS_PRN_CRIT("failed to destroy scheduler cond: %d", result);
+                abort();
+            }
+        }
+        if(0 != (result = pthread_mutex_destroy(&CurlRequestScheduler::sched_lock))){
+            S3FS_PRN_CRIT("failed to destroy sched_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+//
+// This must be called before any requests are sent.
+//
+int CurlRequestScheduler::SetMaxSlots(int slots)
+{
+    AutoLock auto_lock(&CurlRequestScheduler::sched_lock);
+
+    int old = CurlRequestScheduler::max_slots;
+    CurlRequestScheduler::max_slots = std::max(0, slots);
+
+    for(int cnt = 0; cnt < CURL_REQ_CLASS_COUNT; ++cnt){
+        if(0 < sched_reserved_ratio[cnt]){
+            CurlRequestScheduler::singleton.classes[cnt].reserved = CurlRequestScheduler::max_slots / sched_reserved_ratio[cnt];
+        }
+    }
+    return old;
+}
+
+//
+// The class can get a slot without using the reserved slots of the
+// other classes which are not used now.
+//
+bool CurlRequestScheduler::IsAdmissible(curl_req_class_t reqclass) const
+{
+    int unused_reserved = 0;
+    for(int cnt = 0; cnt < CURL_REQ_CLASS_COUNT; ++cnt){
+        if(cnt != reqclass){
+            unused_reserved += std::max(0, classes[cnt].reserved - classes[cnt].inflight);
+        }
+    }
+    return ((inflight + unused_reserved) < CurlRequestScheduler::max_slots);
+}
+
+//
+// Grant the slots to the waiting classes in order of the virtual time.
+// sched_lock must be held.
+//
+void CurlRequestScheduler::Dispatch()
+{
+    while(true){
+        int pick = -1;
+        for(int cnt = 0; cnt < CURL_REQ_CLASS_COUNT; ++cnt){
+            if(0 < classes[cnt].waiting && IsAdmissible(static_cast<curl_req_class_t>(cnt)) && (-1 == pick || classes[cnt].vtime < classes[pick].vtime)){
+                pick = cnt;
+            }
+        }
+        if(-1 == pick){
+            break;
+        }
+        curl_sched_class_t& sc = classes[pick];
+        --sc.waiting;
+        ++sc.granted;
+        ++sc.inflight;
+        ++inflight;
+        vtime     = sc.vtime;
+        sc.vtime += 1.0 / sc.weight;
+        pthread_cond_signal(&sc.cond);
+    }
+}
+
+void CurlRequestScheduler::Acquire(curl_req_class_t reqclass)
+{
+    if(!CurlRequestScheduler::IsEnabled()){
+        return;
+    }
+    AutoLock auto_lock(&CurlRequestScheduler::sched_lock);
+
+    CurlRequestScheduler& sched = CurlRequestScheduler::singleton;
+    curl_sched_class_t&   sc    = sched.classes[reqclass];
+
+    // the idle class does not keep the credit from the past
+    if(0 == sc.waiting && sc.vtime < sched.vtime){
+        sc.vtime = sched.vtime;
+    }
+    ++sc.waiting;
+    sched.Dispatch();
+
+    while(0 == sc.granted){
+        pthread_cond_wait(&sc.cond, &CurlRequestScheduler::sched_lock);
+    }
+    --sc.granted;
+}
+
+//
+// Take the slot only if it is free now and no class is waiting for it.
+// Returns true if the slot is taken(or the scheduler is disabled).
+//
+bool CurlRequestScheduler::TryAcquire(curl_req_class_t reqclass)
+{
+    if(!CurlRequestScheduler::IsEnabled()){
+        return true;
+    }
+    AutoLock auto_lock(&CurlRequestScheduler::sched_lock);
+
+    CurlRequestScheduler& sched = CurlRequestScheduler::singleton;
+    for(int cnt = 0; cnt < CURL_REQ_CLASS_COUNT; ++cnt){
+        if(0 < sched.classes[cnt].waiting){
+            return false;
+        }
+    }
+    if(!sched.IsAdmissible(reqclass)){
+        return false;
+    }
+    curl_sched_class_t& sc = sched.classes[reqclass];
+    if(sc.vtime < sched.vtime){
+        sc.vtime = sched.vtime;
+    }
+    ++sc.inflight;
+    ++sched.inflight;
+    sched.vtime  = sc.vtime;
+    sc.vtime    += 1.0 / sc.weight;
+    return true;
+}
+
+void CurlRequestScheduler::Release(curl_req_class_t reqclass)
+{
+    if(!CurlRequestScheduler::IsEnabled()){
+        return;
+    }
+    AutoLock auto_lock(&CurlRequestScheduler::sched_lock);
+
+    CurlRequestScheduler& sched = CurlRequestScheduler::singleton;
+    curl_sched_class_t&   sc    = sched.classes[reqclass];
+    if(0 < sc.inflight){
+        --sc.inflight;
+    }
+    if(0 < sched.inflight){
+        --sched.inflight;
+    }
+    sched.Dispatch();
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,92 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_SCHEDULER_H_
+#define S3FS_CURL_SCHEDULER_H_
+
+#include "curl_concurrency.h"
+
+//------------------------------------------------
+// Structures
+//------------------------------------------------
+struct curl_sched_class_t
+{
+    int             weight;
+    int             reserved;       // slots which other classes can not use
+    int             inflight;
+    int             waiting;
+    int             granted;        // slots granted to the waiters but not taken yet
+    double          vtime;          // virtual time for weighted fair queuing
+    pthread_cond_t  cond;
+
+    curl_sched_class_t() : weight(1), reserved(0), inflight(0), waiting(0), granted(0), vtime(0.0) {}
+};
+
+//------------------------------------------------
+// Class CurlRequestScheduler
+//------------------------------------------------
+// This class limits the number of requests in flight for all request
+// classes, and decides which class sends the request next when the slots
+// are full.
+//
+// Each class has the reserved slots, which can not be used by the other
+// classes, so that the metadata requests(interactive) and the reads in the
+// foreground are not blocked by the bulk transfers. The other slots are
+// shared by the classes by weighted fair queuing: each class has the
+// virtual time which advances by 1/weight for each request, and the
+// waiting class with the earliest virtual time is granted first.
+//
+class CurlRequestScheduler
+{
+    private:
+        static CurlRequestScheduler singleton;
+        static pthread_mutex_t      sched_lock;
+        static int                  max_slots;      // 0 means disabled
+        curl_sched_class_t          classes[CURL_REQ_CLASS_COUNT];
+        int                         inflight;
+        double                      vtime;
+
+    private:
+        CurlRequestScheduler();
+        ~CurlRequestScheduler();
+
+        bool IsAdmissible(curl_req_class_t reqclass) const;
+        void Dispatch();
+
+    public:
+        static int SetMaxSlots(int slots);
+        static int GetMaxSlots() { return CurlRequestScheduler::max_slots; }
+        static bool IsEnabled() { return (0 < CurlRequestScheduler::max_slots); }
+
+        static void Acquire(curl_req_class_t reqclass);
+        static bool TryAcquire(curl_req_class_t reqclass);
+        static void Release(curl_req_class_t reqclass);
+};
+
+#endif // S3FS_CURL_SCHEDULER_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
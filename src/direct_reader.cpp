@@ -258,8 +258,15 @@ void* direct_read_worker(void* arg)
     ssize_t rsize;
 
     Chunk* chunk = new Chunk(start, len); 
+    if(!is_sync_download){
+        s3fscurl.SetRequestClass(CURL_REQ_PREFETCH);
+        CurlConcurrency::Acquire(CURL_REQ_PREFETCH);
+    }
     int result = s3fscurl.GetObjectStreamRequest(direct_reader->filepath.c_str(),
                                                  chunk->buf, start, len, rsize);
+    if(!is_sync_download){
+        CurlConcurrency::Release(CURL_REQ_PREFETCH, &s3fscurl, result);
+    }
 
     if(0 != result){
         S3FS_PRN_ERR("failed to get object stream[pid=%lu][path=%s][start=%ld][len=%ld]", pthread_self(), direct_reader->filepath.c_str(), start, len);
@@ -342,6 +342,17 @@ std::string utc_to_gmt(const char* s)
     return std::string(date);
 }
 
+std::string time_to_gmt(time_t t)
+{
+    struct tm tm;
+    char date[128];
+    gmtime_r(&t, &tm);
+    sprintf(date, "%s, %.2d %s %.4d %.2d:%.2d:%.2d GMT",
+        s_wday[tm.tm_wday], tm.tm_mday, s_mon[tm.tm_mon], 1900 + tm.tm_year,
+        tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return std::string(date);
+}
+
 //
 // Returns it whether it is an object with need checking in detail.
 // If this function returns true, the object is possible to be directory
@@ -27,6 +27,7 @@
 #include <getopt.h>
 
 #include <fstream>
+#include <algorithm>
 
 #include "common.h"
 #include "s3fs.h"
@@ -35,9 +36,10 @@
 #include "fdcache_auto.h"
 #include "curl.h"
 #include "curl_multi.h"
+#include "curl_util.h"
 #include "s3objlist.h"
 #include "cache.h"
-#include "mvnode.h"
+#include "treewalk.h"
 #include "addhead.h"
 #include "sighandlers.h"
 #include "s3fs_xml.h"
@@ -48,6 +50,10 @@
 #include "s3fs_util.h"
 #include "mpu_util.h"
 #include "threadpoolman.h"
+#include "copypart.h"
+#include "curl_engine.h"
+#include "curl_retry.h"
+#include "singleflight.h"
 
 //-------------------------------------------------------------------
 // Symbols
@@ -93,6 +99,7 @@ static bool is_specified_endpoint = false;
 static int s3fs_init_deferred_exit_status = 0;
 static bool support_compat_dir    = true;// default supports compatibility directory type
 static int max_keys_list_object   = 1000;// default is 1000
+static int list_object_fanout     = 1;   // 1 means no fan-out listing
 static off_t max_dirty_data       = 5LL * 1024LL * 1024LL * 1024LL;
 static bool use_wtf8              = false;
 static off_t fake_diskfree_size   = -1; // default is not set(-1)
@@ -100,8 +107,18 @@ static bool shallowcopyapi        = true;//
 static bool is_readdir_optimize   = false;
 static bool is_refresh_fakemeta   = false;
 static off_t readdir_check_size   = 0;
+static int readdir_flat_list_max_keys = 0;  // 0 means not using flat listing for readdir
+static bool is_readdir_stream     = false; // readdir lists and fills entries page by page
+static bool is_stat_prewarm       = false;
+static bool is_parallel_probe     = false; // probes the object types at the same time in getattr
+static int warmup_connections     = 0;     // connections opened at mount time
+static const char* const stat_prewarm_xattr = "user.ossfs.prewarm";
 static bool is_new_symlink_format = false;
 static bool is_specified_region   = false;
+static bool is_readdir_fake_dir   = false;
+static mode_t fake_dir_mode       = 0750;
+static uid_t fake_dir_uid         = static_cast<uid_t>(-1);  // not specified(-1) means uid option or euid
+static gid_t fake_dir_gid         = static_cast<gid_t>(-1);  // not specified(-1) means gid option or egid
 
 //-------------------------------------------------------------------
 // Global functions : prototype
@@ -115,6 +132,10 @@ static bool is_special_name_folder_object(const char* path);
 static int chk_dir_object_type(const char* path, std::string& newpath, std::string& nowpath, std::string& nowcache, headers_t* pmeta = NULL, dirtype* pDirType = NULL);
 static int remove_old_type_dir(const std::string& path, dirtype type);
 static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t* pmeta = NULL, bool overcheck = true, bool* pisforce = NULL, bool add_no_truncate_cache = false, bool refresh_fakemeta = false);
+static int get_object_attribute_nocache(const char* path, struct stat* pstat, headers_t* pheader, bool overcheck, bool* pisforce, bool add_no_truncate_cache);
+static int probe_object_attribute(const char* path, headers_t& meta, std::string& strpath, bool& isforce);
+static void* stat_revalidate_worker(void* arg);
+static bool revalidate_object_attribute(const char* path, const std::string& key, bool overcheck);
 static int check_object_access(const char* path, int mask, struct stat* pstbuf);
 static int check_object_owner(const char* path, struct stat* pstbuf);
 static int check_parent_object_access(const char* path, int mask);
@@ -123,7 +144,14 @@ static bool multi_head_callback(S3fsCurl* s3fscurl);
 static S3fsCurl* multi_head_retry_callback(S3fsCurl* s3fscurl);
 static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf, fuse_fill_dir_t filler);
 static int list_bucket(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only = false);
+static int list_bucket_flat(const char* path, S3ObjList& flat, int max_keys);
+static int list_bucket_page(const char* path, S3ObjList& head, const char* delimiter, std::string& next_token, std::string& next_marker, bool& truncated);
+static int readdir_flat_list(const char* path, const S3ObjList& flat, S3ObjList& head);
+static int add_stats_from_listing(const std::string& strpath, const S3ObjList& list, bool subdir_only, bool stop_if_full, std::set<std::string>& dirobjs);
+static int stat_prewarm(const char* path);
 static int directory_empty(const char* path);
+static int directory_empty_shared(const char* path);
+static int delete_objects(const std::vector<std::string>& paths);
 static int rename_large_object(const char* from, const char* to);
 static int create_file_object(const char* path, mode_t mode, uid_t uid, gid_t gid);
 static int create_directory_object(const char* path, mode_t mode, time_t atime, time_t mtime, time_t ctime, uid_t uid, gid_t gid);
@@ -170,6 +198,7 @@ static int s3fs_fsync(const char* path, int datasync, struct fuse_file_info* fi)
 static int s3fs_release(const char* path, struct fuse_file_info* fi);
 static int s3fs_opendir(const char* path, struct fuse_file_info* fi);
 static int s3fs_readdir(const char* path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* fi);
+static int s3fs_releasedir(const char* path, struct fuse_file_info* fi);
 static int s3fs_access(const char* path, int mask);
 static void* s3fs_init(struct fuse_conn_info* conn);
 static void s3fs_destroy(void*);
@@ -217,8 +246,18 @@ static bool is_special_name_folder_object(const char* path)
         }
         strpath += "_$folder$";
     }
-    S3fsCurl s3fscurl;
-    if(0 != s3fscurl.HeadRequest(strpath.c_str(), header)){
+    // [NOTE]
+    // The same HEAD requests which are sent at the same time are
+    // coalesced, then the result is shared.
+    //
+    int         result;
+    std::string flightkey = "folder:" + strpath;
+    if(SingleFlight::getSingleFlight()->Enter(flightkey, result)){
+        S3fsCurl s3fscurl;
+        result = s3fscurl.HeadRequest(strpath.c_str(), header);
+        SingleFlight::getSingleFlight()->Leave(flightkey, result);
+    }
+    if(0 != result){
         return false;
     }
     header.clear();
@@ -256,7 +295,8 @@ static int chk_dir_object_type(const char* path, std::string& newpath, std::stri
     }
 
     // Always check "dir/" at first.
-    if(0 == (result = get_object_attribute(newpath.c_str(), NULL, pmeta, false, &isforce))){
+    // (the fake stats must not be used for checking the object type)
+    if(0 == (result = get_object_attribute(newpath.c_str(), NULL, pmeta, false, &isforce, false, is_refresh_fakemeta))){
         // Found "dir/" cache --> Check for "_$folder$", "no dir object"
         nowcache = newpath;
         if(is_special_name_folder_object(newpath.c_str())){     // check support_compat_dir in this function
@@ -281,7 +321,7 @@ static int chk_dir_object_type(const char* path, std::string& newpath, std::stri
     }else if(support_compat_dir){
         // Check "dir" when support_compat_dir is enabled
         nowpath.erase(newpath.length() - 1);
-        if(0 == (result = get_object_attribute(nowpath.c_str(), NULL, pmeta, false, &isforce))){
+        if(0 == (result = get_object_attribute(nowpath.c_str(), NULL, pmeta, false, &isforce, false, is_refresh_fakemeta))){
             // Found "dir" cache --> this case is only "dir" type.
             // Because, if object is "_$folder$" or "no dir object", the cache is "dir/" type.
             // (But "no dir object" is checked here.)
@@ -301,7 +341,7 @@ static int chk_dir_object_type(const char* path, std::string& newpath, std::stri
                 // "_$folder$" type.
                 (*pType) = DIRTYPE_FOLDER;
                 result   = 0;             // result is OK.
-            }else if(-ENOTEMPTY == directory_empty(newpath.c_str())){
+            }else if(-ENOTEMPTY == directory_empty_shared(newpath.c_str())){
                 // "no dir object" type.
                 (*pType) = DIRTYPE_NOOBJ;
                 nowpath  = "";            // now path.
@@ -344,15 +384,15 @@ static int remove_old_type_dir(const std::string& path, dirtype type)
 //
 static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t* pmeta, bool overcheck, bool* pisforce, bool add_no_truncate_cache, bool refresh_fakemeta)
 {
-    int          result = -1;
     struct stat  tmpstbuf;
     struct stat* pstat = pstbuf ? pstbuf : &tmpstbuf;
     headers_t    tmpHead;
     headers_t*   pheader = pmeta ? pmeta : &tmpHead;
     std::string  strpath;
-    S3fsCurl     s3fscurl;
     bool         forcedir = false;
+    bool*        pcacheforce;
     bool         fakemeta = false;
+    bool         isstale  = false;
     std::string::size_type Pos;
 
     S3FS_PRN_DBG("[path=%s]", path);
@@ -371,17 +411,21 @@ static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t
     }
 
     // Check cache.
-    pisforce    = (NULL != pisforce ? pisforce : &forcedir);
-    (*pisforce) = false;
-    strpath     = path;
+    pcacheforce    = (NULL != pisforce ? pisforce : &forcedir);
+    (*pcacheforce) = false;
+    strpath        = path;
     if(support_compat_dir && overcheck && std::string::npos != (Pos = strpath.find("_$folder$", 0))){
         strpath.erase(Pos);
         strpath += "/";
     }
-    if(StatCache::getStatCacheData()->GetStat(strpath, pstat, pheader, overcheck, pisforce, &fakemeta)){
+    if(StatCache::getStatCacheData()->GetStat(strpath, pstat, pheader, overcheck, pcacheforce, &fakemeta, &isstale)){
         if (refresh_fakemeta && fakemeta) {
             // igrone the fake meta
         } else {
+            if(isstale){
+                // returns the stale stats, and refresh it in background.
+                revalidate_object_attribute(path, strpath, overcheck);
+            }
             return 0;
         }
     }
@@ -389,76 +433,120 @@ static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t
         // there is the path in the cache for no object, it is no object.
         return -ENOENT;
     }
+    if(add_no_truncate_cache){
+        // this caller needs the entry which is not truncated, then do not share the result.
+        return get_object_attribute_nocache(path, pstat, pheader, overcheck, pisforce, add_no_truncate_cache);
+    }
 
-    // At first, check path
-    strpath     = path;
-    result      = s3fscurl.HeadRequest(strpath.c_str(), (*pheader));
-    s3fscurl.DestroyCurlHandle();
+    // [NOTE]
+    // If the requests for the same path are sent at the same time, only
+    // the first one checks the object and the others share the result.
+    //
+    // The leader always gets the flag of the "no dir object", because the
+    // waiters may need it even if the leader does not.
+    //
+    int         result;
+    std::string flightkey = std::string(overcheck ? "attr:" : "attr-nooverchk:") + path;
+    if(SingleFlight::getSingleFlight()->Enter(flightkey, result, pstat, pheader, pisforce)){
+        bool isforce = false;
+        result = get_object_attribute_nocache(path, pstat, pheader, overcheck, &isforce, add_no_truncate_cache);
+        if(pisforce){
+            (*pisforce) = isforce;
+        }
+        SingleFlight::getSingleFlight()->Leave(flightkey, result, pstat, pheader, isforce);
+    }
+    return result;
+}
 
-    // if not found target path object, do over checking
-    if(-EPERM == result){
-        // [NOTE]
-        // In case of a permission error, it exists in directory
-        // file list but inaccessible. So there is a problem that
-        // it will send a HEAD request every time, because it is
-        // not registered in the Stats cache.
-        // Therefore, even if the file has a permission error, it
-        // should be registered in the Stats cache. However, if
-        // the response without modifying is registered in the
-        // cache, the file permission will be 0644(umask dependent)
-        // because the meta header does not exist.
-        // Thus, set the mode of 0000 here in the meta header so
-        // that ossfs can print a permission error when the file
-        // is actually accessed.
-        // It is better not to set meta header other than mode,
-        // so do not do it.
-        //
-        (*pheader)["x-oss-meta-mode"] = str(0);
+//
+// Get object attributes from the server without checking stat cache,
+// and set them into stat cache.
+//
+static int get_object_attribute_nocache(const char* path, struct stat* pstat, headers_t* pheader, bool overcheck, bool* pisforce, bool add_no_truncate_cache)
+{
+    int          result = -1;
+    std::string  strpath;
+    S3fsCurl     s3fscurl;
+    bool         forcedir = false;
+    std::string::size_type Pos;
 
-    }else if(0 != result){
-        if(overcheck){
-            // when support_compat_dir is disabled, strpath maybe have "_$folder$".
-            if('/' != *strpath.rbegin() && std::string::npos == strpath.find("_$folder$", 0)){
-                // now path is "object", do check "object/" for over checking
-                strpath    += "/";
-                result      = s3fscurl.HeadRequest(strpath.c_str(), (*pheader));
-                s3fscurl.DestroyCurlHandle();
-            }
-            if(support_compat_dir && 0 != result){
-                // now path is "object/", do check "object_$folder$" for over checking
-                strpath.erase(strpath.length() - 1);
-                strpath    += "_$folder$";
-                result      = s3fscurl.HeadRequest(strpath.c_str(), (*pheader));
-                s3fscurl.DestroyCurlHandle();
+    pisforce    = (NULL != pisforce ? pisforce : &forcedir);
+    (*pisforce) = false;
+
+    if(is_parallel_probe && overcheck && '/' != path[strlen(path) - 1] && NULL == strstr(path, "_$folder$")){
+        // all candidates are checked at the same time.
+        result = probe_object_attribute(path, (*pheader), strpath, (*pisforce));
+    }else{
+        // At first, check path
+        strpath     = path;
+        result      = s3fscurl.HeadRequest(strpath.c_str(), (*pheader));
+        s3fscurl.DestroyCurlHandle();
+
+        // if not found target path object, do over checking
+        if(-EPERM == result){
+            // [NOTE]
+            // In case of a permission error, it exists in directory
+            // file list but inaccessible. So there is a problem that
+            // it will send a HEAD request every time, because it is
+            // not registered in the Stats cache.
+            // Therefore, even if the file has a permission error, it
+            // should be registered in the Stats cache. However, if
+            // the response without modifying is registered in the
+            // cache, the file permission will be 0644(umask dependent)
+            // because the meta header does not exist.
+            // Thus, set the mode of 0000 here in the meta header so
+            // that ossfs can print a permission error when the file
+            // is actually accessed.
+            // It is better not to set meta header other than mode,
+            // so do not do it.
+            //
+            (*pheader)["x-oss-meta-mode"] = str(0);
+
+        }else if(0 != result){
+            if(overcheck){
+                // when support_compat_dir is disabled, strpath maybe have "_$folder$".
+                if('/' != *strpath.rbegin() && std::string::npos == strpath.find("_$folder$", 0)){
+                    // now path is "object", do check "object/" for over checking
+                    strpath    += "/";
+                    result      = s3fscurl.HeadRequest(strpath.c_str(), (*pheader));
+                    s3fscurl.DestroyCurlHandle();
+                }
+                if(support_compat_dir && 0 != result){
+                    // now path is "object/", do check "object_$folder$" for over checking
+                    strpath.erase(strpath.length() - 1);
+                    strpath    += "_$folder$";
+                    result      = s3fscurl.HeadRequest(strpath.c_str(), (*pheader));
+                    s3fscurl.DestroyCurlHandle();
 
-              if(0 != result){
-                  // cut "_$folder$" for over checking "no dir object" after here
-                  if(std::string::npos != (Pos = strpath.find("_$folder$", 0))){
-                      strpath.erase(Pos);
+                  if(0 != result){
+                      // cut "_$folder$" for over checking "no dir object" after here
+                      if(std::string::npos != (Pos = strpath.find("_$folder$", 0))){
+                          strpath.erase(Pos);
+                      }
                   }
-              }
-            }
-        }
-        if(support_compat_dir && 0 != result && std::string::npos == strpath.find("_$folder$", 0)){
-            // now path is "object" or "object/", do check "no dir object" which is not object but has only children.
-            if('/' == *strpath.rbegin()){
-                strpath.erase(strpath.length() - 1);
+                }
             }
-            if(-ENOTEMPTY == directory_empty(strpath.c_str())){
-                // found "no dir object".
-                strpath  += "/";
-                *pisforce = true;
-                result    = 0;
+            if(support_compat_dir && 0 != result && std::string::npos == strpath.find("_$folder$", 0)){
+                // now path is "object" or "object/", do check "no dir object" which is not object but has only children.
+                if('/' == *strpath.rbegin()){
+                    strpath.erase(strpath.length() - 1);
+                }
+                if(-ENOTEMPTY == directory_empty_shared(strpath.c_str())){
+                    // found "no dir object".
+                    strpath  += "/";
+                    *pisforce = true;
+                    result    = 0;
+                }
             }
-        }
-    }else{
-        if(support_compat_dir && '/' != *strpath.rbegin() && std::string::npos == strpath.find("_$folder$", 0) && is_need_check_obj_detail(*pheader)){
-            // check a case of that "object" does not have attribute and "object" is possible to be directory.
-            if(-ENOTEMPTY == directory_empty(strpath.c_str())){
-                // found "no dir object".
-                strpath  += "/";
-                *pisforce = true;
-                result    = 0;
+        }else{
+            if(support_compat_dir && '/' != *strpath.rbegin() && std::string::npos == strpath.find("_$folder$", 0) && is_need_check_obj_detail(*pheader)){
+                // check a case of that "object" does not have attribute and "object" is possible to be directory.
+                if(-ENOTEMPTY == directory_empty_shared(strpath.c_str())){
+                    // found "no dir object".
+                    strpath  += "/";
+                    *pisforce = true;
+                    result    = 0;
+                }
             }
         }
     }
@@ -511,6 +599,216 @@ static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t
     return 0;
 }
 
+//
+// Probe for the object type which is sent with the others at the same time
+//
+struct attr_probe
+{
+    std::string path;
+    headers_t   meta;
+    int         result;
+    S3fsCurl*   s3fscurl;
+    Semaphore*  psem;           // posted when the request sent by curl multi engine is finished
+    bool        is_sent;
+
+    attr_probe() : result(-EIO), s3fscurl(NULL), psem(NULL), is_sent(false) {}
+    ~attr_probe()
+    {
+        delete s3fscurl;
+    }
+};
+
+//
+// Called in the I/O thread of curl multi engine
+//
+static void attr_probe_done(S3fsCurl* s3fscurl, int result, void* param)
+{
+    attr_probe* pprobe = static_cast<attr_probe*>(param);
+
+    s3fscurl->ReleaseRequestSlot();
+    CurlConcurrency::Release(s3fscurl->GetRequestClass(), s3fscurl, result);
+
+    if(0 == (pprobe->result = result)){
+        s3fscurl->GetHeadResponseMeta(pprobe->meta);
+    }
+    pprobe->psem->post();
+}
+
+//
+// Send HEAD requests of the probes at the same time by curl multi engine.
+// If the engine is not running, or the request is failed by other than
+// no object and no permission(ex. the object needs SSE-C key), it is sent
+// again by HeadRequest in this thread.
+//
+static void attr_probe_heads(attr_probe* probes, int count)
+{
+    if(CurlMultiEngine::IsRunning() && 1 < count){
+        Semaphore sem(0);
+        int       sent = 0;
+        for(int cnt = 0; cnt < count; ++cnt){
+            attr_probe* pprobe = &probes[cnt];
+            pprobe->s3fscurl   = new S3fsCurl();
+            pprobe->psem       = &sem;
+            if(!pprobe->s3fscurl->PreHeadRequest(pprobe->path.c_str())){
+                continue;
+            }
+            CurlConcurrency::Acquire(pprobe->s3fscurl->GetRequestClass());
+            pprobe->s3fscurl->AcquireRequestSlot();
+
+            if(!CurlMultiEngine::Request(pprobe->s3fscurl, attr_probe_done, pprobe)){
+                S3FS_PRN_WARN("failed to send a request by curl multi engine, then probe %s in this thread.", pprobe->path.c_str());
+                pprobe->s3fscurl->ReleaseRequestSlot();
+                CurlConcurrency::Release(pprobe->s3fscurl->GetRequestClass(), NULL, -EIO);
+                continue;
+            }
+            pprobe->is_sent = true;
+            ++sent;
+        }
+        for(int cnt = 0; cnt < sent; ++cnt){
+            sem.wait();
+        }
+    }
+
+    for(int cnt = 0; cnt < count; ++cnt){
+        attr_probe* pprobe = &probes[cnt];
+        if(pprobe->is_sent && (0 == pprobe->result || -ENOENT == pprobe->result || -EPERM == pprobe->result)){
+            continue;
+        }
+        S3fsCurl s3fscurl;
+        pprobe->result = s3fscurl.HeadRequest(pprobe->path.c_str(), pprobe->meta);
+    }
+}
+
+//
+// Check "object" at first, and decide the result in the same order as
+// checking them one by one in get_object_attribute_nocache().
+// If "object" is found with its complete meta, it is the answer as soon as
+// the response. Otherwise "object/" and "object_$folder$" are checked at
+// the same time, and the listing for "no dir object" is sent only when
+// "object" does not have the complete meta or all of them are not found.
+// Then the directory which is not in the cache is found in two round trips
+// instead of up to four, and the file costs one request as without this.
+//
+static int probe_object_attribute(const char* path, headers_t& meta, std::string& strpath, bool& isforce)
+{
+    enum { PROBE_DIR = 0, PROBE_FOLDER, PROBE_MAX };
+
+    int result;
+    isforce = false;
+    strpath = path;
+
+    // "object"
+    {
+        S3fsCurl s3fscurl;
+        result = s3fscurl.HeadRequest(path, meta);
+    }
+    if(-EPERM == result){
+        // same as get_object_attribute_nocache()
+        meta["x-oss-meta-mode"] = str(0);
+        return result;
+    }
+    if(0 == result){
+        if(support_compat_dir && is_need_check_obj_detail(meta) && -ENOTEMPTY == directory_empty_shared(path)){
+            // found "no dir object".
+            strpath += "/";
+            isforce  = true;
+        }
+        return result;
+    }
+
+    // "object/" and "object_$folder$"
+    attr_probe probes[PROBE_MAX];
+    int        probe_cnt = support_compat_dir ? PROBE_MAX : PROBE_FOLDER;
+
+    probes[PROBE_DIR].path    = std::string(path) + "/";
+    probes[PROBE_FOLDER].path = std::string(path) + "_$folder$";
+    attr_probe_heads(probes, probe_cnt);
+
+    for(int cnt = 0; cnt < probe_cnt; ++cnt){
+        result = probes[cnt].result;
+        meta   = probes[cnt].meta;
+        if(0 == result){
+            strpath = probes[cnt].path;
+            return result;
+        }
+    }
+
+    if(support_compat_dir && -ENOTEMPTY == directory_empty_shared(path)){
+        // found "no dir object".
+        strpath  = std::string(path) + "/";
+        isforce  = true;
+        result   = 0;
+    }
+    return result;
+}
+
+//
+// Stale-while-revalidate for stat cache
+//
+struct stat_revalidate_param
+{
+    std::string path;
+    std::string key;
+    bool        overcheck;
+
+    stat_revalidate_param() : overcheck(true) {}
+};
+
+static void* stat_revalidate_worker(void* arg)
+{
+    stat_revalidate_param* pparam = static_cast<stat_revalidate_param*>(arg);
+    if(!pparam){
+        return reinterpret_cast<void*>(-EIO);
+    }
+    S3FS_PRN_INFO3("revalidate stat cache[path=%s][key=%s]", pparam->path.c_str(), pparam->key.c_str());
+
+    struct stat stbuf;
+    headers_t   meta;
+    int         result = get_object_attribute_nocache(pparam->path.c_str(), &stbuf, &meta, pparam->overcheck, NULL, false);
+    if(0 != result){
+        // The object is not found or could not be checked, thus the stale
+        // stats must not be returned anymore.
+        StatCache::getStatCacheData()->DelStat(pparam->key);
+    }
+    StatCache::getStatCacheData()->FinishRevalidate(pparam->key);
+    delete pparam;
+
+    return NULL;
+}
+
+//
+// Schedule refreshing the stale stat cache entry.
+// Only one request per key is in flight, the other callers keep getting
+// the stale stats until it is refreshed or the stale window is over.
+//
+static bool revalidate_object_attribute(const char* path, const std::string& key, bool overcheck)
+{
+    if(!StatCache::getStatCacheData()->StartRevalidate(key)){
+        // already refreshing
+        return true;
+    }
+
+    stat_revalidate_param* pparam = new stat_revalidate_param;
+    pparam->path      = path;
+    pparam->key       = key;
+    pparam->overcheck = overcheck;
+
+    thpoolman_param* ppoolparam = new thpoolman_param;
+    ppoolparam->args  = pparam;
+    ppoolparam->psem  = NULL;
+    ppoolparam->pfunc = stat_revalidate_worker;
+
+    if(!ThreadPoolMan::Instruct(ppoolparam)){
+        S3FS_PRN_ERR("failed setup instruction for revalidating stat cache, then remove it[path=%s].", path);
+        StatCache::getStatCacheData()->DelStat(key);
+        StatCache::getStatCacheData()->FinishRevalidate(key);
+        delete pparam;
+        delete ppoolparam;
+        return false;
+    }
+    return true;
+}
+
 //
 // Check the object uid and gid for write/read/execute.
 // The param "mask" is as same as access() function.
@@ -1088,6 +1386,22 @@ static int directory_empty(const char* path)
     return 0;
 }
 
+//
+// Same as directory_empty(), but the same requests which are sent at the
+// same time are coalesced. This is used only for checking the object type,
+// do not use this for checking before removing directory.
+//
+static int directory_empty_shared(const char* path)
+{
+    int         result;
+    std::string flightkey = std::string("empty:") + path;
+    if(SingleFlight::getSingleFlight()->Enter(flightkey, result)){
+        result = directory_empty(path);
+        SingleFlight::getSingleFlight()->Leave(flightkey, result);
+    }
+    return result;
+}
+
 static int s3fs_rmdir(const char* _path)
 {
     WTF8_ENCODE(path)
@@ -1420,152 +1734,345 @@ static int clone_directory_object(const char* from, const char* to, bool update_
     return result;
 }
 
-static int rename_directory(const char* from, const char* to)
+//
+// Delete objects by DeleteMultipleObjects requests
+//
+// The paths are divided by the maximum keys of one request. If the request
+// itself fails(ex. the API is not allowed), the objects in it are deleted
+// one by one. Returns the first error of the objects.
+//
+static int delete_objects(const std::vector<std::string>& paths)
 {
-    S3ObjList head;
-    s3obj_list_t headlist;
-    std::string strfrom  = from ? from : "";   // from is without "/".
-    std::string strto    = to ? to : "";       // to is without "/" too.
-    std::string basepath = strfrom + "/";
-    std::string newpath;                       // should be from name(not used)
-    std::string nowcache;                      // now cache path(not used)
-    dirtype DirType;
-    bool normdir; 
-    MVNODE* mn_head = NULL;
-    MVNODE* mn_tail = NULL;
-    MVNODE* mn_cur;
-    struct stat stbuf;
-    int result;
-    bool is_dir;
+    int result = 0;
 
-    S3FS_PRN_INFO1("[from=%s][to=%s]", from, to);
+    S3FS_PRN_INFO2("[objects=%zu]", paths.size());
 
-    //
-    // Initiate and Add base directory into MVNODE struct.
-    //
-    strto += "/";
-    if(0 == chk_dir_object_type(from, newpath, strfrom, nowcache, NULL, &DirType) && DIRTYPE_UNKNOWN != DirType){
-        if(DIRTYPE_NOOBJ != DirType){
-            normdir = false;
-        }else{
-            normdir = true;
-            strfrom = from;               // from directory is not removed, but from directory attr is needed.
+    for(size_t start = 0; start < paths.size(); start += S3fsCurl::S3FSCURL_DELETEMULTI_MAX_KEYS){
+        size_t                   last = std::min(paths.size(), start + S3fsCurl::S3FSCURL_DELETEMULTI_MAX_KEYS);
+        std::vector<std::string> chunk(paths.begin() + start, paths.begin() + last);
+        delete_errors_t          errors;
+        int                      chunkresult;
+
+        {
+            S3fsCurl s3fscurl;
+            chunkresult = s3fscurl.DeleteMultipleObjectsRequest(chunk, errors);
+        }
+        if(0 != chunkresult){
+            S3FS_PRN_WARN("DeleteMultipleObjects request failed(%d), so delete %zu objects one by one.", chunkresult, chunk.size());
+            errors.clear();
+            for(std::vector<std::string>::const_iterator iter = chunk.begin(); iter != chunk.end(); ++iter){
+                S3fsCurl s3fscurl;
+                int      delresult = s3fscurl.DeleteRequest(iter->c_str());
+                if(0 != delresult && -ENOENT != delresult){
+                    errors[*iter] = delresult;
+                }
+            }
         }
-        if(NULL == (add_mvnode(&mn_head, &mn_tail, strfrom.c_str(), strto.c_str(), true, normdir))){
-            return -ENOMEM;
+        if(0 == result && !errors.empty()){
+            result = errors.begin()->second;
         }
-    }else{
-        // Something wrong about "from" directory.
     }
+    return result;
+}
+
+//
+// Parameter for renaming the objects in the tree
+//
+struct rename_tree_param
+{
+    std::string              top_from;      // the top directory object(from)
+    pthread_mutex_t          lock;
+    std::set<std::string>    checked_dirs;  // parent directories which the access is checked
+    std::vector<std::string> delobjs;       // old file objects which are deleted after copying all files
+    std::vector<std::string> delkeys;       // stat cache keys which are deleted after renaming files
+    std::vector<std::string> delfiles;      // cache files left in old paths, which are deleted after renaming files
+};
+
+//
+// List all objects under the directory by one listing, and make the
+// entries of the tree. The type of the object is decided from the listing,
+// only the object which can be an old type directory("dir", "_$folder$")
+// is checked by HEAD request.
+//
+static int list_object_tree(const char* from, const char* to, treewalk_list_t& list)
+{
+    S3ObjList    head;
+    s3obj_list_t headlist;
+    std::string  basepath = std::string(from) + "/";
+    std::string  strto    = std::string(to) + "/";
+    std::string  newpath;                   // should be from name(not used)
+    std::string  nowcache;                  // now cache path(not used)
+    dirtype      DirType;
+    struct stat  stbuf;
+    int          result;
 
-    //
-    // get a list of all the objects
-    //
     // No delimiter is specified, the result(head) is all object keys.
     // (CommonPrefixes is empty, but all object is listed in Key.)
     if(0 != (result = list_bucket(basepath.c_str(), head, NULL))){
         S3FS_PRN_ERR("list_bucket returns error.");
-        return result; 
+        return result;
     }
     head.GetNameList(headlist);                       // get name without "/".
     S3ObjList::MakeHierarchizedList(headlist, false); // add hierarchized dir.
 
-    s3obj_list_t::const_iterator liter;
-    for(liter = headlist.begin(); headlist.end() != liter; ++liter){
-        // make "from" and "to" object name.
-        std::string from_name = basepath + (*liter);
-        std::string to_name   = strto + (*liter);
-        std::string etag      = head.GetETag((*liter).c_str());
-
-        // Check subdirectory.
-        StatCache::getStatCacheData()->HasStat(from_name, etag.c_str()); // Check ETag
-        if(0 != get_object_attribute(from_name.c_str(), &stbuf, NULL)){
-            S3FS_PRN_WARN("failed to get %s object attribute.", from_name.c_str());
-            continue;
-        }
-        if(S_ISDIR(stbuf.st_mode)){
-            is_dir = true;
-            if(0 != chk_dir_object_type(from_name.c_str(), newpath, from_name, nowcache, NULL, &DirType) || DIRTYPE_UNKNOWN == DirType){
-                S3FS_PRN_WARN("failed to get %s%s object directory type.", basepath.c_str(), (*liter).c_str());
+    for(s3obj_list_t::const_iterator liter = headlist.begin(); headlist.end() != liter; ++liter){
+        const std::string& name    = *liter;
+        std::string        dirname = name + "/";
+
+        treewalk_entry entry;
+        entry.old_path = basepath + name;
+        entry.new_path = strto + name;
+        entry.depth    = 1 + static_cast<int>(std::count(name.begin(), name.end(), '/'));
+
+        if(!support_compat_dir && head.IsDir(dirname.c_str()) && dirname == head.GetOrgName(dirname.c_str())){
+            // "dir/" object
+            entry.old_path += "/";
+            entry.etag      = head.GetETag(dirname.c_str());
+            entry.is_dir    = true;
+        }else if(!support_compat_dir && head.GetNormalizedName(dirname.c_str()).empty() && head.GetNormalizedName(name.c_str()).empty()){
+            // no object, the directory is only a part of the object names
+            entry.is_dir     = true;
+            entry.is_normdir = true;
+        }else if(name == head.GetNormalizedName(name.c_str()) && !head.IsDir(name.c_str()) && 0 < head.GetSize(name.c_str())){
+            // file object(the empty object may be "dir" type directory)
+            entry.etag = head.GetETag(name.c_str());
+            entry.size = head.GetSize(name.c_str());
+        }else{
+            // Check the object type by HEAD request.
+            std::string from_name = entry.old_path;
+            StatCache::getStatCacheData()->HasStat(from_name, head.GetETag(name.c_str()).c_str()); // Check ETag
+            if(0 != get_object_attribute(from_name.c_str(), &stbuf, NULL)){
+                S3FS_PRN_WARN("failed to get %s object attribute.", from_name.c_str());
                 continue;
             }
-            if(DIRTYPE_NOOBJ != DirType){
-                normdir = false;
+            if(S_ISDIR(stbuf.st_mode)){
+                if(0 != chk_dir_object_type(from_name.c_str(), newpath, from_name, nowcache, NULL, &DirType) || DIRTYPE_UNKNOWN == DirType){
+                    S3FS_PRN_WARN("failed to get %s%s object directory type.", basepath.c_str(), name.c_str());
+                    continue;
+                }
+                entry.is_dir = true;
+                if(DIRTYPE_NOOBJ != DirType){
+                    entry.old_path = from_name;
+                }else{
+                    entry.is_normdir = true;    // from directory is not removed, but from directory attr is needed.
+                }
             }else{
-                normdir = true;
-                from_name = basepath + (*liter);  // from directory is not removed, but from directory attr is needed.
+                entry.size = stbuf.st_size;
             }
-        }else{
-            is_dir  = false;
-            normdir = false;
-        }
-        
-        // push this one onto the stack
-        if(NULL == add_mvnode(&mn_head, &mn_tail, from_name.c_str(), to_name.c_str(), is_dir, normdir)){
-            return -ENOMEM;
         }
+        list.push_back(entry);
     }
+    return 0;
+}
 
+static int rename_tree_directory(treewalk_entry& entry, void* data)
+{
+    rename_tree_param* pparam = static_cast<rename_tree_param*>(data);
+
+    // [NOTE]
+    // The ctime is updated only for the top (from) directory.
+    // Other than that, it will not be updated.
     //
-    // rename
-    //
-    // rename directory objects.
-    for(mn_cur = mn_head; mn_cur; mn_cur = mn_cur->next){
-        if(mn_cur->is_dir && mn_cur->old_path && '\0' != mn_cur->old_path[0]){
-            // [NOTE]
-            // The ctime is updated only for the top (from) directory.
-            // Other than that, it will not be updated.
-            //
-            if(0 != (result = clone_directory_object(mn_cur->old_path, mn_cur->new_path, (strfrom == mn_cur->old_path)))){
-                S3FS_PRN_ERR("clone_directory_object returned an error(%d)", result);
-                free_mvnodes(mn_head);
-                return result;
-            }
+    return clone_directory_object(entry.old_path.c_str(), entry.new_path.c_str(), (pparam->top_from == entry.old_path));
+}
+
+static int rename_tree_file(treewalk_entry& entry, void* data)
+{
+    rename_tree_param* pparam = static_cast<rename_tree_param*>(data);
+    const char*        from   = entry.old_path.c_str();
+    const char*        to     = entry.new_path.c_str();
+    int                result;
+
+    if(nocopyapi || norenameapi || FdManager::HasOpenEntityFd(from)){
+        // The file is uploaded from local, or the opened file is renamed with its cache.
+        if(!nocopyapi && !norenameapi){
+            return rename_object(from, to, false);          // keep ctime
+        }else{
+            return rename_object_nocopy(from, to, false);   // keep ctime
         }
     }
 
-    // iterate over the list - copy the files with rename_object
-    // does a safe copy - copies first and then deletes old
-    for(mn_cur = mn_head; mn_cur; mn_cur = mn_cur->next){
-        if(!mn_cur->is_dir){
-            if(!nocopyapi && !norenameapi){
-                result = rename_object(mn_cur->old_path, mn_cur->new_path, false);          // keep ctime
-            }else{
-                result = rename_object_nocopy(mn_cur->old_path, mn_cur->new_path, false);   // keep ctime
-            }
-            if(0 != result){
-                S3FS_PRN_ERR("rename_object returned an error(%d)", result);
-                free_mvnodes(mn_head);
-                return result;
-            }
+    // check the access of parent directories only once for each directory
+    bool is_check;
+    {
+        AutoLock lock(&pparam->lock);
+        is_check = pparam->checked_dirs.insert(mydirname(entry.old_path)).second;
+    }
+    if(is_check){
+        if(0 != (result = check_parent_object_access(to, W_OK | X_OK))){
+            // not permit writing "to" object parent dir.
+            return result;
+        }
+        if(0 != (result = check_parent_object_access(from, W_OK | X_OK))){
+            // not permit removing "from" object parent dir.
+            return result;
         }
     }
 
-    // Iterate over old the directories, bottoms up and remove
-    for(mn_cur = mn_tail; mn_cur; mn_cur = mn_cur->prev){
-        if(mn_cur->is_dir && mn_cur->old_path && '\0' != mn_cur->old_path[0]){
-            if(!(mn_cur->is_normdir)){
-                if(0 != (result = s3fs_rmdir(mn_cur->old_path))){
-                    S3FS_PRN_ERR("s3fs_rmdir returned an error(%d)", result);
-                    free_mvnodes(mn_head);
-                    return result;
-                }
-            }else{
-                // cache clear.
-                StatCache::getStatCacheData()->DelStat(mn_cur->old_path);
-            }
-        }
+    headers_t   meta;
+    struct stat buf;
+    if(0 != (result = get_object_attribute(from, &buf, &meta, true, NULL, false, is_refresh_fakemeta))){
+        return result;
+    }
+    meta["x-oss-copy-source"]        = urlEncode(service_path + S3fsCred::GetBucket() + get_realpath(from));
+    meta["Content-Type"]             = S3fsCurl::LookupMimeType(entry.new_path);
+    meta["x-oss-metadata-directive"] = "REPLACE";
+
+    // copy, the old object is removed with others by batch request
+    if(0 != (result = put_headers(to, meta, true, /* use_st_size= */ false))){
+        return result;
     }
-    free_mvnodes(mn_head);
 
+    // rename the local cache as rename_object()
+    FdManager::get()->Rename(from, to);
+
+    // the caches are deleted at once after renaming all files
+    AutoLock lock(&pparam->lock);
+    pparam->delobjs.push_back(entry.old_path);
+    pparam->delkeys.push_back(entry.old_path);
+    pparam->delkeys.push_back(entry.new_path);
+    if(FdManager::IsCacheDir()){
+        pparam->delfiles.push_back(entry.old_path);
+    }
     return 0;
 }
 
-static int s3fs_rename(const char* _from, const char* _to)
+static int remove_tree_directory(treewalk_entry& entry, void* data)
 {
-    WTF8_ENCODE(from)
-    WTF8_ENCODE(to)
-    struct stat buf;
+    if(entry.is_normdir){
+        // cache clear.
+        StatCache::getStatCacheData()->DelStat(entry.old_path);
+        return 0;
+    }
+    return s3fs_rmdir(entry.old_path.c_str());
+}
+
+static bool is_deeper_treewalk_entry(const treewalk_entry* lhs, const treewalk_entry* rhs)
+{
+    return (lhs->depth > rhs->depth);
+}
+
+//
+// Rename the directory tree
+//
+// All objects are listed once, and the directories are cloned, the files
+// are renamed and the old directories are removed from the bottom, each
+// step is executed in parallel by TreeWalker.
+//
+static int rename_directory(const char* from, const char* to)
+{
+    treewalk_list_t list;
+    std::string strfrom  = from ? from : "";   // from is without "/".
+    std::string strto    = to ? to : "";       // to is without "/" too.
+    std::string newpath;                       // should be from name(not used)
+    std::string nowcache;                      // now cache path(not used)
+    dirtype DirType;
+    int result;
+
+    S3FS_PRN_INFO1("[from=%s][to=%s]", from, to);
+
+    //
+    // Initiate and Add base directory.
+    //
+    if(0 == chk_dir_object_type(from, newpath, strfrom, nowcache, NULL, &DirType) && DIRTYPE_UNKNOWN != DirType){
+        treewalk_entry top;
+        top.is_dir   = true;
+        top.new_path = strto + "/";
+        if(DIRTYPE_NOOBJ != DirType){
+            top.old_path   = strfrom;
+        }else{
+            top.old_path   = from;              // from directory is not removed, but from directory attr is needed.
+            top.is_normdir = true;
+            strfrom        = from;
+        }
+        list.push_back(top);
+    }else{
+        // Something wrong about "from" directory.
+    }
+
+    //
+    // get a list of all the objects
+    //
+    if(0 != (result = list_object_tree(from, to, list))){
+        return result;
+    }
+
+    treewalk_tasks_t dirs;
+    treewalk_tasks_t files;
+    for(treewalk_list_t::iterator iter = list.begin(); iter != list.end(); ++iter){
+        if(iter->is_dir){
+            if(!iter->old_path.empty()){
+                dirs.push_back(&(*iter));
+            }
+        }else{
+            files.push_back(&(*iter));
+        }
+    }
+
+    rename_tree_param param;
+    param.top_from = strfrom;
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+    pthread_mutex_init(&param.lock, &attr);
+#else
+    pthread_mutex_init(&param.lock, NULL);
+#endif
+
+    TreeWalker walker(S3fsCurl::GetMaxMultiRequest());
+
+    // rename directory objects.
+    if(0 != (result = walker.Execute(dirs, rename_tree_directory, &param))){
+        S3FS_PRN_ERR("clone_directory_object returned an error(%d)", result);
+    }
+
+    // copy the files and delete old ones.
+    if(0 == result && 0 != (result = walker.Execute(files, rename_tree_file, &param))){
+        S3FS_PRN_ERR("rename_object returned an error(%d)", result);
+    }
+    // the copied files are deleted even if other files failed.
+    int delresult;
+    if(0 != (delresult = delete_objects(param.delobjs))){
+        S3FS_PRN_ERR("delete_objects returned an error(%d)", delresult);
+        if(0 == result){
+            result = delresult;
+        }
+    }
+    StatCache::getStatCacheData()->DelStats(param.delkeys);
+    for(std::vector<std::string>::const_iterator iter = param.delfiles.begin(); iter != param.delfiles.end(); ++iter){
+        FdManager::DeleteCacheFile(iter->c_str());
+    }
+    pthread_mutex_destroy(&param.lock);
+
+    if(0 != result){
+        return result;
+    }
+
+    // remove old directories from the bottom, the directories in the same
+    // depth are removed at the same time.
+    std::stable_sort(dirs.begin(), dirs.end(), is_deeper_treewalk_entry);
+    for(treewalk_tasks_t::iterator start = dirs.begin(); start != dirs.end(); ){
+        treewalk_tasks_t::iterator last = start;
+        while(last != dirs.end() && (*last)->depth == (*start)->depth){
+            ++last;
+        }
+        treewalk_tasks_t level(start, last);
+        if(0 != (result = walker.Execute(level, remove_tree_directory, NULL))){
+            S3FS_PRN_ERR("s3fs_rmdir returned an error(%d)", result);
+            return result;
+        }
+        start = last;
+    }
+
+    return 0;
+}
+
+static int s3fs_rename(const char* _from, const char* _to)
+{
+    WTF8_ENCODE(from)
+    WTF8_ENCODE(to)
+    struct stat buf;
     int result;
 
     S3FS_PRN_INFO("[from=%s][to=%s]", from, to);
@@ -1643,6 +2150,10 @@ static int s3fs_chmod(const char* _path, mode_t mode)
     if(0 != (result = check_parent_object_access(path, X_OK))){
         return result;
     }
+    if(is_readdir_fake_dir){
+        // the fake directory stats from the listing is refreshed when it is actually used.
+        get_object_attribute(path, NULL, NULL, true, NULL, false, true);
+    }
     if(0 != (result = check_object_owner(path, &stbuf))){
         return result;
     }
@@ -1739,6 +2250,10 @@ static int s3fs_chmod_nocopy(const char* _path, mode_t mode)
     if(0 != (result = check_parent_object_access(path, X_OK))){
         return result;
     }
+    if(is_readdir_fake_dir){
+        // the fake directory stats from the listing is refreshed when it is actually used.
+        get_object_attribute(path, NULL, NULL, true, NULL, false, true);
+    }
     if(0 != (result = check_object_owner(path, &stbuf))){
         return result;
     }
@@ -1822,6 +2337,10 @@ static int s3fs_chown(const char* _path, uid_t uid, gid_t gid)
     if(0 != (result = check_parent_object_access(path, X_OK))){
         return result;
     }
+    if(is_readdir_fake_dir){
+        // the fake directory stats from the listing is refreshed when it is actually used.
+        get_object_attribute(path, NULL, NULL, true, NULL, false, true);
+    }
     if(0 != (result = check_object_owner(path, &stbuf))){
         return result;
     }
@@ -1924,6 +2443,10 @@ static int s3fs_chown_nocopy(const char* _path, uid_t uid, gid_t gid)
     if(0 != (result = check_parent_object_access(path, X_OK))){
         return result;
     }
+    if(is_readdir_fake_dir){
+        // the fake directory stats from the listing is refreshed when it is actually used.
+        get_object_attribute(path, NULL, NULL, true, NULL, false, true);
+    }
     if(0 != (result = check_object_owner(path, &stbuf))){
         return result;
     }
@@ -2597,6 +3120,41 @@ static int s3fs_release(const char* _path, struct fuse_file_info* fi)
     return 0;
 }
 
+//
+// Cursor of readdir for each opened directory(stored in fi->fh)
+//
+// The entries are numbered from 0 in order("." is 0 and ".." is 1), and
+// the offset passed to the filler is the number of the next entry. Only
+// the entries of the current page are kept in the cursor.
+//
+struct readdir_entry
+{
+    std::string name;
+    struct stat st;
+    bool        has_stat;
+};
+typedef std::vector<readdir_entry> readdir_entries_t;
+
+struct readdir_cursor
+{
+    std::string       next_token;
+    std::string       next_marker;
+    bool              truncated;      // whether there are pages which are not listed yet
+    off_t             page_offset;    // the number of the first entry in page
+    readdir_entries_t page;
+
+    readdir_cursor() { Reset(); }
+
+    void Reset()
+    {
+        next_token.clear();
+        next_marker.clear();
+        truncated   = true;
+        page_offset = 2;
+        page.clear();
+    }
+};
+
 static int s3fs_opendir(const char* _path, struct fuse_file_info* fi)
 {
     WTF8_ENCODE(path)
@@ -2605,14 +3163,34 @@ static int s3fs_opendir(const char* _path, struct fuse_file_info* fi)
 
     S3FS_PRN_INFO("[path=%s][flags=0x%x]", path, fi->flags);
 
+    if(is_readdir_fake_dir){
+        // the fake directory stats from the listing is refreshed when it is actually used.
+        get_object_attribute(path, NULL, NULL, true, NULL, false, true);
+    }
     if(0 == (result = check_object_access(path, mask, NULL))){
         result = check_parent_object_access(path, X_OK);
     }
+    if(0 == result && is_readdir_stream){
+        // the cursor of listing is kept until releasedir
+        fi->fh = reinterpret_cast<uint64_t>(new readdir_cursor());
+    }
     S3FS_MALLOCTRIM(0);
 
     return result;
 }
 
+static int s3fs_releasedir(const char* _path, struct fuse_file_info* fi)
+{
+    WTF8_ENCODE(path)
+    S3FS_PRN_INFO("[path=%s]", path);
+
+    if(is_readdir_stream && 0 != fi->fh){
+        delete reinterpret_cast<readdir_cursor*>(fi->fh);
+        fi->fh = 0;
+    }
+    return 0;
+}
+
 static bool multi_head_callback(S3fsCurl* s3fscurl)
 {
     if(!s3fscurl){
@@ -2664,14 +3242,10 @@ static S3fsCurl* multi_head_retry_callback(S3fsCurl* s3fscurl)
 static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf, fuse_fill_dir_t filler)
 {
     S3fsMultiCurl curlmulti(S3fsCurl::GetMaxMultiRequest());
-    s3obj_list_t  headlist;
     s3obj_list_t  fillerlist;
     int           result = 0;
 
-    S3FS_PRN_INFO1("[path=%s][list=%zu]", path, headlist.size());
-
-    // Make base path list.
-    head.GetNameList(headlist, true, false);  // get name with "/".
+    S3FS_PRN_INFO1("[path=%s][list=%zu]", path, head.Size());
 
     // Initialize S3fsMultiCurl
     curlmulti.SetSuccessCallback(multi_head_callback);
@@ -2681,9 +3255,13 @@ static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf
 
     fillerlist.clear();
     // Make single head request(with max).
-    for(iter = headlist.begin(); headlist.end() != iter; iter = headlist.erase(iter)){
-        std::string disppath = path + (*iter);
-        std::string etag     = head.GetETag((*iter).c_str());
+    for(S3ObjList::const_iterator hiter = head.begin(); head.end() != hiter; ++hiter){
+        if(hiter.is_normalized()){
+            continue;
+        }
+        std::string name     = hiter.name();          // name with "/"
+        std::string disppath = path + name;
+        std::string etag     = hiter.etag();
 
         std::string fillpath = disppath;
         if('/' == *disppath.rbegin()){
@@ -2695,10 +3273,18 @@ static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf
             continue;
         }
 
+        // The directory stats is built from the listing without HEAD request.
+        if(is_readdir_fake_dir && hiter.is_dir()){
+            if(!StatCache::getStatCacheData()->AddFakeDirStat(disppath, fake_dir_mode, fake_dir_uid, fake_dir_gid)){
+                S3FS_PRN_ERR("failed adding stat cache [path=%s]", disppath.c_str());
+            }
+            continue;
+        }
+
         // First check for directory, start checking "not SSE-C".
         // If checking failed, retry to check with "SSE-C" by retry callback func when SSE-C mode.
         S3fsCurl* s3fscurl = new S3fsCurl();
-        if(!s3fscurl->PreHeadRequest(disppath, (*iter), disppath)){  // target path = cache key path.(ex "dir/")
+        if(!s3fscurl->PreHeadRequest(disppath, name, disppath)){  // target path = cache key path.(ex "dir/")
             S3FS_PRN_WARN("Could not make curl object for head request(%s).", disppath.c_str());
             delete s3fscurl;
             continue;
@@ -2749,15 +3335,11 @@ static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf
 static int readdir_multi_head_optimize(const char* path, const S3ObjList& head, void* buf, fuse_fill_dir_t filler)
 {
     S3fsMultiCurl curlmulti(S3fsCurl::GetMaxMultiRequest());
-    s3obj_list_t  headlist;
     s3obj_list_t  fillerlist;
     int           result = 0;
     s3obj_list_t  reheadlist;
 
-    S3FS_PRN_INFO1("[path=%s][list=%zu]", path, headlist.size());
-
-    // Make base path list.
-    head.GetNameList(headlist, true, false);  // get name with "/".
+    S3FS_PRN_INFO1("[path=%s][list=%zu]", path, head.Size());
 
     // Initialize S3fsMultiCurl
     curlmulti.SetSuccessCallback(multi_head_callback);
@@ -2767,9 +3349,13 @@ static int readdir_multi_head_optimize(const char* path, const S3ObjList& head,
 
     fillerlist.clear();
     // Make single head request(with max).
-    for(iter = headlist.begin(); headlist.end() != iter; iter = headlist.erase(iter)){
-        std::string disppath = path + (*iter);
-        std::string etag     = head.GetETag((*iter).c_str());
+    for(S3ObjList::const_iterator hiter = head.begin(); head.end() != hiter; ++hiter){
+        if(hiter.is_normalized()){
+            continue;
+        }
+        std::string name     = hiter.name();          // name with "/"
+        std::string disppath = path + name;
+        std::string etag     = hiter.etag();
 
         std::string fillpath = disppath;
         if('/' == *disppath.rbegin()){
@@ -2782,27 +3368,31 @@ static int readdir_multi_head_optimize(const char* path, const S3ObjList& head,
         }
 
         //dir
-        bool isDir = head.IsDir((*iter).c_str());
+        bool isDir = hiter.is_dir();
+        if (isDir && is_readdir_fake_dir) {
+            if(!StatCache::getStatCacheData()->AddFakeDirStat(disppath, fake_dir_mode, fake_dir_uid, fake_dir_gid)){
+                S3FS_PRN_ERR("failed adding stat cache [path=%s]", disppath.c_str());
+            }
+            continue;
+        }
         if (isDir) {
-            reheadlist.push_back(*iter);
-            S3FS_PRN_DBG("reheadlist dir [path=%s]", (*iter).c_str());
+            reheadlist.push_back(name);
+            S3FS_PRN_DBG("reheadlist dir [path=%s]", name.c_str());
             continue;
         }
 
         //use headrequest to get extended info
-        std::string strsize = head.GetSize((*iter).c_str());
-        off_t size = get_size(strsize.c_str());
+        off_t size = hiter.size();
         if (is_check_meta(size, readdir_check_size)) {
-            reheadlist.push_back(*iter);
-            S3FS_PRN_DBG("reheadlist size limit [path=%s, size=%s]", (*iter).c_str(), strsize.c_str());
+            reheadlist.push_back(name);
+            S3FS_PRN_DBG("reheadlist size limit [path=%s, size=%lld]", name.c_str(), static_cast<long long>(size));
             continue;
         }
 
         // conver meta to header_t
-        std::string lastmodified = head.GetLastModified((*iter).c_str());
         headers_t headers;
-        headers["Content-Length"] = strsize;
-        headers["Last-Modified"] = utc_to_gmt(lastmodified.c_str());
+        headers["Content-Length"] = str(size);
+        headers["Last-Modified"] = time_to_gmt(hiter.last_modified());
         if(!StatCache::getStatCacheData()->AddStat(disppath, headers, /*forcedir*/false, /*no_truncate*/false, true)){
             S3FS_PRN_ERR("failed adding stat cache [path=%s]", disppath.c_str());
         }
@@ -2831,201 +3421,930 @@ static int readdir_multi_head_optimize(const char* path, const S3ObjList& head,
             S3FS_PRN_WARN("error occurred in multi request(errno=%d), but continue...", result);
             result = 0;
         }else{
-            S3FS_PRN_ERR("error occurred in multi request(errno=%d).", result);
-            return result;
+            S3FS_PRN_ERR("error occurred in multi request(errno=%d).", result);
+            return result;
+        }
+    }
+
+    // if the dir exists in reheadlist, but is not in stat cache,
+    // it is just a common prefix, need add to stat cache.
+    headers_t emptyheaders;
+    for(iter = reheadlist.begin(); reheadlist.end() != iter; iter = reheadlist.erase(iter)){
+        std::string disppath = path + (*iter);
+        bool isDir = head.IsDir((*iter).c_str());
+        if (isDir) {
+            if (!StatCache::getStatCacheData()->HasStat(disppath)) {
+                if(!StatCache::getStatCacheData()->AddStat(disppath, emptyheaders, isDir)){
+                    S3FS_PRN_ERR("failed adding stat cache [path=%s]", disppath.c_str());
+                }
+            }
+        }
+    }
+
+    // populate fuse buffer
+    // here is best position, because a case is cache size < files in directory
+    //
+    for(iter = fillerlist.begin(); fillerlist.end() != iter; ++iter){
+        struct stat st;
+        bool in_cache = StatCache::getStatCacheData()->GetStat((*iter), &st);
+        std::string bpath = mybasename((*iter));
+        if(use_wtf8){
+            bpath = s3fs_wtf8_decode(bpath);
+        }
+        if(in_cache){
+            filler(buf, bpath.c_str(), &st, 0);
+        }else{
+            S3FS_PRN_INFO2("Could not find %s file in stat cache.", (*iter).c_str());
+            filler(buf, bpath.c_str(), 0, 0);
+        }
+    }
+
+    return result;
+}
+
+//
+// Filler for readdir_multi_head which stores the entries into the page of cursor
+//
+static int readdir_page_filler(void* buf, const char* name, const struct stat* stbuf, off_t off)
+{
+    readdir_entries_t* ppage = static_cast<readdir_entries_t*>(buf);
+    readdir_entry      entry;
+
+    entry.name     = name;
+    entry.has_stat = (NULL != stbuf);
+    if(stbuf){
+        entry.st = *stbuf;
+    }else{
+        memset(&entry.st, 0, sizeof(struct stat));
+    }
+    ppage->push_back(entry);
+    return 0;
+}
+
+//
+// List the next page of the directory and get stats of it into the cursor
+//
+static int readdir_next_page(const char* path, readdir_cursor* pcursor)
+{
+    S3ObjList head;
+    int       result;
+
+    pcursor->page_offset += static_cast<off_t>(pcursor->page.size());
+    pcursor->page.clear();
+
+    if(0 != (result = list_bucket_page(path, head, "/", pcursor->next_token, pcursor->next_marker, pcursor->truncated))){
+        S3FS_PRN_ERR("list_bucket_page returns error(%d).", result);
+        return result;
+    }
+    if(head.IsEmpty()){
+        return 0;
+    }
+
+    std::string strpath = path;
+    if(strcmp(path, "/") != 0){
+        strpath += "/";
+    }
+    if(is_readdir_optimize){
+        result = readdir_multi_head_optimize(strpath.c_str(), head, &pcursor->page, readdir_page_filler);
+    }else{
+        result = readdir_multi_head(strpath.c_str(), head, &pcursor->page, readdir_page_filler);
+    }
+    if(0 != result){
+        S3FS_PRN_ERR("readdir_multi_head, optimize(%d) returns error(%d).", is_readdir_optimize, result);
+    }
+    return result;
+}
+
+//
+// readdir which lists and fills entries page by page with the offset of FUSE
+//
+static int readdir_stream(const char* path, void* buf, fuse_fill_dir_t filler, off_t offset, readdir_cursor* pcursor)
+{
+    int result;
+
+    S3FS_PRN_INFO("[path=%s][offset=%lld]", path, static_cast<long long>(offset));
+
+    if(0 == offset || offset < pcursor->page_offset){
+        // rewind, or seek to the entry which is already dropped.
+        if(0 == offset && 0 != (result = check_object_access(path, R_OK, NULL))){
+            return result;
+        }
+        pcursor->Reset();
+    }
+    if(offset < 1 && 0 != filler(buf, ".", 0, 1)){
+        return 0;
+    }
+    if(offset < 2 && 0 != filler(buf, "..", 0, 2)){
+        return 0;
+    }
+
+    off_t pos = std::max(offset, static_cast<off_t>(2));
+    while(true){
+        for(; pos < pcursor->page_offset + static_cast<off_t>(pcursor->page.size()); ++pos){
+            const readdir_entry& entry = pcursor->page[pos - pcursor->page_offset];
+            if(0 != filler(buf, entry.name.c_str(), (entry.has_stat ? &entry.st : 0), pos + 1)){
+                // buffer is full, the rest is filled by the next call.
+                return 0;
+            }
+        }
+        if(!pcursor->truncated){
+            break;
+        }
+        if(0 != (result = readdir_next_page(path, pcursor))){
+            return result;
+        }
+    }
+    S3FS_MALLOCTRIM(0);
+
+    return 0;
+}
+
+static int s3fs_readdir(const char* _path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* fi)
+{
+    WTF8_ENCODE(path)
+    S3ObjList head;
+    int result;
+
+    if(is_readdir_stream && fi && 0 != fi->fh){
+        return readdir_stream(path, buf, filler, offset, reinterpret_cast<readdir_cursor*>(fi->fh));
+    }
+
+    S3FS_PRN_INFO("[path=%s]", path);
+
+    if(0 != (result = check_object_access(path, R_OK, NULL))){
+        return result;
+    }
+
+    // get a list of all the objects
+    S3ObjList flat;
+    if(is_readdir_optimize && 0 < readdir_flat_list_max_keys && 0 == list_bucket_flat(path, flat, readdir_flat_list_max_keys)){
+        // all objects under the path are listed, then make the list of children from it.
+        readdir_flat_list(path, flat, head);
+    }else if((result = list_bucket(path, head, "/")) != 0){
+        S3FS_PRN_ERR("list_bucket returns error(%d).", result);
+        return result;
+    }
+
+    // force to add "." and ".." name.
+    filler(buf, ".", 0, 0);
+    filler(buf, "..", 0, 0);
+    if(head.IsEmpty()){
+        return 0;
+    }
+
+    // Send multi head request for stats caching.
+    std::string strpath = path;
+    if(strcmp(path, "/") != 0){
+        strpath += "/";
+    }
+
+    if (is_readdir_optimize){
+        result = readdir_multi_head_optimize(strpath.c_str(), head, buf, filler);
+    } else {
+        result = readdir_multi_head(strpath.c_str(), head, buf, filler);
+    }
+        
+    if (result != 0) {
+        S3FS_PRN_ERR("readdir_multi_head, optimize(%d) returns error(%d).", is_readdir_optimize, result);
+    }
+
+    S3FS_MALLOCTRIM(0);
+
+    return result;
+}
+
+//
+// Parameter for one page of listing objects
+//
+struct list_page_param
+{
+    S3fsCurl*         s3fscurl;
+    ListBucketParser* parser;
+    Semaphore*        psem;         // posted by the parser when the next marker is found
+    Semaphore*        pdone;        // posted when the request sent by curl multi engine is finished
+    bool              is_sent;      // whether the request is sent by curl multi engine(and not joined)
+    int               result;
+
+    list_page_param() : s3fscurl(NULL), parser(NULL), psem(NULL), pdone(NULL), is_sent(false), result(0) {}
+    ~list_page_param()
+    {
+        delete s3fscurl;
+        delete parser;
+        delete psem;
+        delete pdone;
+    }
+};
+
+typedef std::list<list_page_param*> list_page_list_t;
+
+//
+// Called in the I/O thread of curl multi engine
+//
+static void list_page_done(S3fsCurl* s3fscurl, int result, void* param)
+{
+    list_page_param* pparam = static_cast<list_page_param*>(param);
+
+    s3fscurl->ReleaseRequestSlot();
+    CurlConcurrency::Release(s3fscurl->GetRequestClass(), s3fscurl, result);
+
+    if(0 == result && !pparam->parser->Finish()){
+        S3FS_PRN_ERR("Could not parse the response of list bucket request.");
+        result = -EIO;
+    }
+    if(0 != result){
+        S3FS_PRN_ERR("ListBucketRequest returns with error(%d).", result);
+    }
+    pparam->result = result;
+
+    // wake up the caller, if the parser did not find the next marker.
+    pparam->parser->NotifyNext();
+    pparam->pdone->post();
+}
+
+//
+// Send the request of one page by curl multi engine, so that the pages are
+// received at the same time without a thread for each page.
+// If the engine is not running, the page is requested in this thread.
+//
+static void list_page_start(list_page_param* pparam, const char* path, const std::string& query)
+{
+    pparam->s3fscurl = new S3fsCurl();
+
+    if(CurlMultiEngine::IsRunning()){
+        if(0 != (pparam->result = pparam->s3fscurl->PreListBucketRequest(path, query.c_str(), pparam->parser))){
+            S3FS_PRN_ERR("PreListBucketRequest returns with error(%d).", pparam->result);
+            pparam->parser->NotifyNext();
+            return;
+        }
+        CurlConcurrency::Acquire(pparam->s3fscurl->GetRequestClass());
+        pparam->s3fscurl->AcquireRequestSlot();
+
+        if(!CurlMultiEngine::Request(pparam->s3fscurl, list_page_done, pparam)){
+            S3FS_PRN_ERR("failed to send a request by curl multi engine.");
+            pparam->s3fscurl->ReleaseRequestSlot();
+            CurlConcurrency::Release(pparam->s3fscurl->GetRequestClass(), NULL, -EIO);
+            pparam->result = -EIO;
+            pparam->parser->NotifyNext();
+            return;
+        }
+        pparam->is_sent = true;
+        return;
+    }
+
+    CurlConcurrency::Acquire(CURL_REQ_META);
+    if(0 != (pparam->result = pparam->s3fscurl->ListBucketRequest(path, query.c_str(), pparam->parser))){
+        S3FS_PRN_ERR("ListBucketRequest returns with error(%d).", pparam->result);
+    }
+    CurlConcurrency::Release(CURL_REQ_META, pparam->s3fscurl, pparam->result);
+    pparam->parser->NotifyNext();
+}
+
+static int list_page_join(list_page_param* pparam)
+{
+    if(pparam->is_sent){
+        pparam->pdone->wait();
+        pparam->is_sent = false;
+    }
+    return pparam->result;
+}
+
+//
+// Make the query for listing objects, the parameters must be in alphabetical order.
+//
+// [NOTE]
+// For ListObjectsV2, the start_after is used only when the token is empty.
+// For ListObjects(V1), the marker and the start_after are the same.
+//
+static std::string make_list_bucket_query(const std::string& query_delimiter, const std::string& query_maxkey, const std::string& query_prefix, const std::string& token, const std::string& marker)
+{
+    std::string query;
+    bool        is_v2 = S3fsCurl::IsListObjectsV2();
+
+    if(is_v2 && !token.empty()){
+        query += "continuation-token=" + urlEncode(token) + "&";
+    }
+    query += query_delimiter;
+    if(is_v2){
+        query += "list-type=2&";
+    }
+    if(!is_v2 && !marker.empty()){
+        query += "marker=" + urlEncode(marker) + "&";
+    }
+    query += query_maxkey;
+    query += query_prefix;
+    if(is_v2 && token.empty() && !marker.empty()){
+        query += "&start-after=" + urlEncode(marker);
+    }
+    return query;
+}
+
+//
+// The range of listing objects, whose keys are in (start_after, end_key].
+// If end_key is empty, lists to the last.
+//
+struct list_range_param
+{
+    std::string      end_key;
+    std::string      next_token;
+    std::string      next_marker;   // start_after at first
+    list_page_list_t inflights;
+    list_page_param* pcurrent;      // the page whose next marker is not known yet
+    bool             is_done;       // all pages of the range are sent
+    int              result;
+
+    list_range_param() : pcurrent(NULL), is_done(false), result(0) {}
+};
+
+typedef std::vector<list_range_param> list_range_list_t;
+
+//
+// Send the request of the next page in the range, after waiting for the
+// oldest page if too many pages are in flight.
+//
+static void list_range_send(const char* path, const std::string& query_delimiter, const std::string& query_maxkey, const std::string& query_prefix, list_range_param& range, S3ObjList& head, pthread_mutex_t* plock, int max_inflight)
+{
+    while(static_cast<int>(range.inflights.size()) >= max_inflight){
+        list_page_param* pold = range.inflights.front();
+        range.inflights.pop_front();
+        if(0 != list_page_join(pold)){
+            range.result = pold->result;
+        }
+        delete pold;
+    }
+    if(0 != range.result){
+        range.is_done = true;
+        return;
+    }
+
+    list_page_param* pparam = new list_page_param();
+    pparam->parser          = new ListBucketParser(path, head, plock, (range.end_key.empty() ? NULL : range.end_key.c_str()));
+    pparam->psem            = new Semaphore(0);
+    pparam->pdone           = new Semaphore(0);
+    pparam->parser->SetNextNotify(pparam->psem);
+
+    std::string query = make_list_bucket_query(query_delimiter, query_maxkey, query_prefix, range.next_token, range.next_marker);
+    range.next_token.clear();
+    range.inflights.push_back(pparam);
+    range.pcurrent = pparam;
+
+    list_page_start(pparam, path, query);
+}
+
+//
+// Wait until the next marker(or token) of the current page in the range is
+// known, and set the position of the next page.
+//
+static void list_range_next(list_range_param& range)
+{
+    list_page_param* pparam = range.pcurrent;
+    range.pcurrent          = NULL;
+
+    pparam->psem->wait();
+
+    if(!pparam->parser->IsNotifiedTruncated()){
+        range.is_done = true;
+        return;
+    }
+    if(S3fsCurl::IsListObjectsV2() && !pparam->parser->GetNotifiedContinuationToken().empty() && range.end_key.empty()){
+        range.next_token = pparam->parser->GetNotifiedContinuationToken();
+        return;
+    }
+    if(!S3fsCurl::IsListObjectsV2() && !pparam->parser->GetNotifiedMarker().empty()){
+        range.next_marker = pparam->parser->GetNotifiedMarker();
+    }else{
+        // If did not specify "delimiter", s3 did not return "NextMarker".
+        // And the token can not tell whether it is over the end key.
+        // On these cases, wait for this page and use the last key.
+        //
+        if(0 != (range.result = list_page_join(pparam))){
+            range.is_done = true;
+            return;
+        }
+        if(S3fsCurl::IsListObjectsV2() && !pparam->parser->GetNotifiedContinuationToken().empty() && (pparam->parser->GetLastKey().empty() || pparam->parser->GetLastKey() <= range.end_key)){
+            range.next_token = pparam->parser->GetNotifiedContinuationToken();
+            return;
+        }
+        if(pparam->parser->GetLastKey().empty()){
+            S3FS_PRN_WARN("Could not find next marker, thus break loop.");
+            range.is_done = true;
+            return;
+        }
+        range.next_marker = pparam->parser->GetLastKey();
+    }
+    if(!range.end_key.empty() && range.end_key <= range.next_marker){
+        // the rest is out of range
+        range.is_done = true;
+    }
+}
+
+//
+// List objects in the ranges at the same time.
+//
+// The response of each page has the next marker(or token) before the
+// entries, thus the request of the next page is started as soon as the
+// marker is received, and the pages of each range are received at the same
+// time up to max_inflight. The requests are sent by curl multi engine, so
+// that they are under the limits of the concurrency and the scheduler as
+// same as the other parallel requests. The objects are added into head
+// under plock.
+//
+static int list_bucket_ranges(const char* path, const std::string& query_delimiter, const std::string& query_maxkey, const std::string& query_prefix, list_range_list_t& ranges, S3ObjList& head, pthread_mutex_t* plock, int max_inflight)
+{
+    if(max_inflight < 1){
+        max_inflight = 1;
+    }
+
+    bool is_active = true;
+    while(is_active){
+        // send the next page of all ranges first, and then wait for them.
+        for(list_range_list_t::iterator iter = ranges.begin(); iter != ranges.end(); ++iter){
+            if(!iter->is_done){
+                list_range_send(path, query_delimiter, query_maxkey, query_prefix, *iter, head, plock, max_inflight);
+            }
+        }
+        is_active = false;
+        for(list_range_list_t::iterator iter = ranges.begin(); iter != ranges.end(); ++iter){
+            if(iter->pcurrent){
+                list_range_next(*iter);
+            }
+            if(!iter->is_done){
+                is_active = true;
+            }
+        }
+    }
+
+    // wait for all pages
+    int result = 0;
+    for(list_range_list_t::iterator iter = ranges.begin(); iter != ranges.end(); ++iter){
+        for(list_page_list_t::iterator piter = iter->inflights.begin(); piter != iter->inflights.end(); ++piter){
+            if(0 != list_page_join(*piter) && 0 == iter->result){
+                iter->result = (*piter)->result;
+            }
+            delete *piter;
+        }
+        iter->inflights.clear();
+
+        if(0 != iter->result && 0 == result){
+            result = iter->result;
+        }
+    }
+    return result;
+}
+
+//
+// List objects whose keys are in the range (start_after, end_key].
+// If start_after is empty, lists from the first, and if end_key is empty,
+// lists to the last.
+//
+static int list_bucket_range(const char* path, const std::string& query_delimiter, const std::string& query_maxkey, const std::string& query_prefix, const std::string& start_after, const std::string& end_key, S3ObjList& head, pthread_mutex_t* plock, int max_inflight)
+{
+    S3FS_PRN_INFO3("[path=%s][start_after=%s][end_key=%s]", path, start_after.c_str(), end_key.c_str());
+
+    list_range_list_t ranges(1);
+    ranges[0].next_marker = start_after;
+    ranges[0].end_key     = end_key;
+
+    return list_bucket_ranges(path, query_delimiter, query_maxkey, query_prefix, ranges, head, plock, max_inflight);
+}
+
+//
+// Split the keyspace after last_key under the prefix into ranges by the
+// first character following the prefix, and list them at the same time.
+//
+static int list_bucket_fanout(const char* path, const std::string& query_delimiter, const std::string& query_maxkey, const std::string& query_prefix, const std::string& prefix, const std::string& last_key, S3ObjList& head, pthread_mutex_t* plock)
+{
+    // the boundaries are "<prefix><c>" which are evenly spaced in printable characters
+    std::vector<std::string> bounds;
+    const int                first_char = 0x21;
+    const int                last_char  = 0x7e;
+    for(int cnt = 1; cnt < list_object_fanout; ++cnt){
+        char ch = static_cast<char>(first_char + ((last_char - first_char + 1) * cnt) / list_object_fanout);
+        if('/' == ch){
+            continue;
+        }
+        std::string bound = prefix + ch;
+        if(last_key < bound && (bounds.empty() || bounds.back() < bound)){
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back(std::string(""));     // the last range is not bounded
+
+    list_range_list_t ranges(bounds.size());
+    std::string       start_after = last_key;
+    for(size_t pos = 0; pos < bounds.size(); ++pos){
+        ranges[pos].next_marker = start_after;
+        ranges[pos].end_key     = bounds[pos];
+        start_after             = bounds[pos];
+    }
+    int max_inflight = std::max(1, S3fsCurl::GetMaxParallelCount() / static_cast<int>(bounds.size()));
+
+    return list_bucket_ranges(path, query_delimiter, query_maxkey, query_prefix, ranges, head, plock, max_inflight);
+}
+
+//
+// Get the prefix for listing objects under the path(last word is "/")
+//
+static std::string get_list_bucket_prefix(const char* path)
+{
+    std::string s3_realpath = get_realpath(path);
+    if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
+        // last word must be "/"
+        return s3_realpath.substr(1) + "/";
+    }
+    return s3_realpath.substr(1);
+}
+
+static int list_bucket(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only)
+{
+    std::string query_delimiter;
+    std::string query_prefix;
+    std::string query_maxkey;
+    std::string prefix;
+    int         result;
+
+    S3FS_PRN_INFO1("[path=%s]", path);
+
+    // the listing which was done just before can be used.
+    ListCache* plistcache = ListCache::getListCacheData();
+    if(plistcache->GetList(path, delimiter, head, check_content_only)){
+        return 0;
+    }
+    unsigned long generation = plistcache->GetGeneration();
+
+    if(delimiter && 0 < strlen(delimiter)){
+        query_delimiter += "delimiter=";
+        query_delimiter += delimiter;
+        query_delimiter += "&";
+    }
+
+    prefix        = get_list_bucket_prefix(path);
+    query_prefix += "&prefix=";
+    query_prefix += urlEncode(prefix);
+
+    if (check_content_only){
+        // Just need to know if there are child objects in dir
+        // For dir with children, expect "dir/" and "dir/child"
+        query_maxkey += "max-keys=2";
+
+        ListBucketParser parser(path, head);
+        S3fsCurl         s3fscurl;
+        if(0 != (result = s3fscurl.ListBucketRequest(path, make_list_bucket_query(query_delimiter, query_maxkey, query_prefix, "", "").c_str(), &parser))){
+            S3FS_PRN_ERR("ListBucketRequest returns with error.");
+            return result;
+        }
+        return 0;
+    }
+    query_maxkey += "max-keys=" + str(max_keys_list_object);
+
+    pthread_mutex_t list_lock;
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+    pthread_mutex_init(&list_lock, &attr);
+#else
+    pthread_mutex_init(&list_lock, NULL);
+#endif
+
+    if(1 < list_object_fanout){
+        // The first page tells whether the directory is huge or not.
+        ListBucketParser parser(path, head, &list_lock);
+        S3fsCurl         s3fscurl;
+        if(0 != (result = s3fscurl.ListBucketRequest(path, make_list_bucket_query(query_delimiter, query_maxkey, query_prefix, "", "").c_str(), &parser))){
+            S3FS_PRN_ERR("ListBucketRequest returns with error.");
+        }else if(parser.IsTruncated()){
+            std::string last_key = parser.GetLastKey();
+            if(!parser.GetNextMarker().empty() && last_key < parser.GetNextMarker()){
+                last_key = parser.GetNextMarker();
+            }
+            if(last_key.empty()){
+                S3FS_PRN_WARN("Could not find next marker, thus break loop.");
+            }else{
+                result = list_bucket_fanout(path, query_delimiter, query_maxkey, query_prefix, prefix, last_key, head, &list_lock);
+            }
+        }
+    }else{
+        result = list_bucket_range(path, query_delimiter, query_maxkey, query_prefix, "", "", head, &list_lock, S3fsCurl::GetMaxParallelCount());
+    }
+    pthread_mutex_destroy(&list_lock);
+
+    if(0 == result){
+        plistcache->AddList(path, delimiter, head, generation);
+    }
+
+    S3FS_MALLOCTRIM(0);
+
+    return result;
+}
+
+//
+// List one page of the objects under the path with the delimiter(NULL
+// means no delimiter). The position is in next_token and next_marker, and
+// they are updated for the next page.
+//
+static int list_bucket_page(const char* path, S3ObjList& head, const char* delimiter, std::string& next_token, std::string& next_marker, bool& truncated)
+{
+    std::string query_delimiter;
+    std::string query_prefix = "&prefix=" + urlEncode(get_list_bucket_prefix(path));
+    std::string query_maxkey = "max-keys=" + str(max_keys_list_object);
+    int         result;
+
+    S3FS_PRN_INFO1("[path=%s][token=%s][marker=%s]", path, next_token.c_str(), next_marker.c_str());
+
+    if(delimiter && 0 < strlen(delimiter)){
+        query_delimiter = std::string("delimiter=") + delimiter + "&";
+    }
+
+    ListBucketParser parser(path, head);
+    S3fsCurl         s3fscurl;
+    if(0 != (result = s3fscurl.ListBucketRequest(path, make_list_bucket_query(query_delimiter, query_maxkey, query_prefix, next_token, next_marker).c_str(), &parser))){
+        S3FS_PRN_ERR("ListBucketRequest returns with error.");
+        return result;
+    }
+
+    next_token.clear();
+    if(false == (truncated = parser.IsTruncated())){
+        return 0;
+    }
+    if(S3fsCurl::IsListObjectsV2() && !parser.GetNextContinuationToken().empty()){
+        next_token = parser.GetNextContinuationToken();
+    }else if(!parser.GetNextMarker().empty()){
+        next_marker = parser.GetNextMarker();
+    }else if(!parser.GetLastKey().empty()){
+        next_marker = parser.GetLastKey();
+    }else{
+        S3FS_PRN_WARN("Could not find next marker, thus break loop.");
+        truncated = false;
+    }
+    return 0;
+}
+
+//
+// Get all objects under the path by one listing request without delimiter.
+// If there are more objects than max_keys under the path(the result is
+// truncated), this returns -ERANGE and the caller should use list_bucket.
+//
+static int list_bucket_flat(const char* path, S3ObjList& flat, int max_keys)
+{
+    std::string s3_realpath;
+    std::string query;
+    S3fsCurl    s3fscurl;
+    int         result;
+
+    S3FS_PRN_INFO1("[path=%s][max_keys=%d]", path, max_keys);
+
+    // append parameters to query in alphabetical order
+    if(S3fsCurl::IsListObjectsV2()){
+        query += "list-type=2&";
+    }
+    query += "max-keys=" + str(max_keys);
+    query += "&prefix=";
+    s3_realpath = get_realpath(path);
+    if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
+        // last word must be "/"
+        query += urlEncode(s3_realpath.substr(1) + "/");
+    }else{
+        query += urlEncode(s3_realpath.substr(1));
+    }
+
+    ListBucketParser parser(path, flat);
+    if(0 != (result = s3fscurl.ListBucketRequest(path, query.c_str(), &parser))){
+        S3FS_PRN_ERR("ListBucketRequest returns with error.");
+        return result;
+    }
+    if(parser.IsTruncated()){
+        S3FS_PRN_INFO("there are more than %d objects under %s, so could not use flat listing.", max_keys, path);
+        return -ERANGE;
+    }
+    return 0;
+}
+
+//
+// Add the stats of the objects in the listing(names are relative to strpath)
+// into the stat cache without HEAD request.
+// The objects which need extended meta are left to HEAD request. The
+// directory which is only a part of the object names or is a common prefix
+// (no directory object) is added as directory.
+// The dirobjs has the directory names which have the object, it is updated
+// and should be kept for the following pages of the same listing.
+//
+static int add_stats_from_listing(const std::string& strpath, const S3ObjList& list, bool subdir_only, bool stop_if_full, std::set<std::string>& dirobjs)
+{
+    S3ObjList::const_iterator iter;
+    std::set<std::string>     checkeddirs;
+    headers_t                 emptyheaders;
+    int                       count = 0;
+
+    for(iter = list.begin(); list.end() != iter; ++iter){
+        if(!iter.is_normalized() && '/' == iter.name()[iter.name_length() - 1] && !iter.etag().empty()){
+            dirobjs.insert(std::string(iter.name(), iter.name_length()));
+        }
+    }
+
+    for(iter = list.begin(); list.end() != iter; ++iter){
+        if(iter.is_normalized()){
+            continue;
+        }
+        if(stop_if_full && StatCache::getStatCacheData()->IsCacheFull()){
+            S3FS_PRN_INFO("stat cache is full, so stop adding stats [path=%s]", strpath.c_str());
+            break;
+        }
+        std::string name(iter.name(), iter.name_length());
+
+        // directories which are not object
+        for(std::string::size_type pos = name.find('/'); std::string::npos != pos; pos = name.find('/', pos + 1)){
+            std::string dirname = name.substr(0, pos + 1);
+            if((subdir_only && pos == name.length() - 1) || dirobjs.end() != dirobjs.find(dirname) || checkeddirs.end() != checkeddirs.find(dirname)){
+                continue;
+            }
+            checkeddirs.insert(dirname);
+
+            std::string disppath = strpath + dirname;
+            if(StatCache::getStatCacheData()->HasStat(disppath)){
+                continue;
+            }
+            bool result;
+            if(is_readdir_fake_dir){
+                result = StatCache::getStatCacheData()->AddFakeDirStat(disppath, fake_dir_mode, fake_dir_uid, fake_dir_gid);
+            }else{
+                result = StatCache::getStatCacheData()->AddStat(disppath, emptyheaders, true);
+            }
+            if(!result){
+                S3FS_PRN_ERR("failed adding stat cache [path=%s]", disppath.c_str());
+            }else{
+                ++count;
+            }
+        }
+
+        // objects which do not need extended meta
+        if(iter.is_dir() || (subdir_only && std::string::npos == name.find('/'))){
+            continue;
+        }
+        std::string disppath = strpath + name;
+        std::string etag     = iter.etag();
+        if(is_check_meta(iter.size(), readdir_check_size) || StatCache::getStatCacheData()->HasStat(disppath, etag.c_str())){
+            continue;
+        }
+        headers_t headers;
+        headers["Content-Length"] = str(iter.size());
+        headers["Last-Modified"]  = time_to_gmt(iter.last_modified());
+        headers["ETag"]           = etag;
+        if(!StatCache::getStatCacheData()->AddStat(disppath, headers, /*forcedir*/false, /*no_truncate*/false, true)){
+            S3FS_PRN_ERR("failed adding stat cache [path=%s]", disppath.c_str());
+        }else{
+            ++count;
         }
     }
+    return count;
+}
 
-    // if the dir exists in reheadlist, but is not in stat cache,
-    // it is just a common prefix, need add to stat cache.
-    headers_t emptyheaders;
-    for(iter = reheadlist.begin(); reheadlist.end() != iter; iter = reheadlist.erase(iter)){
-        std::string disppath = path + (*iter);
-        bool isDir = head.IsDir((*iter).c_str());
-        if (isDir) {
-            if (!StatCache::getStatCacheData()->HasStat(disppath)) {
-                if(!StatCache::getStatCacheData()->AddStat(disppath, emptyheaders, isDir)){
-                    S3FS_PRN_ERR("failed adding stat cache [path=%s]", disppath.c_str());
-                }
-            }
-        }
+//
+// Make the list of children(head) from the flat listing, and add the stats
+// of the objects under the sub directories into the stat cache.
+// (the children are checked by readdir_multi_head_optimize)
+//
+static int readdir_flat_list(const char* path, const S3ObjList& flat, S3ObjList& head)
+{
+    std::string strpath = path;
+    if(strcmp(path, "/") != 0){
+        strpath += "/";
     }
 
-    // populate fuse buffer
-    // here is best position, because a case is cache size < files in directory
-    //
-    for(iter = fillerlist.begin(); fillerlist.end() != iter; ++iter){
-        struct stat st;
-        bool in_cache = StatCache::getStatCacheData()->GetStat((*iter), &st);
-        std::string bpath = mybasename((*iter));
-        if(use_wtf8){
-            bpath = s3fs_wtf8_decode(bpath);
+    for(S3ObjList::const_iterator iter = flat.begin(); flat.end() != iter; ++iter){
+        if(iter.is_normalized()){
+            continue;
         }
-        if(in_cache){
-            filler(buf, bpath.c_str(), &st, 0);
+        const char* name = iter.name();
+        const char* pos  = strchr(name, '/');
+        if(NULL == pos || '\0' == pos[1]){
+            head.insert(iter);
         }else{
-            S3FS_PRN_INFO2("Could not find %s file in stat cache.", (*iter).c_str());
-            filler(buf, bpath.c_str(), 0, 0);
+            head.insert(std::string(name, (pos - name) + 1).c_str(), NULL, true);
         }
     }
 
-    return result;
+    std::set<std::string> dirobjs;
+    add_stats_from_listing(strpath, flat, true, false, dirobjs);
+
+    return 0;
 }
 
-static int s3fs_readdir(const char* _path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* fi)
+//
+// Stat cache prewarm
+//
+// The stats of all objects under the directory are added into the stat
+// cache from the listing. At first, the children of the directory are
+// listed with delimiter, and then the objects under each sub directory
+// are listed without delimiter in parallel by the thread pool.
+// This is bounded by max_stat_cache_size.
+//
+struct stat_prewarm_param
 {
-    WTF8_ENCODE(path)
-    S3ObjList head;
-    int result;
-
-    S3FS_PRN_INFO("[path=%s]", path);
+    std::string path;       // sub directory path(ex. "/dir/sub")
+    int         result;
+    int         count;
 
-    if(0 != (result = check_object_access(path, R_OK, NULL))){
-        return result;
-    }
+    stat_prewarm_param() : result(0), count(0) {}
+};
 
-    // get a list of all the objects
-    if((result = list_bucket(path, head, "/")) != 0){
-        S3FS_PRN_ERR("list_bucket returns error(%d).", result);
-        return result;
-    }
+static int stat_prewarm_subtree(const char* path, int& count)
+{
+    std::string           next_token;
+    std::string           next_marker;
+    std::set<std::string> dirobjs;
+    bool                  truncated = true;
+    int                   result;
 
-    // force to add "." and ".." name.
-    filler(buf, ".", 0, 0);
-    filler(buf, "..", 0, 0);
-    if(head.IsEmpty()){
-        return 0;
-    }
+    S3FS_PRN_INFO1("[path=%s]", path);
 
-    // Send multi head request for stats caching.
     std::string strpath = path;
     if(strcmp(path, "/") != 0){
         strpath += "/";
     }
 
-    if (is_readdir_optimize){
-        result = readdir_multi_head_optimize(strpath.c_str(), head, buf, filler);
-    } else {
-        result = readdir_multi_head(strpath.c_str(), head, buf, filler);
-    }
-        
-    if (result != 0) {
-        S3FS_PRN_ERR("readdir_multi_head, optimize(%d) returns error(%d).", is_readdir_optimize, result);
+    count = 0;
+    while(truncated && !StatCache::getStatCacheData()->IsCacheFull()){
+        S3ObjList page;
+        if(0 != (result = list_bucket_page(path, page, NULL, next_token, next_marker, truncated))){
+            return result;
+        }
+        count += add_stats_from_listing(strpath, page, false, true, dirobjs);
     }
+    return 0;
+}
 
-    S3FS_MALLOCTRIM(0);
-
-    return result;
+static void* stat_prewarm_worker(void* arg)
+{
+    stat_prewarm_param* pparam = static_cast<stat_prewarm_param*>(arg);
+    if(!pparam){
+        return reinterpret_cast<void*>(-EIO);
+    }
+    pparam->result = stat_prewarm_subtree(pparam->path.c_str(), pparam->count);
+    return reinterpret_cast<void*>(pparam->result);
 }
 
-static int list_bucket(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only)
+static int stat_prewarm(const char* path)
 {
-    std::string s3_realpath;
-    std::string query_delimiter;
-    std::string query_prefix;
-    std::string query_maxkey;
-    std::string next_continuation_token;
-    std::string next_marker;
-    bool truncated = true;
-    S3fsCurl  s3fscurl;
-    xmlDocPtr doc;
+    S3ObjList   head;
+    int         result;
+    int         count = 0;
 
-    S3FS_PRN_INFO1("[path=%s]", path);
+    S3FS_PRN_INFO("[path=%s]", path);
 
-    if(delimiter && 0 < strlen(delimiter)){
-        query_delimiter += "delimiter=";
-        query_delimiter += delimiter;
-        query_delimiter += "&";
+    if(StatCache::getStatCacheData()->IsCacheFull()){
+        S3FS_PRN_WARN("stat cache is already full, so could not prewarm [path=%s]", path);
+        return -ENOSPC;
     }
 
-    query_prefix += "&prefix=";
-    s3_realpath = get_realpath(path);
-    if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
-        // last word must be "/"
-        query_prefix += urlEncode(s3_realpath.substr(1) + "/");
-    }else{
-        query_prefix += urlEncode(s3_realpath.substr(1));
+    // children
+    if(0 != (result = list_bucket(path, head, "/"))){
+        S3FS_PRN_ERR("list_bucket returns error(%d).", result);
+        return result;
     }
-    if (check_content_only){
-        // Just need to know if there are child objects in dir
-        // For dir with children, expect "dir/" and "dir/child"
-        query_maxkey += "max-keys=2";
-    }else{
-        query_maxkey += "max-keys=" + str(max_keys_list_object);
+    std::string strpath = path;
+    if(strcmp(path, "/") != 0){
+        strpath += "/";
     }
+    std::set<std::string> dirobjs;
+    count += add_stats_from_listing(strpath, head, false, true, dirobjs);
 
-    while(truncated){
-        // append parameters to query in alphabetical order
-        std::string each_query;
-        if(!next_continuation_token.empty()){
-            each_query += "continuation-token=" + urlEncode(next_continuation_token) + "&";
-            next_continuation_token = "";
-        }
-        each_query += query_delimiter;
-        if(S3fsCurl::IsListObjectsV2()){
-            each_query += "list-type=2&";
-        }
-        if(!next_marker.empty()){
-            each_query += "marker=" + urlEncode(next_marker) + "&";
-            next_marker = "";
-        }
-        each_query += query_maxkey;
-        each_query += query_prefix;
-
-        // request
-        int result; 
-        if(0 != (result = s3fscurl.ListBucketRequest(path, each_query.c_str()))){
-            S3FS_PRN_ERR("ListBucketRequest returns with error.");
-            return result;
+    // objects under sub directories
+    s3obj_list_t                     names;
+    std::vector<stat_prewarm_param*> params;
+    Semaphore                        prewarm_sem(0);
+    head.GetNameList(names, true, false);  // get name with "/".
+    for(s3obj_list_t::const_iterator iter = names.begin(); names.end() != iter; ++iter){
+        if('/' != *(*iter).rbegin()){
+            continue;
         }
-        const std::string* body = s3fscurl.GetBodyData();
+        stat_prewarm_param* pparam = new stat_prewarm_param;
+        pparam->path = strpath + (*iter).substr(0, (*iter).length() - 1);
 
-        // xmlDocPtr
-        if(NULL == (doc = xmlReadMemory(body->c_str(), static_cast<int>(body->size()), "", NULL, 0))){
-            S3FS_PRN_ERR("xmlReadMemory returns with error.");
-            return -EIO;
-        }
-        if(0 != append_objects_from_xml(path, doc, head)){
-            S3FS_PRN_ERR("append_objects_from_xml returns with error.");
-            xmlFreeDoc(doc);
-            return -EIO;
-        }
-        if(true == (truncated = is_truncated(doc))){
-            xmlChar* tmpch;
-            if(NULL != (tmpch = get_next_continuation_token(doc))){
-                next_continuation_token = (char*)tmpch;
-                xmlFree(tmpch);
-            }else if(NULL != (tmpch = get_next_marker(doc))){
-                next_marker = (char*)tmpch;
-                xmlFree(tmpch);
-            }
+        thpoolman_param* ppoolparam = new thpoolman_param;
+        ppoolparam->args  = pparam;
+        ppoolparam->psem  = &prewarm_sem;
+        ppoolparam->pfunc = stat_prewarm_worker;
 
-            if(next_continuation_token.empty() && next_marker.empty()){
-                // If did not specify "delimiter", s3 did not return "NextMarker".
-                // On this case, can use last name for next marker.
-                //
-                std::string lastname;
-                if(!head.GetLastName(lastname)){
-                    S3FS_PRN_WARN("Could not find next marker, thus break loop.");
-                    truncated = false;
-                }else{
-                    next_marker = s3_realpath.substr(1);
-                    if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
-                        next_marker += "/";
-                    }
-                    next_marker += lastname;
-                }
-            }
+        if(!ThreadPoolMan::Instruct(ppoolparam)){
+            // run it on this thread
+            S3FS_PRN_WARN("failed to instruct prewarm for %s, so run it here.", pparam->path.c_str());
+            delete ppoolparam;
+            stat_prewarm_worker(pparam);
+            prewarm_sem.post();
         }
-        S3FS_XMLFREEDOC(doc);
-
-        // reset(initialize) curl object
-        s3fscurl.DestroyCurlHandle();
-
-        if(check_content_only){
-            break;
+        params.push_back(pparam);
+    }
+    for(std::vector<stat_prewarm_param*>::iterator iter = params.begin(); params.end() != iter; ++iter){
+        prewarm_sem.wait();
+    }
+    for(std::vector<stat_prewarm_param*>::iterator iter = params.begin(); params.end() != iter; ++iter){
+        if(0 != (*iter)->result){
+            S3FS_PRN_WARN("failed to prewarm stats under %s(%d), but continue.", (*iter)->path.c_str(), (*iter)->result);
         }
+        count += (*iter)->count;
+        delete *iter;
     }
+    S3FS_PRN_INFO("added %d stats under %s.", count, path);
     S3FS_MALLOCTRIM(0);
 
     return 0;
@@ -3207,6 +4526,22 @@ static int s3fs_setxattr(const char* path, const char* name, const char* value,
 {
     S3FS_PRN_INFO("[path=%s][name=%s][value=%p][size=%zu][flags=0x%x]", path, name, value, size, flags);
 
+    if(is_stat_prewarm && name && 0 == strcmp(name, stat_prewarm_xattr)){
+        // this is not the xattr, but the request for prewarming stat cache under the directory.
+        int         result;
+        struct stat stbuf;
+        if(0 != (result = check_object_access(path, R_OK | X_OK, &stbuf))){
+            return result;
+        }
+        if(!S_ISDIR(stbuf.st_mode)){
+            return -ENOTDIR;
+        }
+        return stat_prewarm(path);
+    }
+    if(!is_use_xattr){
+        return -ENOTSUP;
+    }
+
     if((value && 0 == size) || (!value && 0 < size)){
         S3FS_PRN_ERR("Wrong parameter: value(%p), size(%zu)", value, size);
         return 0;
@@ -3639,6 +4974,11 @@ static void* s3fs_init(struct fuse_conn_info* conn)
         }
     }
 
+    // Balance the requests across the addresses of the bucket host
+    if(!CurlEndpointBalancer::Initialize(get_bucket_host())){
+        S3FS_PRN_ERR("could not initialize balancing the requests, then the requests are sent by the default.");
+    }
+
     // Investigate system capabilities
     #ifndef __APPLE__
     if((unsigned int)conn->capable & FUSE_CAP_ATOMIC_O_TRUNC){
@@ -3654,6 +4994,42 @@ static void* s3fs_init(struct fuse_conn_info* conn)
         S3FS_PRN_CRIT("Could not create thread pool(%d)", direct_read_max_prefetch_thread_count);
         s3fs_exit_fuseloop(EXIT_FAILURE);
     }
+    // [NOTE]
+    // If direct_read is enabled, the thread pool is shared with refreshing
+    // stat cache and prewarming stat cache.
+    if(!direct_read && (StatCache::getStatCacheData()->IsStaleRevalidate() || is_stat_prewarm) && !ThreadPoolMan::Initialize(S3fsCurl::GetMaxParallelCount())){
+        S3FS_PRN_CRIT("Could not create thread pool(%d)", S3fsCurl::GetMaxParallelCount());
+        s3fs_exit_fuseloop(EXIT_FAILURE);
+    }
+
+    // the workers for server side copy of parts
+    if(!nomultipart && !nocopyapi && !CopyPartScheduler::Initialize()){
+        S3FS_PRN_CRIT("Could not create copy part scheduler(%d)", CopyPartScheduler::GetWorkerCount());
+        s3fs_exit_fuseloop(EXIT_FAILURE);
+    }
+
+    // the limits of in-flight requests
+    //
+    // [NOTE]
+    // The prefetch can not exceed the threads of the thread pool, then it
+    // starts from the part of them so that the limit can increase.
+    //
+    if(CurlConcurrency::IsEnabled()){
+        CurlConcurrency::SetLimit(CURL_REQ_META, S3fsCurl::GetMaxMultiRequest(), S3fsCurl::GetMaxMultiRequest() * CurlConcurrency::MAX_RATIO);
+        CurlConcurrency::SetLimit(CURL_REQ_READ, S3fsCurl::GetMaxParallelCount(), S3fsCurl::GetMaxParallelCount() * CurlConcurrency::MAX_RATIO);
+        CurlConcurrency::SetLimit(CURL_REQ_WRITE, S3fsCurl::GetMaxParallelCount(), S3fsCurl::GetMaxParallelCount() * CurlConcurrency::MAX_RATIO);
+        CurlConcurrency::SetLimit(CURL_REQ_PREFETCH, direct_read_max_prefetch_thread_count / CurlConcurrency::MAX_RATIO, direct_read_max_prefetch_thread_count);
+    }
+
+    // the I/O threads for parallel requests
+    if(0 < CurlMultiEngine::GetThreadCount() && !CurlMultiEngine::Initialize()){
+        S3FS_PRN_WARN("Could not create curl multi engine(%d), then send parallel requests by a thread per request.", CurlMultiEngine::GetThreadCount());
+    }
+
+    // Open the connections in background before the first requests, and keep them warm
+    if(!S3fsCurl::StartWarmUp(warmup_connections)){
+        S3FS_PRN_WARN("Could not start warming up the connections, but continue...");
+    }
 
     // Signal object
     if(!S3fsSignals::Initialize()){
@@ -3672,7 +5048,10 @@ static void s3fs_destroy(void*)
         S3FS_PRN_WARN("Failed to clean up signal object.");
     }
 
+    S3fsCurl::StopWarmUp();
     ThreadPoolMan::Destroy();
+    CopyPartScheduler::Destroy();
+    CurlMultiEngine::Destroy();
 
     // cache(remove at last)
     if(is_remove_cache && (!CacheFileStat::DeleteCacheFileStatDirectory() || !FdManager::DeleteCacheDirectory())){
@@ -4092,6 +5471,15 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             S3fsCurl::SetRetries(static_cast<int>(retries));
             return 0;
         }
+        if(is_prefix(arg, "retry_budget=")){
+            off_t budget = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(0 > budget){
+                S3FS_PRN_EXIT("argument should be over 0: retry_budget");
+                return -1;
+            }
+            CurlRetryScheduler::SetBudget(static_cast<long>(budget));
+            return 0;
+        }
         if(is_prefix(arg, "tmpdir=")){
             FdManager::SetTmpDir(strchr(arg, '=') + sizeof(char));
             return 0;
@@ -4113,10 +5501,100 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             S3fsCurl::SetMaxMultiRequest(maxreq);
             return 0;
         }
+        if(is_prefix(arg, "multireq_io_threads=")){
+            int count = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 > count){
+                S3FS_PRN_EXIT("argument should be over 0: multireq_io_threads");
+                return -1;
+            }
+            CurlMultiEngine::SetThreadCount(count);
+            return 0;
+        }
         if(0 == strcmp(arg, "nonempty")){
             nonempty = true;
             return 1; // need to continue for fuse.
         }
+        if(is_prefix(arg, "warmup_connections=")){
+            int count = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 > count){
+                S3FS_PRN_EXIT("argument should be over 0: warmup_connections");
+                return -1;
+            }
+            warmup_connections = count;
+            return 0;
+        }
+        if(is_prefix(arg, "connection_max_age=")){
+            long sec = static_cast<long>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 > sec){
+                S3FS_PRN_EXIT("argument should be over 0: connection_max_age");
+                return -1;
+            }
+            S3fsCurl::SetConnectionMaxAge(sec);
+            return 0;
+        }
+        if(is_prefix(arg, "warmup_interval=")){
+            time_t sec = static_cast<time_t>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 > sec){
+                S3FS_PRN_EXIT("argument should be over 0: warmup_interval");
+                return -1;
+            }
+            S3fsCurl::SetWarmUpInterval(sec);
+            return 0;
+        }
+        if(0 == strcmp(arg, "http2")){
+            S3fsCurl::SetHttp2(true);
+            return 0;
+        }
+        if(0 == strcmp(arg, "endpoint_balance")){
+            CurlEndpointBalancer::SetEnabled(true);
+            return 0;
+        }
+        if(is_prefix(arg, "endpoint_targets=")){
+            CurlEndpointBalancer::SetTargets(strchr(arg, '=') + sizeof(char));
+            return 0;
+        }
+        if(0 == strcmp(arg, "hedge_requests")){
+            CurlHedge::SetEnabled(true);
+            return 0;
+        }
+        if(is_prefix(arg, "hedge_percentile=")){
+            int value = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(!CurlHedge::SetPercentile(value)){
+                S3FS_PRN_EXIT("argument should be between 1 and 99: hedge_percentile");
+                return -1;
+            }
+            return 0;
+        }
+        if(is_prefix(arg, "hedge_budget=")){
+            int value = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(!CurlHedge::SetBudget(value)){
+                S3FS_PRN_EXIT("argument should be between 0 and 100: hedge_budget");
+                return -1;
+            }
+            return 0;
+        }
+        if(is_prefix(arg, "http2_max_streams=")){
+            long count = static_cast<long>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 >= count){
+                S3FS_PRN_EXIT("argument should be over 1: http2_max_streams");
+                return -1;
+            }
+            S3fsCurl::SetHttp2MaxStreams(count);
+            return 0;
+        }
+        if(is_prefix(arg, "max_inflight_requests=")){
+            int slots = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 > slots){
+                S3FS_PRN_EXIT("argument should be over 0: max_inflight_requests");
+                return -1;
+            }
+            CurlRequestScheduler::SetMaxSlots(slots);
+            return 0;
+        }
+        if(0 == strcmp(arg, "adaptive_concurrency")){
+            CurlConcurrency::SetEnabled(true);
+            return 0;
+        }
         if(0 == strcmp(arg, "nomultipart")){
             nomultipart = true;
             return 0;
@@ -4332,6 +5810,15 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             max_keys_list_object = max_keys;
             return 0;
         }
+        if(is_prefix(arg, "list_object_fanout=")){
+            int fanout = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(fanout < 1 || 64 < fanout){
+                S3FS_PRN_EXIT("argument should be from 1 to 64: list_object_fanout");
+                return -1;
+            }
+            list_object_fanout = fanout;
+            return 0;
+        }
         if(is_prefix(arg, "max_stat_cache_size=")){
             unsigned long cache_size = static_cast<unsigned long>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), 10));
             StatCache::getStatCacheData()->SetCacheSize(cache_size);
@@ -4355,6 +5842,24 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             StatCache::getStatCacheData()->SetExpireTime(expr_time, true);
             return 0;
         }
+        if(is_prefix(arg, "stat_cache_stale_window=")){
+            off_t stale = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(0 > stale){
+                S3FS_PRN_EXIT("argument should be over 0: stat_cache_stale_window");
+                return -1;
+            }
+            StatCache::getStatCacheData()->SetStaleTime(static_cast<time_t>(stale));
+            return 0;
+        }
+        if(is_prefix(arg, "list_cache_expire=")){
+            off_t expire = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(0 > expire){
+                S3FS_PRN_EXIT("argument should be over 0: list_cache_expire");
+                return -1;
+            }
+            ListCache::getListCacheData()->SetExpireTime(static_cast<time_t>(expire));
+            return 0;
+        }
         if(0 == strcmp(arg, "enable_noobj_cache")){
             StatCache::getStatCacheData()->EnableCacheNoObject();
             return 0;
@@ -4376,6 +5881,15 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             S3fsCurl::SetMaxParallelCount(maxpara);
             return 0;
         }
+        if(is_prefix(arg, "parallel_copy_count=")){
+            int maxpara = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 >= maxpara){
+                S3FS_PRN_EXIT("argument should be over 1: parallel_copy_count");
+                return -1;
+            }
+            CopyPartScheduler::SetWorkerCount(maxpara);
+            return 0;
+        }
         if(is_prefix(arg, "fd_page_size=")){
             S3FS_PRN_ERR("option fd_page_size is no longer supported, so skip this option.");
             return 0;
@@ -4572,10 +6086,48 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             is_readdir_optimize = true;
             return 0;
         }
+        if(0 == strcmp(arg, "readdir_stream")){
+            is_readdir_stream = true;
+            return 0;
+        }
+        if(is_prefix(arg, "readdir_flat_list_max_keys=")){
+            int max_keys = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(max_keys < 0 || 1000 < max_keys){
+                S3FS_PRN_EXIT("argument should be from 0 to 1000: readdir_flat_list_max_keys");
+                return -1;
+            }
+            readdir_flat_list_max_keys = max_keys;
+            return 0;
+        }
         if(is_prefix(arg, "readdir_check_size=")){
             readdir_check_size = static_cast<off_t>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
             return 0;
         }
+        if(0 == strcmp(arg, "stat_cache_prewarm")){
+            is_stat_prewarm = true;
+            return 0;
+        }
+        if(0 == strcmp(arg, "parallel_probe")){
+            is_parallel_probe = true;
+            return 0;
+        }
+        if(0 == strcmp(arg, "readdir_fake_dir")){
+            is_readdir_fake_dir = true;
+            return 0;
+        }
+        if(is_prefix(arg, "fake_dir_mode=")){
+            off_t mode = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 8);
+            fake_dir_mode = static_cast<mode_t>(mode) & (S_IRWXU | S_IRWXG | S_IRWXO);
+            return 0;
+        }
+        if(is_prefix(arg, "fake_dir_uid=")){
+            fake_dir_uid = get_uid(strchr(arg, '=') + sizeof(char));
+            return 0;
+        }
+        if(is_prefix(arg, "fake_dir_gid=")){
+            fake_dir_gid = get_gid(strchr(arg, '=') + sizeof(char));
+            return 0;
+        }
         if(0 == strcmp(arg, "symlink_in_meta")){
             is_new_symlink_format = true;
             return 0;
@@ -5101,6 +6653,28 @@ int main(int argc, char* argv[])
         S3FS_PRN_INFO("Readdir optimize, flag(%d, %lld)", is_refresh_fakemeta, static_cast<long long int>(readdir_check_size));
     }
 
+    // check readdir_fake_dir
+    if(is_readdir_fake_dir){
+        if(static_cast<uid_t>(-1) == fake_dir_uid){
+            fake_dir_uid = is_s3fs_uid ? s3fs_uid : geteuid();
+        }
+        if(static_cast<gid_t>(-1) == fake_dir_gid){
+            fake_dir_gid = is_s3fs_gid ? s3fs_gid : getegid();
+        }
+        is_refresh_fakemeta = true;
+        S3FS_PRN_INFO("Readdir fake directory, mode(%04o), uid(%u), gid(%u)", static_cast<unsigned int>(fake_dir_mode), static_cast<unsigned int>(fake_dir_uid), static_cast<unsigned int>(fake_dir_gid));
+    }
+
+    // check stat_cache_prewarm
+    if(is_stat_prewarm && !is_readdir_optimize){
+        S3FS_PRN_EXIT("stat_cache_prewarm option could be specified only with readdir_optimize option.");
+        S3fsCurl::DestroyS3fsCurl();
+        s3fs_destroy_global_ssl();
+        destroy_parser_xml_lock();
+        delete ps3fscred;
+        exit(EXIT_FAILURE);
+    }
+
     s3fs_oper.getattr     = s3fs_getattr;
     s3fs_oper.readlink    = s3fs_readlink;
     s3fs_oper.mknod       = s3fs_mknod;
@@ -5129,6 +6703,7 @@ int main(int argc, char* argv[])
     s3fs_oper.release     = s3fs_release;
     s3fs_oper.opendir     = s3fs_opendir;
     s3fs_oper.readdir     = s3fs_readdir;
+    s3fs_oper.releasedir  = s3fs_releasedir;
     s3fs_oper.init        = s3fs_init;
     s3fs_oper.destroy     = s3fs_destroy;
     s3fs_oper.access      = s3fs_access;
@@ -5139,6 +6714,9 @@ int main(int argc, char* argv[])
         s3fs_oper.getxattr    = s3fs_getxattr;
         s3fs_oper.listxattr   = s3fs_listxattr;
         s3fs_oper.removexattr = s3fs_removexattr;
+    }else if(is_stat_prewarm){
+        // only for the request of prewarming stat cache
+        s3fs_oper.setxattr    = s3fs_setxattr;
     }
 
     s3fs_oper.flag_utime_omit_ok = true;
@@ -68,6 +68,15 @@ static const char help_string[] =
     "   retries (default=\"5\")\n"
     "      - number of times to retry a failed OSS transaction\n"
     "\n"
+    "   retry_budget (default=\"100\")\n"
+    "      - retry budget for each endpoint. A retry takes one from the\n"
+    "        budget and a request succeeded without retrying gives back\n"
+    "        1/10, and failed requests are not retried while less than\n"
+    "        half of the budget is left. This prevents the retries from\n"
+    "        adding the load to the throttling server. The wait time\n"
+    "        before retrying is jittered, and Retry-After from the server\n"
+    "        is honoured. 0 means unlimited.\n"
+    "\n"
     "   tmpdir (default=\"/tmp\")\n"
     "      - local folder for temporary files.\n"
     "\n"
@@ -143,6 +152,13 @@ static const char help_string[] =
     "      - specify the maximum number of keys returned by OSS list object\n"
     "        API. The default is 1000. you can set this value to 1000 or more.\n"
     "\n"
+    "   list_object_fanout (default=\"1\")\n"
+    "      - specify the number of key ranges which are listed in parallel\n"
+    "        when a directory has more objects than one page of list object\n"
+    "        API. The rest after the first page is split by the first\n"
+    "        character of the name, and each range is listed at the same\n"
+    "        time. The value is from 1 to 64, and 1 disables this.\n"
+    "\n"
     "   max_stat_cache_size (default=\"100,000\" entries (about 40MB))\n"
     "      - maximum number of entries in the stat cache, and this maximum is\n"
     "        also treated as the number of symbolic link cache.\n"
@@ -160,6 +176,22 @@ static const char help_string[] =
     "      of the stat cache. This option is exclusive with stat_cache_expire,\n"
     "      and is left for compatibility with older versions.\n"
     "\n"
+    "   stat_cache_stale_window (default is 0)\n"
+    "      - specify the time (seconds) for which an expired entry in the\n"
+    "        stat cache can still be returned. When such an entry is used,\n"
+    "        ossfs refreshes it by the HEAD request in background, and only\n"
+    "        one request per path is sent at a time. After this window,\n"
+    "        the entry is checked synchronously as usual.\n"
+    "        0 value means disable.\n"
+    "\n"
+    "   list_cache_expire (default is 0)\n"
+    "      - specify expire time (seconds) for the results of listing\n"
+    "        objects. readdir, the check before removing a directory and\n"
+    "        renaming a directory which are done one after another use the\n"
+    "        same result. The result is updated when ossfs removes or\n"
+    "        changes an object, but the changes by other clients are not\n"
+    "        seen until it expires. 0 value means disable.\n"
+    "\n"
     "   enable_noobj_cache (default is disable)\n"
     "      - enable cache entries for the object which does not exist.\n"
     "      ossfs always has to check whether file (or sub directory) exists \n"
@@ -187,6 +219,91 @@ static const char help_string[] =
     "   multireq_max (default=\"20\")\n"
     "      - maximum number of parallel request for listing objects.\n"
     "\n"
+    "   multireq_io_threads (default=\"2\")\n"
+    "      - number of threads which send the parallel requests(listing,\n"
+    "      multipart upload and parallel download) by curl multi interface.\n"
+    "      The requests in parallel are limited by multireq_max or\n"
+    "      parallel_count, and they do not need a thread per request.\n"
+    "      0 value means that a thread is created for each request.\n"
+    "\n"
+    "   warmup_connections (default=\"0\")\n"
+    "      - number of the connections which are opened in background\n"
+    "      at mount time, so that the first requests do not wait for the\n"
+    "      TCP and TLS handshakes. It is limited by the number of the\n"
+    "      curl handles in the pool. The same number of connections are\n"
+    "      opened by the I/O threads of multireq_io_threads, but the\n"
+    "      connections for the hedged requests are not opened.\n"
+    "\n"
+    "   warmup_interval (default=\"0\")\n"
+    "      - the connections of warmup_connections are warmed up again\n"
+    "      every this seconds, so that they are not closed as idle\n"
+    "      before the next requests. The idle connections are kept for\n"
+    "      twice this seconds(at least 118 seconds) with this option.\n"
+    "      0 value means that they are opened only at mount time.\n"
+    "\n"
+    "   connection_max_age (default=\"0\")\n"
+    "      - the connections older than this seconds are not reused and\n"
+    "      are closed, then new connections are opened. 0 value means\n"
+    "      no limit. It needs libcurl 7.80.0 or later.\n"
+    "\n"
+    "   http2 (default is disable)\n"
+    "      - use HTTP/2 if the endpoint supports it. The parallel requests\n"
+    "      sent by multireq_io_threads are multiplexed on a few\n"
+    "      connections. If the endpoint does not support HTTP/2, HTTP/1.1\n"
+    "      is used. The numbers of the requests and the connections are\n"
+    "      logged at info level when a new connection is opened.\n"
+    "\n"
+    "   http2_max_streams (default=\"100\")\n"
+    "      - maximum number of the requests multiplexed on a connection\n"
+    "      when http2 is specified.\n"
+    "\n"
+    "   endpoint_balance (default is disable)\n"
+    "      - spread the requests across the addresses(A or AAAA records)\n"
+    "      of the bucket host. The address is picked by the latency and\n"
+    "      the requests in flight, and the address which failed 3 times\n"
+    "      in a row is not used for a while. The addresses are resolved\n"
+    "      again every 60 seconds. It needs libcurl 7.49.0 or later.\n"
+    "\n"
+    "   endpoint_targets (default=\"\")\n"
+    "      - comma separated list of the addresses(or hosts) which serve\n"
+    "      the bucket host, they are used instead of the A records by\n"
+    "      endpoint_balance. This option enables endpoint_balance. The\n"
+    "      requests are sent with the bucket host name, then the\n"
+    "      addresses must accept it(and its certificate for https).\n"
+    "\n"
+    "   hedge_requests (default is disable)\n"
+    "      - send the same request again if the HEAD request or the GET\n"
+    "      request of 1MB or less in direct read does not respond within\n"
+    "      the latency of hedge_percentile of the recent requests, and\n"
+    "      use the response which arrives first.\n"
+    "\n"
+    "   hedge_percentile (default=\"95\")\n"
+    "      - percentile of the latencies of the recent requests, which is\n"
+    "      the time to wait before sending the hedged request.\n"
+    "\n"
+    "   hedge_budget (default=\"5\")\n"
+    "      - maximum percent of the hedged requests to the requests which\n"
+    "      can be hedged.\n"
+    "\n"
+    "   max_inflight_requests (default=\"0\")\n"
+    "      - number of the requests which are sent at the same time, and\n"
+    "      the requests are sent in order of the priority when it is\n"
+    "      reached. The metadata requests have the highest priority, and\n"
+    "      the reads, the prefetches and the uploads(and copies) follow.\n"
+    "      1/4 of the slots are reserved for the metadata requests and\n"
+    "      1/8 for the reads, and the other slots are shared by weighted\n"
+    "      fair queuing. 0 value means that the requests are not\n"
+    "      scheduled.\n"
+    "\n"
+    "   adaptive_concurrency (default is disable)\n"
+    "      - adjust the number of parallel requests by the responses.\n"
+    "      The limits by multireq_max and parallel_count are the initial\n"
+    "      values, they are halved when the requests are throttled or\n"
+    "      timed out, and increased slowly up to twice the initial values\n"
+    "      while the requests succeed without the latency growing. The\n"
+    "      prefetch starts from half of direct_read_prefetch_thread and\n"
+    "      is increased up to it.\n"
+    "\n"
     "   parallel_count (default=\"5\")\n"
     "      - number of parallel request for uploading big objects.\n"
     "      ossfs uploads large object (over 20MB) by multipart post request, \n"
@@ -195,6 +312,14 @@ static const char help_string[] =
     "      at once. It is necessary to set this value depending on a CPU \n"
     "      and a network band.\n"
     "\n"
+    "   parallel_copy_count (default=\"10\")\n"
+    "      - number of parallel request for copying parts of big objects\n"
+    "      in OSS(renames and changing the attributes).\n"
+    "      The copies are done in OSS, so this is independent of\n"
+    "      parallel_count. The parts of the objects which are renamed at\n"
+    "      the same time share these requests. The part size is adjusted\n"
+    "      from multipart_copy_size depending on the object size.\n"
+    "\n"
     "   multipart_size (default=\"10\")\n"
     "      - part size, in MB, for each multipart request.\n"
     "      The minimum value is 5 MB and the maximum value is 5 GB.\n"
@@ -382,6 +507,14 @@ static const char help_string[] =
     "        scheme, this option can be used to disable support for alternative\n"
     "        naming schemes. This reduces access time and can save costs.\n"
     "\n"
+    "   parallel_probe (check the object type at the same time)\n"
+    "        If the object is not in the stat cache, ossfs checks \"dir\",\n"
+    "        \"dir/\", \"dir_$folder$\" and the listing for the directory which\n"
+    "        has no object one by one. With this option, \"dir/\" and\n"
+    "        \"dir_$folder$\" are checked at the same time after \"dir\" is not\n"
+    "        found, so that the attribute of the directory is got in fewer\n"
+    "        round trips. The file is still checked by one request.\n"
+    "\n"
     "   use_wtf8 - support arbitrary file system encoding.\n"
     "        OSS requires all object names to be valid UTF-8. But some\n"
     "        clients, notably Windows NFS clients, use their own encoding.\n"
@@ -438,6 +571,41 @@ static const char help_string[] =
     "        If a file size is greater than this threshold, only use the basic information from ListObjects result.\n"
     "        This option works when readdir_optimize option is eanbled.\n"
     "\n"
+    "   readdir_flat_list_max_keys (default=\"0\")\n"
+    "        maximum number of objects under the directory to list them by one ListObjects request\n"
+    "        without delimiter in readdir. If all objects under the directory are listed, readdir builds\n"
+    "        the stats of them from the listing without HeadObject request, except for the objects which\n"
+    "        need extended information(see readdir_check_size). The value must be 1000 or less.\n"
+    "        This option works when readdir_optimize option is enabled.\n"
+    "\n"
+    "   readdir_stream (default is disable)\n"
+    "        readdir lists the directory page by page(see list_object_max_keys) and fills the entries\n"
+    "        of each page after getting their stats, instead of listing all objects before filling.\n"
+    "        The entries are shown as soon as the first page is listed, and only one page is kept in\n"
+    "        memory for each opened directory. readdir_flat_list_max_keys and list_object_fanout\n"
+    "        options are not used with this option.\n"
+    "\n"
+    "   stat_cache_prewarm (default is disable)\n"
+    "        enable the request for prewarming stat cache under the directory, by setting the extended\n"
+    "        attribute \"user.ossfs.prewarm\" to the directory(ex. setfattr -n user.ossfs.prewarm -v 1 dir).\n"
+    "        All objects under the directory are listed in parallel, and their stats are added into stat\n"
+    "        cache until it is full(see max_stat_cache_size). The request returns after finishing it.\n"
+    "        This option can be specified only with readdir_optimize option.\n"
+    "\n"
+    "   readdir_fake_dir (default is disable)\n"
+    "        readdir does not issue HeadObject request for sub directories. Their stats are built from\n"
+    "        the common prefixes in ListObjects result with fake_dir_mode, fake_dir_uid and fake_dir_gid,\n"
+    "        and refreshed by HeadObject request when the directory is opened or its mode/owner is changed.\n"
+    "\n"
+    "   fake_dir_mode (default=\"0750\")\n"
+    "        mode of the directory stats built by readdir_fake_dir option.\n"
+    "\n"
+    "   fake_dir_uid (default is uid option or the effective uid)\n"
+    "        owner uid of the directory stats built by readdir_fake_dir option.\n"
+    "\n"
+    "   fake_dir_gid (default is gid option or the effective gid)\n"
+    "        owner gid of the directory stats built by readdir_fake_dir option.\n"
+    "\n"
     "   symlink_in_meta (default is disable)\n"
     "        Enable to save the symbolic link target in object user metadata.\n"
     "        This option is used in conjunction with the readdir_optimize option.\n"
@@ -82,84 +82,22 @@ static bool GetXmlNsUrl(xmlDocPtr doc, std::string& nsurl)
     return result;
 }
 
-static xmlChar* get_base_exp(xmlDocPtr doc, const char* exp)
-{
-    xmlXPathObjectPtr  marker_xp;
-    std::string xmlnsurl;
-    std::string exp_string;
-
-    if(!doc){
-        return NULL;
-    }
-    xmlXPathContextPtr ctx = xmlXPathNewContext(doc);
-
-    if(!noxmlns && GetXmlNsUrl(doc, xmlnsurl)){
-        xmlXPathRegisterNs(ctx, (xmlChar*)"s3", (xmlChar*)xmlnsurl.c_str());
-        exp_string = "/s3:ListBucketResult/s3:";
-    } else {
-        exp_string = "/ListBucketResult/";
-    }
-
-    exp_string += exp;
-
-    if(NULL == (marker_xp = xmlXPathEvalExpression((xmlChar *)exp_string.c_str(), ctx))){
-        xmlXPathFreeContext(ctx);
-        return NULL;
-    }
-    if(xmlXPathNodeSetIsEmpty(marker_xp->nodesetval)){
-        S3FS_PRN_INFO("marker_xp->nodesetval is empty.");
-        xmlXPathFreeObject(marker_xp);
-        xmlXPathFreeContext(ctx);
-        return NULL;
-    }
-    xmlNodeSetPtr nodes  = marker_xp->nodesetval;
-    xmlChar*      result = xmlNodeListGetString(doc, nodes->nodeTab[0]->xmlChildrenNode, 1);
-
-    xmlXPathFreeObject(marker_xp);
-    xmlXPathFreeContext(ctx);
-
-    return result;
-}
-
-static xmlChar* get_prefix(xmlDocPtr doc)
-{
-    return get_base_exp(doc, "Prefix");
-}
-
-xmlChar* get_next_continuation_token(xmlDocPtr doc)
-{
-    return get_base_exp(doc, "NextContinuationToken");
-}
-
-xmlChar* get_next_marker(xmlDocPtr doc)
-{
-    return get_base_exp(doc, "NextMarker");
-}
-
 // return: the pointer to object name on allocated memory.
 //         the pointer to "c_strErrorObjectName".(not allocated)
 //         NULL(a case of something error occurred)
-static char* get_object_name(xmlDocPtr doc, xmlNodePtr node, const char* path)
+static char* get_object_name(const char* fullpath, const char* path)
 {
-    // Get full path
-    xmlChar* fullpath = xmlNodeListGetString(doc, node, 1);
-    if(!fullpath){
-        S3FS_PRN_ERR("could not get object full path name..");
-        return NULL;
-    }
     // basepath(path) is as same as fullpath.
-    if(0 == strcmp((char*)fullpath, path)){
-        xmlFree(fullpath);
+    if(0 == strcmp(fullpath, path)){
         return (char*)c_strErrorObjectName;
     }
 
     // Make dir path and filename
-    std::string   strdirpath = mydirname(std::string((char*)fullpath));
-    std::string   strmybpath = mybasename(std::string((char*)fullpath));
+    std::string   strdirpath = mydirname(std::string(fullpath));
+    std::string   strmybpath = mybasename(std::string(fullpath));
     const char* dirpath = strdirpath.c_str();
     const char* mybname = strmybpath.c_str();
     const char* basepath= (path && '/' == path[0]) ? &path[1] : path;
-    xmlFree(fullpath);
 
     if('\0' == mybname[0]){
         return NULL;
@@ -322,194 +260,295 @@ bool get_incomp_mpu_list(xmlDocPtr doc, incomp_mpu_list_t& list)
     return true;
 }
 
-bool is_truncated(xmlDocPtr doc)
+//-------------------------------------------------------------------
+// Class ListBucketParser
+//-------------------------------------------------------------------
+ListBucketParser::ListBucketParser(const char* path, S3ObjList& head, pthread_mutex_t* plock, const char* end_key) :
+    ctxt(NULL), basepath(path ? path : ""), phead(&head), plock(plock), end_key(end_key ? end_key : ""),
+    pnext_sem(NULL), is_next_notified(false), notified_truncated(false)
 {
-    bool result = false;
+    Reset();
+}
+
+ListBucketParser::~ListBucketParser()
+{
+    if(ctxt){
+        xmlFreeParserCtxt(ctxt);
+        ctxt = NULL;
+    }
+}
 
-    xmlChar* strTruncate = get_base_exp(doc, "IsTruncated");
-    if(!strTruncate){
+bool ListBucketParser::Reset()
+{
+    if(ctxt){
+        xmlFreeParserCtxt(ctxt);
+        ctxt = NULL;
+    }
+    depth         = 0;
+    is_listresult = false;
+    is_failed     = false;
+    is_finished   = false;
+    in_entry      = ENTRY_NONE;
+    ptext         = NULL;
+    text.clear();
+    prefix.clear();
+    has_prefix    = false;
+    key.clear();
+    etag.clear();
+    size.clear();
+    lastmodified.clear();
+    truncated     = false;
+    next_marker.clear();
+    next_token.clear();
+    pendings.clear();
+    last_key.clear();
+
+    xmlSAXHandler sax;
+    memset(&sax, 0, sizeof(xmlSAXHandler));
+    sax.initialized    = XML_SAX2_MAGIC;
+    sax.startElementNs = ListBucketParser::StartElement;
+    sax.endElementNs   = ListBucketParser::EndElement;
+    sax.characters     = ListBucketParser::Characters;
+    sax.serror         = ListBucketParser::StructuredError;
+
+    if(NULL == (ctxt = xmlCreatePushParserCtxt(&sax, this, NULL, 0, NULL))){
+        S3FS_PRN_ERR("Could not create xml push parser context.");
+        is_failed = true;
         return false;
     }
-    if(0 == strcasecmp((const char*)strTruncate, "true")){
-        result = true;
+    return true;
+}
+
+bool ListBucketParser::Parse(const char* data, size_t len)
+{
+    if(!ctxt || is_failed){
+        return false;
     }
-    xmlFree(strTruncate);
-    return result;
+    if(0 != xmlParseChunk(ctxt, data, static_cast<int>(len), 0)){
+        is_failed = true;
+        return false;
+    }
+    return !is_failed;
 }
 
-int append_objects_from_xml_ex(const char* path, xmlDocPtr doc, xmlXPathContextPtr ctx, const char* ex_contents, const char* ex_key, const char* ex_etag, const char* ex_size, const char* ex_last_modified, int isCPrefix, S3ObjList& head)
+bool ListBucketParser::Finish()
 {
-    xmlXPathObjectPtr contents_xp;
-    xmlNodeSetPtr content_nodes;
+    if(!ctxt || is_failed){
+        return false;
+    }
+    if(0 != xmlParseChunk(ctxt, NULL, 0, 1)){
+        is_failed = true;
+        return false;
+    }
+    is_finished = true;
 
-    if(NULL == (contents_xp = xmlXPathEvalExpression((xmlChar*)ex_contents, ctx))){
-        S3FS_PRN_ERR("xmlXPathEvalExpression returns null.");
-        return -1;
+    // There was no <Prefix>, then use path instead of it.
+    if(!FlushPendings()){
+        is_failed = true;
     }
-    if(xmlXPathNodeSetIsEmpty(contents_xp->nodesetval)){
-        S3FS_PRN_DBG("contents_xp->nodesetval is empty.");
-        S3FS_XMLXPATHFREEOBJECT(contents_xp);
-        return 0;
+    if(!is_failed && is_listresult){
+        NotifyNextLocked();
     }
-    content_nodes = contents_xp->nodesetval;
+    return (!is_failed && is_listresult);
+}
 
-    bool is_dir;
-    std::string stretag;
-    std::string strsize;
-    std::string strlastmodified;
+//
+// Post the semaphore for the next page only once. If the response is
+// failed, the caller must call NotifyNext() after the request.
+//
+void ListBucketParser::NotifyNextLocked()
+{
+    if(is_next_notified){
+        return;
+    }
+    is_next_notified   = true;
+    notified_truncated = truncated;
+    notified_marker    = next_marker;
+    notified_token     = next_token;
+    if(pnext_sem){
+        pnext_sem->post();
+    }
+}
 
-    int i;
-    for(i = 0; i < content_nodes->nodeNr; i++){
-        ctx->node = content_nodes->nodeTab[i];
+void ListBucketParser::NotifyNext()
+{
+    if(is_next_notified){
+        return;
+    }
+    // not found the next marker, thus the caller does not request the next page.
+    is_next_notified   = true;
+    notified_truncated = false;
+    if(pnext_sem){
+        pnext_sem->post();
+    }
+}
 
-        // object name
-        xmlXPathObjectPtr key;
-        if(NULL == (key = xmlXPathEvalExpression((xmlChar*)ex_key, ctx))){
-            S3FS_PRN_WARN("key is null. but continue.");
-            continue;
-        }
-        if(xmlXPathNodeSetIsEmpty(key->nodesetval)){
-            S3FS_PRN_WARN("node is empty. but continue.");
-            xmlXPathFreeObject(key);
-            continue;
+bool ListBucketParser::InsertEntry(const std::string& fullpath, const char* petag, const char* psize, const char* plastmodified, bool is_cprefix)
+{
+    if(!end_key.empty() && end_key < fullpath){
+        // out of range
+        return true;
+    }
+    const char* path = has_prefix ? prefix.c_str() : basepath.c_str();
+    char*       name = get_object_name(fullpath.c_str(), path);
+
+    if(!name){
+        S3FS_PRN_WARN("name is something wrong. but continue.");
+        return true;
+    }
+    if((const char*)name == c_strErrorObjectName){
+        S3FS_PRN_DBG("name is file or subdir in dir. but continue.");
+        return true;
+    }
+    bool result;
+    if(plock){
+        AutoLock lock(plock);
+        result = phead->insert(name, petag, is_cprefix, psize, plastmodified);
+    }else{
+        result = phead->insert(name, petag, is_cprefix, psize, plastmodified);
+    }
+    free(name);
+    if(!result){
+        S3FS_PRN_ERR("insert_object returns with error.");
+    }
+    return result;
+}
+
+bool ListBucketParser::AddEntry(bool is_cprefix)
+{
+    if(key.empty()){
+        S3FS_PRN_WARN("key is empty. but continue.");
+        return true;
+    }
+    if(last_key < key){
+        last_key = key;
+    }
+    if(!has_prefix && !is_finished){
+        // <Prefix> may be after this entry, then keep it until <Prefix> is found.
+        listbucket_entry entry;
+        entry.key          = key;
+        entry.etag         = etag;
+        entry.size         = size;
+        entry.lastmodified = lastmodified;
+        entry.is_cprefix   = is_cprefix;
+        pendings.push_back(entry);
+        return true;
+    }
+    return InsertEntry(key, (!etag.empty() ? etag.c_str() : NULL), (!size.empty() ? size.c_str() : NULL), (!lastmodified.empty() ? lastmodified.c_str() : NULL), is_cprefix);
+}
+
+bool ListBucketParser::FlushPendings()
+{
+    for(listbucket_entries_t::const_iterator iter = pendings.begin(); pendings.end() != iter; ++iter){
+        if(!InsertEntry(iter->key, (!iter->etag.empty() ? iter->etag.c_str() : NULL), (!iter->size.empty() ? iter->size.c_str() : NULL), (!iter->lastmodified.empty() ? iter->lastmodified.c_str() : NULL), iter->is_cprefix)){
+            pendings.clear();
+            return false;
         }
-        xmlNodeSetPtr key_nodes = key->nodesetval;
-        char* name = get_object_name(doc, key_nodes->nodeTab[0]->xmlChildrenNode, path);
-
-        if(!name){
-            S3FS_PRN_WARN("name is something wrong. but continue.");
-
-        }else if((const char*)name != c_strErrorObjectName){
-            is_dir  = isCPrefix ? true : false;
-            stretag = "";
-            strsize = "";
-            strlastmodified = "";
-            if(!isCPrefix){
-                // Get ETag
-                if (ex_etag) {
-                    xmlXPathObjectPtr ETag;
-                    if(NULL != (ETag = xmlXPathEvalExpression((xmlChar*)ex_etag, ctx))){
-                        if(xmlXPathNodeSetIsEmpty(ETag->nodesetval)){
-                            S3FS_PRN_INFO("ETag->nodesetval is empty.");
-                        }else{
-                            xmlNodeSetPtr etag_nodes = ETag->nodesetval;
-                            xmlChar* petag = xmlNodeListGetString(doc, etag_nodes->nodeTab[0]->xmlChildrenNode, 1);
-                            if(petag){
-                                stretag = (char*)petag;
-                                xmlFree(petag);
-                            }
-                        }
-                        xmlXPathFreeObject(ETag);
-                    }
-                }
+    }
+    pendings.clear();
+    return true;
+}
 
-                // Get Size
-                if (ex_size) {
-                    xmlXPathObjectPtr Size;
-                    if(NULL != (Size = xmlXPathEvalExpression((xmlChar*)ex_size, ctx))){
-                        if(xmlXPathNodeSetIsEmpty(Size->nodesetval)){
-                            S3FS_PRN_INFO("Size->nodesetval is empty.");
-                        }else{
-                            xmlNodeSetPtr size_nodes = Size->nodesetval;
-                            xmlChar* psize = xmlNodeListGetString(doc, size_nodes->nodeTab[0]->xmlChildrenNode, 1);
-                            if(psize){
-                                strsize = (char*)psize;
-                                xmlFree(psize);
-                            }
-                        }
-                        xmlXPathFreeObject(Size);
-                    }
-                }
+void ListBucketParser::StartElement(void* ctx, const xmlChar* localname, const xmlChar* prefix, const xmlChar* URI, int nb_namespaces, const xmlChar** namespaces, int nb_attributes, int nb_defaulted, const xmlChar** attributes)
+{
+    ListBucketParser* pparser = static_cast<ListBucketParser*>(ctx);
+    const char*       name    = reinterpret_cast<const char*>(localname);
 
-                // Get Last Modified
-                if (ex_last_modified) {
-                    xmlXPathObjectPtr LastModified;
-                    if(NULL != (LastModified = xmlXPathEvalExpression((xmlChar*)ex_last_modified, ctx))){
-                        if(xmlXPathNodeSetIsEmpty(LastModified->nodesetval)){
-                            S3FS_PRN_INFO("LastModified->nodesetval is empty.");
-                        }else{
-                            xmlNodeSetPtr last_modified_nodes = LastModified->nodesetval;
-                            xmlChar* plastmodified = xmlNodeListGetString(doc, last_modified_nodes->nodeTab[0]->xmlChildrenNode, 1);
-                            if(plastmodified){
-                                strlastmodified = (char*)plastmodified;
-                                xmlFree(plastmodified);
-                            }
-                        }
-                        xmlXPathFreeObject(LastModified);
-                    }
-                }
+    ++pparser->depth;
+    pparser->ptext = NULL;
+
+    if(1 == pparser->depth){
+        pparser->is_listresult = (0 == strcmp(name, "ListBucketResult"));
+
+    }else if(!pparser->is_listresult){
+        // something wrong(ex. error response), then ignore all.
+
+    }else if(2 == pparser->depth){
+        if(0 == strcmp(name, "Contents") || 0 == strcmp(name, "CommonPrefixes")){
+            // IsTruncated and the next marker are before the entries.
+            pparser->NotifyNextLocked();
+        }
+        if(0 == strcmp(name, "Contents")){
+            pparser->in_entry = ENTRY_CONTENTS;
+            pparser->key.clear();
+            pparser->etag.clear();
+            pparser->size.clear();
+            pparser->lastmodified.clear();
+        }else if(0 == strcmp(name, "CommonPrefixes")){
+            pparser->in_entry = ENTRY_CPREFIX;
+            pparser->key.clear();
+            pparser->etag.clear();
+            pparser->size.clear();
+            pparser->lastmodified.clear();
+        }else if(0 == strcmp(name, "Prefix") || 0 == strcmp(name, "IsTruncated") || 0 == strcmp(name, "NextMarker") || 0 == strcmp(name, "NextContinuationToken")){
+            pparser->text.clear();
+            pparser->ptext = &pparser->text;
+        }
+
+    }else if(3 == pparser->depth){
+        if(ENTRY_CONTENTS == pparser->in_entry){
+            if(0 == strcmp(name, "Key")){
+                pparser->ptext = &pparser->key;
+            }else if(0 == strcmp(name, "ETag")){
+                pparser->ptext = &pparser->etag;
+            }else if(0 == strcmp(name, "Size")){
+                pparser->ptext = &pparser->size;
+            }else if(0 == strcmp(name, "LastModified")){
+                pparser->ptext = &pparser->lastmodified;
             }
-            if(!head.insert(name, (!stretag.empty() ? stretag.c_str() : NULL), is_dir, (!strsize.empty() ? strsize.c_str() : NULL), (!strlastmodified.empty() ? strlastmodified.c_str() : NULL))){
-                S3FS_PRN_ERR("insert_object returns with error.");
-                xmlXPathFreeObject(key);
-                xmlXPathFreeObject(contents_xp);
-                free(name);
-                S3FS_MALLOCTRIM(0);
-                return -1;
+        }else if(ENTRY_CPREFIX == pparser->in_entry){
+            if(0 == strcmp(name, "Prefix")){
+                pparser->ptext = &pparser->key;
             }
-            free(name);
-        }else{
-            S3FS_PRN_DBG("name is file or subdir in dir. but continue.");
         }
-        xmlXPathFreeObject(key);
     }
-    S3FS_XMLXPATHFREEOBJECT(contents_xp);
-
-    return 0;
 }
 
-int append_objects_from_xml(const char* path, xmlDocPtr doc, S3ObjList& head)
+void ListBucketParser::EndElement(void* ctx, const xmlChar* localname, const xmlChar* prefix, const xmlChar* URI)
 {
-    std::string xmlnsurl;
-    std::string ex_contents = "//";
-    std::string ex_key;
-    std::string ex_cprefix  = "//";
-    std::string ex_prefix;
-    std::string ex_etag;
-    std::string ex_size;
-    std::string ex_last_modified;
-
-    if(!doc){
-        return -1;
+    ListBucketParser* pparser = static_cast<ListBucketParser*>(ctx);
+    const char*       name    = reinterpret_cast<const char*>(localname);
+
+    if(pparser->is_listresult && 2 == pparser->depth){
+        if(ENTRY_NONE != pparser->in_entry){
+            if(!pparser->AddEntry(ENTRY_CPREFIX == pparser->in_entry)){
+                pparser->is_failed = true;
+                xmlStopParser(pparser->ctxt);
+            }
+            pparser->in_entry = ENTRY_NONE;
+
+        }else if(0 == strcmp(name, "Prefix")){
+            pparser->prefix     = pparser->text;
+            pparser->has_prefix = true;
+            if(!pparser->FlushPendings()){
+                pparser->is_failed = true;
+                xmlStopParser(pparser->ctxt);
+            }
+        }else if(0 == strcmp(name, "IsTruncated")){
+            pparser->truncated = (0 == strcasecmp(pparser->text.c_str(), "true"));
+        }else if(0 == strcmp(name, "NextMarker")){
+            pparser->next_marker = pparser->text;
+        }else if(0 == strcmp(name, "NextContinuationToken")){
+            pparser->next_token = pparser->text;
+        }
     }
+    pparser->ptext = NULL;
+    --pparser->depth;
+}
 
-    // If there is not <Prefix>, use path instead of it.
-    xmlChar* pprefix = get_prefix(doc);
-    std::string prefix  = (pprefix ? (char*)pprefix : path ? path : "");
-    if(pprefix){
-        xmlFree(pprefix);
+void ListBucketParser::Characters(void* ctx, const xmlChar* ch, int len)
+{
+    ListBucketParser* pparser = static_cast<ListBucketParser*>(ctx);
+    if(pparser->ptext && ch && 0 < len){
+        pparser->ptext->append(reinterpret_cast<const char*>(ch), len);
     }
+}
 
-    xmlXPathContextPtr ctx = xmlXPathNewContext(doc);
-
-    if(!noxmlns && GetXmlNsUrl(doc, xmlnsurl)){
-        xmlXPathRegisterNs(ctx, (xmlChar*)"s3", (xmlChar*)xmlnsurl.c_str());
-        ex_contents+= "s3:";
-        ex_key     += "s3:";
-        ex_cprefix += "s3:";
-        ex_prefix  += "s3:";
-        ex_etag    += "s3:";
-        ex_size    += "s3:";
-        ex_last_modified += "s3:";
-    }
-    ex_contents+= "Contents";
-    ex_key     += "Key";
-    ex_cprefix += "CommonPrefixes";
-    ex_prefix  += "Prefix";
-    ex_etag    += "ETag";
-    ex_size    += "Size";
-    ex_last_modified += "LastModified";
-
-    if(-1 == append_objects_from_xml_ex(prefix.c_str(), doc, ctx, ex_contents.c_str(), ex_key.c_str(), ex_etag.c_str(), ex_size.c_str(), ex_last_modified.c_str(), 0, head) ||
-       -1 == append_objects_from_xml_ex(prefix.c_str(), doc, ctx, ex_cprefix.c_str(), ex_prefix.c_str(), NULL, NULL, NULL, 1, head) )
-    {
-        S3FS_PRN_ERR("append_objects_from_xml_ex returns with error.");
-        S3FS_XMLXPATHFREECONTEXT(ctx);
-        return -1;
+void ListBucketParser::StructuredError(void* ctx, xmlErrorPtr error)
+{
+    if(error && error->message){
+        S3FS_PRN_WARN("xml parser error: %s", error->message);
     }
-    S3FS_XMLXPATHFREECONTEXT(ctx);
-
-    return 0;
 }
 
 //-------------------------------------------------------------------
@@ -559,6 +598,58 @@ bool simple_parse_xml(const char* data, size_t len, const char* key, std::string
     return result;
 }
 
+//
+// Parse the response of DeleteMultipleObjects, and pick up the keys which
+// could not be deleted with their error codes.
+// The response is like following, Deleted elements are not returned
+// in quiet mode.
+//   <DeleteResult>
+//     <Error><Key>...</Key><Code>...</Code><Message>...</Message></Error>
+//   </DeleteResult>
+//
+bool get_delete_errors_xml(const char* data, size_t len, std::map<std::string, std::string>& errors)
+{
+    errors.clear();
+    if(!data || 0 == len){
+        // quiet mode with no error may return empty body
+        return true;
+    }
+
+    xmlDocPtr doc;
+    if(NULL == (doc = xmlReadMemory(data, static_cast<int>(len), "", NULL, 0))){
+        return false;
+    }
+    xmlNodePtr root = xmlDocGetRootElement(doc);
+    if(NULL == root){
+        S3FS_XMLFREEDOC(doc);
+        return false;
+    }
+    for(xmlNodePtr err_node = root->children; NULL != err_node; err_node = err_node->next){
+        if(XML_ELEMENT_NODE != err_node->type || 0 != strcmp(reinterpret_cast<const char*>(err_node->name), "Error")){
+            continue;
+        }
+        std::string key;
+        std::string code;
+        for(xmlNodePtr cur_node = err_node->children; NULL != cur_node; cur_node = cur_node->next){
+            if(XML_ELEMENT_NODE != cur_node->type || !cur_node->children || XML_TEXT_NODE != cur_node->children->type){
+                continue;
+            }
+            if(0 == strcmp(reinterpret_cast<const char*>(cur_node->name), "Key")){
+                key = reinterpret_cast<const char*>(cur_node->children->content);
+            }else if(0 == strcmp(reinterpret_cast<const char*>(cur_node->name), "Code")){
+                code = reinterpret_cast<const char*>(cur_node->children->content);
+            }
+        }
+        if(key.empty()){
+            continue;
+        }
+        errors[('/' == key[0] ? "" : "/") + key] = code;
+    }
+    S3FS_XMLFREEDOC(doc);
+
+    return true;
+}
+
 //-------------------------------------------------------------------
 // Utility for lock
 //-------------------------------------------------------------------
@@ -24,27 +24,125 @@
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
 #include <libxml/tree.h>
+#include <libxml/parser.h>
 
+#include <map>
 #include <string>
+#include <vector>
 
 #include "s3objlist.h"
 #include "mpu_util.h"
+#include "psemaphore.h"
 
 //-------------------------------------------------------------------
 // Functions
 //-------------------------------------------------------------------
-bool is_truncated(xmlDocPtr doc);
-int append_objects_from_xml_ex(const char* path, xmlDocPtr doc, xmlXPathContextPtr ctx, const char* ex_contents, const char* ex_key, const char* ex_etag, const char* ex_size, const char* ex_last_modified, int isCPrefix, S3ObjList& head);
-int append_objects_from_xml(const char* path, xmlDocPtr doc, S3ObjList& head);
-xmlChar* get_next_continuation_token(xmlDocPtr doc);
-xmlChar* get_next_marker(xmlDocPtr doc);
 bool get_incomp_mpu_list(xmlDocPtr doc, incomp_mpu_list_t& list);
 
 bool simple_parse_xml(const char* data, size_t len, const char* key, std::string& value);
+bool get_delete_errors_xml(const char* data, size_t len, std::map<std::string, std::string>& errors);
 
 bool init_parser_xml_lock();
 bool destroy_parser_xml_lock();
 
+//-------------------------------------------------------------------
+// Class ListBucketParser
+//-------------------------------------------------------------------
+// This is the streaming parser for the response of ListObjects.
+// The response body is fed from curl write callback piece by piece, and
+// each object is inserted into S3ObjList as soon as it is parsed.
+// IsTruncated, NextMarker and NextContinuationToken are also picked up
+// in the same pass. This does not build DOM nor use XPath, thus it does
+// not need the parser lock.
+// OSS returns IsTruncated and the next marker(token) before the entries,
+// so the parser posts the semaphore which is set by SetNextNotify() when
+// they are found(at the first entry or the end of response), then the
+// caller can start the request for the next page before this page is
+// completely received.
+//
+struct listbucket_entry
+{
+    std::string key;
+    std::string etag;
+    std::string size;
+    std::string lastmodified;
+    bool        is_cprefix;
+
+    listbucket_entry() : is_cprefix(false) {}
+};
+
+typedef std::vector<listbucket_entry> listbucket_entries_t;
+
+class ListBucketParser
+{
+    private:
+        enum entry_type_t{
+            ENTRY_NONE = 0,
+            ENTRY_CONTENTS,
+            ENTRY_CPREFIX
+        };
+
+        xmlParserCtxtPtr     ctxt;
+        std::string          basepath;          // used if there is no <Prefix>
+        S3ObjList*           phead;
+        int                  depth;
+        bool                 is_listresult;     // root element is <ListBucketResult>
+        bool                 is_failed;
+        bool                 is_finished;
+        entry_type_t         in_entry;
+        std::string*         ptext;             // buffer for the text of current element(NULL is ignored)
+        std::string          text;
+        std::string          prefix;
+        bool                 has_prefix;
+        std::string          key;
+        std::string          etag;
+        std::string          size;
+        std::string          lastmodified;
+        bool                 truncated;
+        std::string          next_marker;
+        std::string          next_token;
+        listbucket_entries_t pendings;          // entries before <Prefix>
+        pthread_mutex_t*     plock;             // lock for head(if NULL, not locked)
+        std::string          end_key;           // the entry whose key is over this is ignored(if empty, not checked)
+        std::string          last_key;          // the last key in response
+        Semaphore*           pnext_sem;         // posted when the next marker is found
+        bool                 is_next_notified;
+        bool                 notified_truncated;
+        std::string          notified_marker;
+        std::string          notified_token;
+
+    private:
+        static void StartElement(void* ctx, const xmlChar* localname, const xmlChar* prefix, const xmlChar* URI, int nb_namespaces, const xmlChar** namespaces, int nb_attributes, int nb_defaulted, const xmlChar** attributes);
+        static void EndElement(void* ctx, const xmlChar* localname, const xmlChar* prefix, const xmlChar* URI);
+        static void Characters(void* ctx, const xmlChar* ch, int len);
+        static void StructuredError(void* ctx, xmlErrorPtr error);
+
+        bool InsertEntry(const std::string& fullpath, const char* petag, const char* psize, const char* plastmodified, bool is_cprefix);
+        bool AddEntry(bool is_cprefix);
+        bool FlushPendings();
+        void NotifyNextLocked();
+
+    public:
+        ListBucketParser(const char* path, S3ObjList& head, pthread_mutex_t* plock = NULL, const char* end_key = NULL);
+        ~ListBucketParser();
+
+        bool Reset();
+        bool Parse(const char* data, size_t len);
+        bool Finish();
+
+        bool IsTruncated() const { return truncated; }
+        const std::string& GetNextMarker() const { return next_marker; }
+        const std::string& GetNextContinuationToken() const { return next_token; }
+        const std::string& GetLastKey() const { return last_key; }
+
+        // for starting the next page early
+        void SetNextNotify(Semaphore* psem) { pnext_sem = psem; }
+        void NotifyNext();
+        bool IsNotifiedTruncated() const { return notified_truncated; }
+        const std::string& GetNotifiedMarker() const { return notified_marker; }
+        const std::string& GetNotifiedContinuationToken() const { return notified_token; }
+};
+
 #endif // S3FS_S3FS_XML_H_
 
 /*
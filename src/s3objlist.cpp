@@ -20,10 +20,100 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <algorithm>
 
 #include "common.h"
 #include "s3fs.h"
 #include "s3objlist.h"
+#include "metaheader.h"
+#include "string_util.h"
+
+//-------------------------------------------------------------------
+// Symbols
+//-------------------------------------------------------------------
+#define S3OBJ_FLAG_DIR          0x01
+#define S3OBJ_FLAG_NORMALIZED   0x02    // alias is the normalized name
+#define S3OBJ_FLAG_ALIAS        0x04    // alias is the original name(if not set, it is same as name)
+#define S3OBJ_FLAG_REMOVED      0x08
+#define S3OBJ_FLAG_ETAG_DIGEST  0x10    // etag is stored as binary digest
+#define S3OBJ_FLAG_ETAG_TEXT    0x20    // etag is stored as text in arena
+#define S3OBJ_FLAG_ETAG_QUOTED  0x40    // the digest etag is quoted
+#define S3OBJ_FLAG_ETAG_LOWER   0x80    // the digest etag is lower case hex
+
+#define S3OBJ_FLAG_ETAG_MASK    (S3OBJ_FLAG_ETAG_DIGEST | S3OBJ_FLAG_ETAG_TEXT | S3OBJ_FLAG_ETAG_QUOTED | S3OBJ_FLAG_ETAG_LOWER)
+
+static const size_t S3OBJ_MIN_HASH_SLOTS = 16;
+
+//-------------------------------------------------------------------
+// Utility
+//-------------------------------------------------------------------
+static int hex_to_int(char ch)
+{
+    if('0' <= ch && ch <= '9'){
+        return ch - '0';
+    }else if('a' <= ch && ch <= 'f'){
+        return ch - 'a' + 10;
+    }else if('A' <= ch && ch <= 'F'){
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+static void reset_s3obj_entry(s3obj_entry& entry)
+{
+    entry.alias_pos    = 0;
+    entry.alias_len    = 0;
+    entry.size         = -1;
+    entry.lastmodified = -1;
+    entry.etag_parts   = 0;
+    entry.flags        = 0;
+    memset(entry.etag_digest, 0, sizeof(entry.etag_digest));
+}
+
+//
+// Comparator for sorting the index of objects by name
+//
+struct s3obj_name_less
+{
+    const S3ObjList* plist;
+
+    explicit s3obj_name_less(const S3ObjList* plist) : plist(plist) {}
+
+    bool operator()(unsigned int lhs, unsigned int rhs) const
+    {
+        const s3obj_entry& left  = plist->objects[lhs];
+        const s3obj_entry& right = plist->objects[rhs];
+        return S3ObjList::NameLess(plist->GetString(left.name_pos), left.name_len, plist->GetString(right.name_pos), right.name_len);
+    }
+};
+
+//-------------------------------------------------------------------
+// Class S3ObjList::const_iterator
+//-------------------------------------------------------------------
+const s3obj_entry& S3ObjList::const_iterator::entry() const
+{
+    return plist->objects[plist->sorted[pos]];
+}
+
+const char* S3ObjList::const_iterator::name() const
+{
+    return plist->GetString(entry().name_pos);
+}
+
+bool S3ObjList::const_iterator::is_dir() const
+{
+    return (0 != (entry().flags & S3OBJ_FLAG_DIR));
+}
+
+bool S3ObjList::const_iterator::is_normalized() const
+{
+    return (0 != (entry().flags & S3OBJ_FLAG_NORMALIZED));
+}
+
+std::string S3ObjList::const_iterator::etag() const
+{
+    return plist->GetETag(entry());
+}
 
 //-------------------------------------------------------------------
 // Class S3ObjList
@@ -35,13 +125,258 @@
 // If name is terminated by "_$folder$", it is forced dir type.
 // If is_dir is true and name is not terminated by "/", the name is added "/".
 //
+// The entries are appended in the order of inserting and are found by
+// the open addressing hash table of their index. The index in name order
+// is built only when iterating, because the listing returns the objects
+// in almost sorted order and the list is iterated after all of them are
+// inserted. The removed entry is left with the removed flag.
+//
+S3ObjList::S3ObjList() : count(0), is_sorted(true)
+{
+}
+
+size_t S3ObjList::Hash(const char* name, size_t length)
+{
+    // FNV-1a
+    size_t hash = static_cast<size_t>(14695981039346656037ULL);
+    for(size_t pos = 0; pos < length; ++pos){
+        hash ^= static_cast<unsigned char>(name[pos]);
+        hash *= static_cast<size_t>(1099511628211ULL);
+    }
+    return hash;
+}
+
+bool S3ObjList::NameLess(const char* name1, size_t len1, const char* name2, size_t len2)
+{
+    int result = memcmp(name1, name2, std::min(len1, len2));
+    if(0 != result){
+        return (result < 0);
+    }
+    return (len1 < len2);
+}
+
+size_t S3ObjList::AddString(const char* str, size_t length)
+{
+    size_t pos = arena.size();
+    arena.insert(arena.end(), str, str + length);
+    arena.push_back('\0');
+    return pos;
+}
+
+void S3ObjList::Rehash(size_t slots)
+{
+    hashtable.assign(slots, 0);
+    size_t mask = slots - 1;
+    for(size_t index = 0; index < objects.size(); ++index){
+        size_t slot = Hash(GetString(objects[index].name_pos), objects[index].name_len) & mask;
+        while(0 != hashtable[slot]){
+            slot = (slot + 1) & mask;
+        }
+        hashtable[slot] = static_cast<unsigned int>(index + 1);
+    }
+}
+
+//
+// Find the entry including removed one.
+//
+s3obj_entry* S3ObjList::FindS3Obj(const char* name, size_t length) const
+{
+    if(hashtable.empty()){
+        return NULL;
+    }
+    size_t mask = hashtable.size() - 1;
+    for(size_t slot = Hash(name, length) & mask; 0 != hashtable[slot]; slot = (slot + 1) & mask){
+        const s3obj_entry& entry = objects[hashtable[slot] - 1];
+        if(entry.name_len == length && 0 == memcmp(GetString(entry.name_pos), name, length)){
+            return const_cast<s3obj_entry*>(&entry);
+        }
+    }
+    return NULL;
+}
+
+//
+// Add new entry, the caller must check that the name does not exist.
+// The pointer to other entries is invalid after calling this.
+//
+s3obj_entry* S3ObjList::AddS3Obj(const char* name, size_t length)
+{
+    if(hashtable.size() < (objects.size() + 1) * 2){
+        Rehash(std::max(S3OBJ_MIN_HASH_SLOTS, hashtable.size() * 2));
+    }
+
+    s3obj_entry entry;
+    reset_s3obj_entry(entry);
+    entry.name_pos = AddString(name, length);
+    entry.name_len = static_cast<unsigned int>(length);
+    objects.push_back(entry);
+
+    size_t mask = hashtable.size() - 1;
+    size_t slot = Hash(name, length) & mask;
+    while(0 != hashtable[slot]){
+        slot = (slot + 1) & mask;
+    }
+    hashtable[slot] = static_cast<unsigned int>(objects.size());
+
+    ++count;
+    is_sorted = false;
+    return &objects.back();
+}
+
+void S3ObjList::RemoveS3Obj(s3obj_entry* pentry)
+{
+    if(0 == (pentry->flags & S3OBJ_FLAG_REMOVED)){
+        pentry->flags |= S3OBJ_FLAG_REMOVED;
+        --count;
+        is_sorted = false;
+    }
+}
+
+void S3ObjList::SortIfNeeded() const
+{
+    if(is_sorted){
+        return;
+    }
+    sorted.clear();
+    sorted.reserve(count);
+    for(size_t index = 0; index < objects.size(); ++index){
+        if(0 == (objects[index].flags & S3OBJ_FLAG_REMOVED)){
+            sorted.push_back(static_cast<unsigned int>(index));
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), s3obj_name_less(this));
+    is_sorted = true;
+}
+
+S3ObjList::const_iterator S3ObjList::begin() const
+{
+    SortIfNeeded();
+    return const_iterator(this, 0);
+}
+
+S3ObjList::const_iterator S3ObjList::end() const
+{
+    SortIfNeeded();
+    return const_iterator(this, sorted.size());
+}
+
+//
+// The etag which is formatted as "<hex digest>" or "<hex digest>-<parts>"
+// (optionally quoted) is stored as binary, otherwise stored as text.
+//
+void S3ObjList::SetETag(s3obj_entry& entry, const char* etag)
+{
+    entry.flags     &= ~S3OBJ_FLAG_ETAG_MASK;
+    entry.etag_parts = 0;
+
+    size_t      length = strlen(etag);
+    const char* pdigest = etag;
+    size_t      digest_len = length;
+    bool        is_quoted  = (2 <= length && '"' == etag[0] && '"' == etag[length - 1]);
+    if(is_quoted){
+        ++pdigest;
+        digest_len -= 2;
+    }
+
+    bool          is_digest = (S3OBJ_DIGEST_SIZE * 2 <= digest_len);
+    bool          has_upper = false;
+    bool          has_lower = false;
+    unsigned char digest[S3OBJ_DIGEST_SIZE];
+    for(size_t pos = 0; is_digest && pos < S3OBJ_DIGEST_SIZE * 2; ++pos){
+        int value = hex_to_int(pdigest[pos]);
+        if(value < 0){
+            is_digest = false;
+            break;
+        }
+        if('a' <= pdigest[pos] && pdigest[pos] <= 'f'){
+            has_lower = true;
+        }else if('A' <= pdigest[pos] && pdigest[pos] <= 'F'){
+            has_upper = true;
+        }
+        if(0 == (pos % 2)){
+            digest[pos / 2] = static_cast<unsigned char>(value << 4);
+        }else{
+            digest[pos / 2] |= static_cast<unsigned char>(value);
+        }
+    }
+    if(has_upper && has_lower){
+        is_digest = false;
+    }
+
+    unsigned int parts = 0;
+    if(is_digest && S3OBJ_DIGEST_SIZE * 2 < digest_len){
+        // "-<parts>" which does not start with '0'
+        const char* psuffix   = pdigest + S3OBJ_DIGEST_SIZE * 2;
+        size_t      suffix_len = digest_len - S3OBJ_DIGEST_SIZE * 2;
+        if('-' != psuffix[0] || suffix_len < 2 || 10 < suffix_len || '0' == psuffix[1]){
+            is_digest = false;
+        }else{
+            for(size_t pos = 1; pos < suffix_len; ++pos){
+                if(psuffix[pos] < '0' || '9' < psuffix[pos]){
+                    is_digest = false;
+                    break;
+                }
+                parts = parts * 10 + static_cast<unsigned int>(psuffix[pos] - '0');
+            }
+        }
+    }
+
+    if(is_digest){
+        memcpy(entry.etag_digest, digest, sizeof(digest));
+        entry.etag_parts = parts;
+        entry.flags     |= S3OBJ_FLAG_ETAG_DIGEST;
+        if(is_quoted){
+            entry.flags |= S3OBJ_FLAG_ETAG_QUOTED;
+        }
+        if(has_lower){
+            entry.flags |= S3OBJ_FLAG_ETAG_LOWER;
+        }
+    }else{
+        size_t       pos = AddString(etag, length);
+        unsigned int len = static_cast<unsigned int>(length);
+        memcpy(entry.etag_digest, &pos, sizeof(pos));
+        memcpy(entry.etag_digest + sizeof(pos), &len, sizeof(len));
+        entry.flags |= S3OBJ_FLAG_ETAG_TEXT;
+    }
+}
+
+std::string S3ObjList::GetETag(const s3obj_entry& entry) const
+{
+    if(0 != (entry.flags & S3OBJ_FLAG_ETAG_TEXT)){
+        size_t       pos;
+        unsigned int len;
+        memcpy(&pos, entry.etag_digest, sizeof(pos));
+        memcpy(&len, entry.etag_digest + sizeof(pos), sizeof(len));
+        return std::string(GetString(pos), len);
+    }
+    if(0 == (entry.flags & S3OBJ_FLAG_ETAG_DIGEST)){
+        return std::string("");
+    }
+
+    const char* hexchars = (0 != (entry.flags & S3OBJ_FLAG_ETAG_LOWER) ? "0123456789abcdef" : "0123456789ABCDEF");
+    std::string etag;
+    if(0 != (entry.flags & S3OBJ_FLAG_ETAG_QUOTED)){
+        etag += '"';
+    }
+    for(size_t pos = 0; pos < S3OBJ_DIGEST_SIZE; ++pos){
+        etag += hexchars[entry.etag_digest[pos] >> 4];
+        etag += hexchars[entry.etag_digest[pos] & 0x0f];
+    }
+    if(0 < entry.etag_parts){
+        etag += "-" + str(entry.etag_parts);
+    }
+    if(0 != (entry.flags & S3OBJ_FLAG_ETAG_QUOTED)){
+        etag += '"';
+    }
+    return etag;
+}
+
 bool S3ObjList::insert(const char* name, const char* etag, bool is_dir, const char* size, const char* last_modified)
 {
     if(!name || '\0' == name[0]){
         return false;
     }
 
-    s3obj_t::iterator iter;
+    s3obj_entry* pentry;
     std::string newname;
     std::string orgname = name;
 
@@ -66,14 +401,14 @@ bool S3ObjList::insert(const char* name, const char* etag, bool is_dir, const ch
     // Check derived name object.
     if(is_dir){
         std::string chkname = newname.substr(0, newname.length() - 1);
-        if(objects.end() != (iter = objects.find(chkname))){
+        if(NULL != (pentry = FindS3Obj(chkname.c_str(), chkname.length())) && 0 == (pentry->flags & S3OBJ_FLAG_REMOVED)){
             // found "dir" object --> remove it.
             S3FS_PRN_DBG("Type Conflict[%s and %s may exist on the cloud at the same time.]", chkname.c_str(), newname.c_str());
-            objects.erase(iter);
+            RemoveS3Obj(pentry);
         }
     }else{
         std::string chkname = newname + "/";
-        if(objects.end() != (iter = objects.find(chkname))){
+        if(NULL != (pentry = FindS3Obj(chkname.c_str(), chkname.length())) && 0 == (pentry->flags & S3OBJ_FLAG_REMOVED)){
             // found "dir/" object --> not add new object.
             // and add normalization
             return insert_normalized(orgname.c_str(), chkname.c_str(), true);
@@ -81,43 +416,95 @@ bool S3ObjList::insert(const char* name, const char* etag, bool is_dir, const ch
     }
 
     // Add object
-    if(objects.end() != (iter = objects.find(newname))){
-        // Found same object --> update information.
-        (*iter).second.normalname.erase();
-        (*iter).second.orgname = orgname;
-        (*iter).second.is_dir  = is_dir;
-        if(etag){
-            (*iter).second.etag = std::string(etag);  // over write
-        }
-        if(size){
-            (*iter).second.size = size;
-        }
-        if(last_modified){
-            (*iter).second.lastmodified = last_modified;
-        }
-    }else{
+    if(NULL == (pentry = FindS3Obj(newname.c_str(), newname.length()))){
         // add new object
-        s3obj_entry newobject;
-        newobject.orgname = orgname;
-        newobject.is_dir  = is_dir;
-        if(etag){
-            newobject.etag = etag;
-        }
-        if(size){
-            newobject.size = size;
-        }
-        if(last_modified){
-            newobject.lastmodified = last_modified;
-        }
-        objects[newname] = newobject;
+        pentry = AddS3Obj(newname.c_str(), newname.length());
+        S3FS_PRN_INFO("add new object[path=%s, size=%s, is_dir:%d]", orgname.c_str(), (size ? size : ""), is_dir);
+    }else if(0 != (pentry->flags & S3OBJ_FLAG_REMOVED)){
+        // removed object --> add it as new object
+        reset_s3obj_entry(*pentry);
+        ++count;
+        is_sorted = false;
+        S3FS_PRN_INFO("add new object[path=%s, size=%s, is_dir:%d]", orgname.c_str(), (size ? size : ""), is_dir);
+    }
 
-        S3FS_PRN_INFO("add new object[path=%s, size=%s, is_dir:%d]", orgname.c_str(), newobject.size.c_str(), is_dir);
+    // update information
+    pentry->flags &= ~(S3OBJ_FLAG_NORMALIZED | S3OBJ_FLAG_ALIAS | S3OBJ_FLAG_DIR);
+    if(is_dir){
+        pentry->flags |= S3OBJ_FLAG_DIR;
+    }
+    if(orgname != newname){
+        pentry->alias_pos = AddString(orgname.c_str(), orgname.length());
+        pentry->alias_len = static_cast<unsigned int>(orgname.length());
+        pentry->flags    |= S3OBJ_FLAG_ALIAS;
+    }
+    if(etag){
+        SetETag(*pentry, etag);                 // over write
+    }
+    if(size){
+        char* pend = NULL;
+        long long value = strtoll(size, &pend, 10);
+        pentry->size = (pend != size && '\0' == *pend && 0 <= value) ? static_cast<off_t>(value) : -1;
+    }
+    if(last_modified){
+        pentry->lastmodified = cvtIAMExpireStringToTime(last_modified);
     }
 
     // add normalization
     return insert_normalized(orgname.c_str(), newname.c_str(), is_dir);
 }
 
+//
+// Insert the entry of other list with its information.
+//
+bool S3ObjList::insert(const const_iterator& src)
+{
+    std::string etag = src.etag();
+    if(!insert(src.name(), (etag.empty() ? NULL : etag.c_str()), src.is_dir())){
+        return false;
+    }
+    s3obj_entry* pentry = FindS3Obj(src.name(), src.name_length());
+    if(pentry && 0 == (pentry->flags & (S3OBJ_FLAG_REMOVED | S3OBJ_FLAG_NORMALIZED))){
+        pentry->size         = src.size();
+        pentry->lastmodified = src.last_modified();
+    }
+    return true;
+}
+
+//
+// Remove the entry by the original name of the object.
+// The directory entry which was made only from "dir_$folder$" object is
+// removed by that name too.
+//
+bool S3ObjList::erase(const char* name)
+{
+    if(!name || '\0' == name[0]){
+        return false;
+    }
+
+    s3obj_entry* pentry;
+    bool         result = false;
+    if(NULL != (pentry = FindS3Obj(name, strlen(name))) && 0 == (pentry->flags & S3OBJ_FLAG_REMOVED)){
+        RemoveS3Obj(pentry);
+        result = true;
+    }
+
+    std::string orgname = name;
+    std::string::size_type pos = orgname.find("_$folder$");
+    if(std::string::npos == pos){
+        return result;
+    }
+    std::string newname = orgname.substr(0, pos) + "/";
+    if(NULL == (pentry = FindS3Obj(newname.c_str(), newname.length())) || 0 != (pentry->flags & S3OBJ_FLAG_REMOVED)){
+        return result;
+    }
+    if(0 == (pentry->flags & S3OBJ_FLAG_ALIAS) || orgname != GetString(pentry->alias_pos)){
+        return result;
+    }
+    RemoveS3Obj(pentry);
+    return true;
+}
+
 bool S3ObjList::insert_normalized(const char* name, const char* normalized, bool is_dir)
 {
     if(!name || '\0' == name[0] || !normalized || '\0' == normalized[0]){
@@ -127,100 +514,103 @@ bool S3ObjList::insert_normalized(const char* name, const char* normalized, bool
         return true;
     }
 
-    s3obj_t::iterator iter;
-    if(objects.end() != (iter = objects.find(name))){
-        // found name --> over write
-        iter->second.orgname.erase();
-        iter->second.etag.erase();
-        iter->second.normalname = normalized;
-        iter->second.is_dir     = is_dir;
-    }else{
+    s3obj_entry* pentry;
+    if(NULL == (pentry = FindS3Obj(name, strlen(name)))){
         // not found --> add new object
-        s3obj_entry newobject;
-        newobject.normalname = normalized;
-        newobject.is_dir     = is_dir;
-        objects[name]        = newobject;
+        pentry = AddS3Obj(name, strlen(name));
+    }else if(0 != (pentry->flags & S3OBJ_FLAG_REMOVED)){
+        reset_s3obj_entry(*pentry);
+        ++count;
+        is_sorted = false;
     }
+    // over write(the original name and etag are erased)
+    pentry->flags     &= ~(S3OBJ_FLAG_ETAG_MASK | S3OBJ_FLAG_ALIAS | S3OBJ_FLAG_DIR);
+    pentry->flags     |= S3OBJ_FLAG_NORMALIZED | (is_dir ? S3OBJ_FLAG_DIR : 0);
+    pentry->alias_pos  = AddString(normalized, strlen(normalized));
+    pentry->alias_len  = static_cast<unsigned int>(strlen(normalized));
+    pentry->etag_parts = 0;
+
     return true;
 }
 
 const s3obj_entry* S3ObjList::GetS3Obj(const char* name) const
 {
-    s3obj_t::const_iterator iter;
+    const s3obj_entry* pentry;
 
     if(!name || '\0' == name[0]){
         return NULL;
     }
-    if(objects.end() == (iter = objects.find(name))){
+    if(NULL == (pentry = FindS3Obj(name, strlen(name))) || 0 != (pentry->flags & S3OBJ_FLAG_REMOVED)){
         return NULL;
     }
-    return &((*iter).second);
+    return pentry;
+}
+
+std::string S3ObjList::GetOrgName(const s3obj_entry& entry) const
+{
+    if(0 != (entry.flags & S3OBJ_FLAG_NORMALIZED)){
+        return std::string("");
+    }
+    if(0 != (entry.flags & S3OBJ_FLAG_ALIAS)){
+        return std::string(GetString(entry.alias_pos), entry.alias_len);
+    }
+    return std::string(GetString(entry.name_pos), entry.name_len);
+}
+
+std::string S3ObjList::GetNormalizedName(const s3obj_entry& entry) const
+{
+    if(0 != (entry.flags & S3OBJ_FLAG_NORMALIZED)){
+        return std::string(GetString(entry.alias_pos), entry.alias_len);
+    }
+    return std::string(GetString(entry.name_pos), entry.name_len);
 }
 
 std::string S3ObjList::GetOrgName(const char* name) const
 {
     const s3obj_entry* ps3obj;
 
-    if(!name || '\0' == name[0]){
-        return std::string("");
-    }
     if(NULL == (ps3obj = GetS3Obj(name))){
         return std::string("");
     }
-    return ps3obj->orgname;
+    return GetOrgName(*ps3obj);
 }
 
 std::string S3ObjList::GetNormalizedName(const char* name) const
 {
     const s3obj_entry* ps3obj;
 
-    if(!name || '\0' == name[0]){
-        return std::string("");
-    }
     if(NULL == (ps3obj = GetS3Obj(name))){
         return std::string("");
     }
-    if(ps3obj->normalname.empty()){
-        return std::string(name);
-    }
-    return ps3obj->normalname;
+    return GetNormalizedName(*ps3obj);
 }
 
 std::string S3ObjList::GetETag(const char* name) const
 {
     const s3obj_entry* ps3obj;
 
-    if(!name || '\0' == name[0]){
-        return std::string("");
-    }
     if(NULL == (ps3obj = GetS3Obj(name))){
         return std::string("");
     }
-    return ps3obj->etag;
+    return GetETag(*ps3obj);
 }
 
-std::string S3ObjList::GetSize(const char* name) const
+off_t S3ObjList::GetSize(const char* name) const
 {
     const s3obj_entry* ps3obj;
 
-    if(!name || '\0' == name[0]){
-        return std::string("");
-    }
     if(NULL == (ps3obj = GetS3Obj(name))){
-        return std::string("");
+        return -1;
     }
     return ps3obj->size;
 }
 
-std::string S3ObjList::GetLastModified(const char* name) const
+time_t S3ObjList::GetLastModified(const char* name) const
 {
     const s3obj_entry* ps3obj;
 
-    if(!name || '\0' == name[0]){
-        return std::string("");
-    }
     if(NULL == (ps3obj = GetS3Obj(name))){
-        return std::string("");
+        return -1;
     }
     return ps3obj->lastmodified;
 }
@@ -232,7 +622,7 @@ bool S3ObjList::IsDir(const char* name) const
     if(NULL == (ps3obj = GetS3Obj(name))){
         return false;
     }
-    return ps3obj->is_dir;
+    return (0 != (ps3obj->flags & S3OBJ_FLAG_DIR));
 }
 
 bool S3ObjList::GetLastName(std::string& lastname) const
@@ -240,16 +630,19 @@ bool S3ObjList::GetLastName(std::string& lastname) const
     bool result = false;
     lastname = "";
     for(s3obj_t::const_iterator iter = objects.begin(); iter != objects.end(); ++iter){
-        if((*iter).second.orgname.length()){
-            if(0 > strcmp(lastname.c_str(), (*iter).second.orgname.c_str())){
-                lastname = (*iter).second.orgname;
-                result = true;
-            }
+        if(0 != (iter->flags & S3OBJ_FLAG_REMOVED)){
+            continue;
+        }
+        // the original name, or the normalized name for normalized entry.
+        const char* name;
+        if(0 != (iter->flags & (S3OBJ_FLAG_NORMALIZED | S3OBJ_FLAG_ALIAS))){
+            name = GetString(iter->alias_pos);
         }else{
-            if(0 > strcmp(lastname.c_str(), (*iter).second.normalname.c_str())){
-                lastname = (*iter).second.normalname;
-                result = true;
-            }
+            name = GetString(iter->name_pos);
+        }
+        if(0 > strcmp(lastname.c_str(), name)){
+            lastname = name;
+            result = true;
         }
     }
     return result;
@@ -257,13 +650,11 @@ bool S3ObjList::GetLastName(std::string& lastname) const
 
 bool S3ObjList::GetNameList(s3obj_list_t& list, bool OnlyNormalized, bool CutSlash) const
 {
-    s3obj_t::const_iterator iter;
-
-    for(iter = objects.begin(); objects.end() != iter; ++iter){
-        if(OnlyNormalized && !iter->second.normalname.empty()){
+    for(const_iterator iter = begin(); end() != iter; ++iter){
+        if(OnlyNormalized && iter.is_normalized()){
             continue;
         }
-        std::string name = (*iter).first;
+        std::string name(iter.name(), iter.name_length());
         if(CutSlash && 1 < name.length() && '/' == *name.rbegin()){
             // only "/" std::string is skipped this.
             name.erase(name.length() - 1);
@@ -21,49 +21,122 @@
 #ifndef S3FS_S3OBJLIST_H_
 #define S3FS_S3OBJLIST_H_
 
+#include <list>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
 //-------------------------------------------------------------------
 // Structure / Typedef
 //-------------------------------------------------------------------
+//
+// Entry of S3ObjList
+//
+// All names and the etag which can not be stored as a digest are in one
+// buffer(arena) of the list, and the entry has only their positions.
+// The alias is the original name for a normal entry, or the normalized
+// name for a normalized entry.
+//
+#define S3OBJ_DIGEST_SIZE   16
+
 struct s3obj_entry{
-    std::string normalname; // normalized name: if empty, object is normalized name.
-    std::string orgname;    // original name: if empty, object is original name.
-    std::string etag;
-    std::string size;
-    std::string lastmodified;
-    bool        is_dir;
-
-    s3obj_entry() : is_dir(false) {}
+    size_t        name_pos;                         // position of name in arena(terminated by '\0')
+    size_t        alias_pos;                        // position of alias in arena(terminated by '\0')
+    off_t         size;                             // -1 means not set
+    time_t        lastmodified;                     // -1 means not set
+    unsigned int  name_len;
+    unsigned int  alias_len;
+    unsigned int  etag_parts;                       // count of parts in multipart etag("<digest>-<parts>")
+    unsigned char etag_digest[S3OBJ_DIGEST_SIZE];   // binary etag, or position and length of etag text in arena
+    unsigned char flags;
 };
 
-typedef std::map<std::string, struct s3obj_entry> s3obj_t;
-typedef std::list<std::string> s3obj_list_t;
+typedef std::vector<s3obj_entry>  s3obj_t;
+typedef std::vector<unsigned int> s3obj_index_t;
+typedef std::list<std::string>    s3obj_list_t;
 
 //-------------------------------------------------------------------
 // Class S3ObjList
 //-------------------------------------------------------------------
 class S3ObjList
 {
+    public:
+        //
+        // Iterator in name order, which refers to the entry in the list
+        // without copying it. It is invalid after inserting an object.
+        //
+        class const_iterator
+        {
+            private:
+                const S3ObjList* plist;
+                size_t           pos;
+
+                const s3obj_entry& entry() const;
+
+            public:
+                const_iterator() : plist(NULL), pos(0) {}
+                const_iterator(const S3ObjList* plist, size_t pos) : plist(plist), pos(pos) {}
+
+                const_iterator& operator++() { ++pos; return *this; }
+                bool operator==(const const_iterator& other) const { return (plist == other.plist && pos == other.pos); }
+                bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+                const char* name() const;
+                size_t name_length() const { return entry().name_len; }
+                bool is_dir() const;
+                bool is_normalized() const;
+                off_t size() const { return entry().size; }
+                time_t last_modified() const { return entry().lastmodified; }
+                std::string etag() const;
+        };
+
     private:
-        s3obj_t objects;
+        std::vector<char>     arena;
+        s3obj_t               objects;
+        s3obj_index_t         hashtable;    // index of objects + 1, 0 means empty slot
+        size_t                count;        // count of entries which are not removed
+        mutable s3obj_index_t sorted;       // index of objects in name order(built when iterating)
+        mutable bool          is_sorted;
 
     private:
         bool insert_normalized(const char* name, const char* normalized, bool is_dir);
         const s3obj_entry* GetS3Obj(const char* name) const;
+        s3obj_entry* FindS3Obj(const char* name, size_t length) const;
+        s3obj_entry* AddS3Obj(const char* name, size_t length);
+        void RemoveS3Obj(s3obj_entry* pentry);
+        void Rehash(size_t slots);
+        void SortIfNeeded() const;
+
+        size_t AddString(const char* str, size_t length);
+        const char* GetString(size_t pos) const { return &arena[pos]; }
+        void SetETag(s3obj_entry& entry, const char* etag);
+        std::string GetETag(const s3obj_entry& entry) const;
+        std::string GetOrgName(const s3obj_entry& entry) const;
+        std::string GetNormalizedName(const s3obj_entry& entry) const;
 
-        s3obj_t::const_iterator begin() const { return objects.begin(); }
-        s3obj_t::const_iterator end() const { return objects.end(); }
+        static size_t Hash(const char* name, size_t length);
+        static bool NameLess(const char* name1, size_t len1, const char* name2, size_t len2);
+
+        friend class const_iterator;
+        friend struct s3obj_name_less;
 
     public:
-        S3ObjList() {}
+        S3ObjList();
         ~S3ObjList() {}
 
-        bool IsEmpty() const { return objects.empty(); }
+        bool IsEmpty() const { return (0 == count); }
+        size_t Size() const { return count; }
+        const_iterator begin() const;
+        const_iterator end() const;
+
         bool insert(const char* name, const char* etag = NULL, bool is_dir = false, const char* size = NULL, const char* last_modified = NULL);
+        bool insert(const const_iterator& src);
+        bool erase(const char* name);
         std::string GetOrgName(const char* name) const;
         std::string GetNormalizedName(const char* name) const;
         std::string GetETag(const char* name) const;
-        std::string GetSize(const char* name) const;
-        std::string GetLastModified(const char* name) const;
+        off_t GetSize(const char* name) const;
+        time_t GetLastModified(const char* name) const;
         bool IsDir(const char* name) const;
         bool GetNameList(s3obj_list_t& list, bool OnlyNormalized = true, bool CutSlash = true) const;
         bool GetLastName(std::string& lastname) const;
@@ -0,0 +1,153 @@
+/*
+ * ossfs -  FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "common.h"
+#include "s3fs.h"
+#include "singleflight.h"
+#include "autolock.h"
+
+//-------------------------------------------------------------------
+// Static
+//-------------------------------------------------------------------
+SingleFlight    SingleFlight::singleton;
+pthread_mutex_t SingleFlight::flight_lock;
+
+//-------------------------------------------------------------------
+// Constructor/Destructor
+//-------------------------------------------------------------------
+SingleFlight::SingleFlight()
+{
+    if(this == SingleFlight::getSingleFlight()){
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+        int result;
+        if(0 != (result = pthread_mutex_init(&SingleFlight::flight_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init flight_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+SingleFlight::~SingleFlight()
+{
+    if(this == SingleFlight::getSingleFlight()){
+        // [NOTE]
+        // The entries are left only when the leader did not call Leave(),
+        // nobody can wait for them after here.
+        for(singleflight_t::iterator iter = flights.begin(); iter != flights.end(); ++iter){
+            delete iter->second;
+        }
+        flights.clear();
+
+        int result = pthread_mutex_destroy(&SingleFlight::flight_lock);
+        if(result != 0){
+            S3FS_PRN_CRIT("failed to destroy flight_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+//-------------------------------------------------------------------
+// Methods
+//-------------------------------------------------------------------
+bool SingleFlight::Enter(const std::string& key, int& result, struct stat* pst, headers_t* pmeta, bool* pisforce)
+{
+    singleflight_entry* ent;
+    {
+        AutoLock lock(&SingleFlight::flight_lock);
+
+        singleflight_t::iterator iter = flights.find(key);
+        if(flights.end() == iter){
+            // this caller is leader
+            flights[key] = new singleflight_entry();
+            return true;
+        }
+        ent = iter->second;
+        ++(ent->waiters);
+    }
+    S3FS_PRN_DBG("wait for the request in flight[key=%s]", key.c_str());
+
+    ent->sem.wait();
+
+    AutoLock lock(&SingleFlight::flight_lock);
+
+    result = ent->result;
+    if(pst){
+        *pst = ent->stbuf;
+    }
+    if(pmeta){
+        *pmeta = ent->meta;
+    }
+    if(pisforce){
+        *pisforce = ent->isforce;
+    }
+    if(0 == --(ent->waiters)){
+        delete ent;
+    }
+    return false;
+}
+
+void SingleFlight::Leave(const std::string& key, int result, const struct stat* pst, const headers_t* pmeta, bool isforce)
+{
+    AutoLock lock(&SingleFlight::flight_lock);
+
+    singleflight_t::iterator iter = flights.find(key);
+    if(flights.end() == iter){
+        S3FS_PRN_WARN("there is no request in flight[key=%s]", key.c_str());
+        return;
+    }
+    singleflight_entry* ent = iter->second;
+    flights.erase(iter);                  // new callers do not wait for this result after here.
+
+    ent->result  = result;
+    ent->isforce = isforce;
+    if(pst){
+        ent->stbuf = *pst;
+    }
+    if(pmeta){
+        ent->meta = *pmeta;
+    }
+    if(0 == ent->waiters){
+        delete ent;
+        return;
+    }
+    for(int cnt = 0; cnt < ent->waiters; ++cnt){
+        ent->sem.post();
+    }
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,96 @@
+/*
+ * ossfs -  FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_SINGLEFLIGHT_H_
+#define S3FS_SINGLEFLIGHT_H_
+
+#include "metaheader.h"
+#include "psemaphore.h"
+
+//-------------------------------------------------------------------
+// Structure
+//-------------------------------------------------------------------
+//
+// Struct for the request which is in flight
+//
+// [NOTE]
+// The waiters are woken up by posting the semaphore as many times as
+// the count of waiters. The last one which leaves this entry deletes it.
+//
+struct singleflight_entry
+{
+    int               waiters;
+    Semaphore         sem;
+    int               result;
+    struct stat       stbuf;
+    headers_t         meta;
+    bool              isforce;
+
+    singleflight_entry() : waiters(0), sem(0), result(0), isforce(false)
+    {
+        memset(&stbuf, 0, sizeof(struct stat));
+    }
+};
+
+typedef std::map<std::string, singleflight_entry*> singleflight_t; // key=request type and path
+
+//-------------------------------------------------------------------
+// Class SingleFlight
+//-------------------------------------------------------------------
+// This class coalesces the same requests which are sent at the same time.
+// The first caller(leader) sends the request and the other callers wait
+// for it and share its result.
+//
+// The leader is the caller that Enter() returns true, and it must call
+// Leave() with its result. If Enter() returns false, the caller has
+// already got the result of the leader.
+//
+class SingleFlight
+{
+    private:
+        static SingleFlight    singleton;
+        static pthread_mutex_t flight_lock;
+        singleflight_t         flights;
+
+    private:
+        SingleFlight();
+        ~SingleFlight();
+
+    public:
+        // Reference singleton
+        static SingleFlight* getSingleFlight()
+        {
+            return &singleton;
+        }
+
+        bool Enter(const std::string& key, int& result, struct stat* pst = NULL, headers_t* pmeta = NULL, bool* pisforce = NULL);
+        void Leave(const std::string& key, int result, const struct stat* pst = NULL, const headers_t* pmeta = NULL, bool isforce = false);
+};
+
+#endif // S3FS_SINGLEFLIGHT_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
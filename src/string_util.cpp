@@ -253,6 +253,25 @@ std::string urlDecode(const std::string& s)
     return result;
 }
 
+//
+// Escape the characters which can not be put in XML text as it is.
+//
+std::string xml_escape(const std::string& s)
+{
+    std::string result;
+    for(size_t i = 0; i < s.length(); ++i){
+        switch(s[i]){
+            case '&':  result += "&amp;";  break;
+            case '<':  result += "&lt;";   break;
+            case '>':  result += "&gt;";   break;
+            case '"':  result += "&quot;"; break;
+            case '\'': result += "&apos;"; break;
+            default:   result += s[i];     break;
+        }
+    }
+    return result;
+}
+
 bool takeout_str_dquart(std::string& str)
 {
     size_t pos;
@@ -96,6 +96,7 @@ std::string urlEncode(const std::string &s);
 std::string urlEncode2(const std::string &s);
 std::string urlEncodeOssv4Query(const std::string &s);
 std::string urlDecode(const std::string& s);
+std::string xml_escape(const std::string& s);
 
 bool takeout_str_dquart(std::string& str);
 bool get_keyword_value(const std::string& target, const char* keyword, std::string& value);
@@ -0,0 +1,145 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstring>
+#include <string>
+
+#include "s3objlist.h"
+#include "test_util.h"
+
+void test_insert()
+{
+  S3ObjList list;
+  ASSERT_TRUE(list.IsEmpty());
+
+  ASSERT_TRUE(list.insert("b", "\"5B3C1A2E053D763E1B002CC607C5A0FE\"", false, "123", "2021-01-02T03:04:05.000Z"));
+  ASSERT_TRUE(list.insert("a", "\"5b3c1a2e053d763e1b002cc607c5a0fe-12\"", false, "0", NULL));
+  ASSERT_TRUE(list.insert("c/", "W/etag", false, NULL, NULL));
+  ASSERT_EQUALS(static_cast<size_t>(3), list.Size());
+
+  ASSERT_EQUALS(std::string("\"5B3C1A2E053D763E1B002CC607C5A0FE\""), list.GetETag("b"));
+  ASSERT_EQUALS(std::string("\"5b3c1a2e053d763e1b002cc607c5a0fe-12\""), list.GetETag("a"));
+  ASSERT_EQUALS(std::string("W/etag"), list.GetETag("c/"));
+  ASSERT_EQUALS(off_t(123), list.GetSize("b"));
+  ASSERT_EQUALS(off_t(-1), list.GetSize("c/"));
+  ASSERT_EQUALS(time_t(1609556645), list.GetLastModified("b"));
+  ASSERT_EQUALS(time_t(-1), list.GetLastModified("a"));
+  ASSERT_TRUE(list.IsDir("c/"));
+  ASSERT_FALSE(list.IsDir("b"));
+
+  // iterator is in name order
+  S3ObjList::const_iterator iter = list.begin();
+  ASSERT_STREQUALS("a", iter.name());
+  ++iter;
+  ASSERT_STREQUALS("b", iter.name());
+  ++iter;
+  ASSERT_STREQUALS("c/", iter.name());
+  ++iter;
+  ASSERT_TRUE(list.end() == iter);
+}
+
+void test_normalize()
+{
+  S3ObjList list;
+
+  // "dir" is removed by "dir/"
+  ASSERT_TRUE(list.insert("dir"));
+  ASSERT_TRUE(list.insert("dir/", "\"00000000000000000000000000000000\""));
+  ASSERT_FALSE(list.IsDir("dir"));
+  ASSERT_TRUE(list.IsDir("dir/"));
+
+  // "_$folder$" is normalized
+  ASSERT_TRUE(list.insert("old_$folder$"));
+  ASSERT_TRUE(list.IsDir("old/"));
+  ASSERT_EQUALS(std::string("old/"), list.GetNormalizedName("old_$folder$"));
+  ASSERT_EQUALS(std::string("old_$folder$"), list.GetOrgName("old/"));
+
+  // file after "dir2/" is normalized to it
+  ASSERT_TRUE(list.insert("dir2/"));
+  ASSERT_TRUE(list.insert("dir2"));
+  ASSERT_EQUALS(std::string("dir2/"), list.GetNormalizedName("dir2"));
+
+  s3obj_list_t names;
+  ASSERT_TRUE(list.GetNameList(names, true, false));
+  ASSERT_EQUALS(static_cast<size_t>(3), names.size());
+  s3obj_list_t::const_iterator iter = names.begin();
+  ASSERT_EQUALS(std::string("dir/"), *iter++);
+  ASSERT_EQUALS(std::string("dir2/"), *iter++);
+  ASSERT_EQUALS(std::string("old/"), *iter++);
+
+  std::string lastname;
+  ASSERT_TRUE(list.GetLastName(lastname));
+  ASSERT_EQUALS(std::string("old_$folder$"), lastname);
+}
+
+void test_erase()
+{
+  S3ObjList list;
+
+  ASSERT_TRUE(list.insert("a"));
+  ASSERT_TRUE(list.insert("b/"));
+  ASSERT_TRUE(list.insert("old_$folder$"));
+  ASSERT_EQUALS(static_cast<size_t>(4), list.Size());       // with normalized "old_$folder$"
+
+  ASSERT_TRUE(list.erase("a"));
+  ASSERT_FALSE(list.erase("a"));
+  ASSERT_TRUE(list.erase("old_$folder$"));
+  ASSERT_FALSE(list.IsDir("old/"));
+  ASSERT_EQUALS(static_cast<size_t>(1), list.Size());
+
+  S3ObjList::const_iterator iter = list.begin();
+  ASSERT_STREQUALS("b/", iter.name());
+  ++iter;
+  ASSERT_TRUE(list.end() == iter);
+
+  // removed name can be inserted again
+  ASSERT_TRUE(list.erase("b/"));
+  ASSERT_TRUE(list.IsEmpty());
+  ASSERT_TRUE(list.insert("b/"));
+  ASSERT_TRUE(list.IsDir("b/"));
+}
+
+void test_many()
+{
+  S3ObjList list;
+  char      name[32];
+
+  // inserted in reverse order, then rehashed several times.
+  for(int cnt = 9999; 0 <= cnt; --cnt){
+    snprintf(name, sizeof(name), "file%05d", cnt);
+    ASSERT_TRUE(list.insert(name, NULL, false, "1"));
+  }
+  ASSERT_EQUALS(static_cast<size_t>(10000), list.Size());
+  ASSERT_EQUALS(off_t(1), list.GetSize("file05000"));
+
+  int cnt = 0;
+  for(S3ObjList::const_iterator iter = list.begin(); list.end() != iter; ++iter, ++cnt){
+    snprintf(name, sizeof(name), "file%05d", cnt);
+    ASSERT_STREQUALS(name, iter.name());
+  }
+  ASSERT_EQUALS(10000, cnt);
+}
+
+int main(int argc, char *argv[])
+{
+  test_insert();
+  test_normalize();
+  test_erase();
+  test_many();
+  return 0;
+}
@@ -150,6 +150,13 @@ void test_wtf8_encoding()
     ASSERT_EQUALS(s3fs_wtf8_decode(s3fs_wtf8_encode(mixed)), mixed);
 }
 
+void test_xml_escape()
+{
+    ASSERT_EQUALS(xml_escape(""), std::string(""));
+    ASSERT_EQUALS(xml_escape("dir/file.txt"), std::string("dir/file.txt"));
+    ASSERT_EQUALS(xml_escape("a&b<c>d\"e'f"), std::string("a&amp;b&lt;c&gt;d&quot;e&apos;f"));
+}
+
 int main(int argc, char *argv[])
 {
     S3fsLog singletonLog;
@@ -158,6 +165,7 @@ int main(int argc, char *argv[])
     test_base64();
     test_strtoofft();
     test_wtf8_encoding();
+    test_xml_escape();
 
     return 0;
 }
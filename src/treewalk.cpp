@@ -0,0 +1,143 @@
+/*
+ * ossfs -  FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <errno.h>
+#include <algorithm>
+
+#include "common.h"
+#include "s3fs.h"
+#include "treewalk.h"
+#include "autolock.h"
+
+//-------------------------------------------------------------------
+// Class TreeWalker
+//-------------------------------------------------------------------
+TreeWalker::TreeWalker(int max_workers) : ptasks(NULL), pfunc(NULL), pdata(NULL), next_pos(0), result(0), max_workers(max_workers < 1 ? 1 : max_workers)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    int res;
+    if(0 != (res = pthread_mutex_init(&walk_lock, &attr))){
+        S3FS_PRN_CRIT("failed to init walk_lock: %d", res);
+        abort();
+    }
+}
+
+TreeWalker::~TreeWalker()
+{
+    int res;
+    if(0 != (res = pthread_mutex_destroy(&walk_lock))){
+        S3FS_PRN_CRIT("failed to destroy walk_lock: %d", res);
+        abort();
+    }
+}
+
+//
+// Get the next entry, returns false when all entries are started or
+// some entry has failed.
+//
+bool TreeWalker::Next(treewalk_entry** ppentry)
+{
+    AutoLock lock(&walk_lock);
+
+    if(0 != result || ptasks->size() <= next_pos){
+        return false;
+    }
+    *ppentry = (*ptasks)[next_pos++];
+    return true;
+}
+
+void TreeWalker::SetResult(int res)
+{
+    AutoLock lock(&walk_lock);
+
+    if(0 == result){
+        result = res;
+    }
+}
+
+void* TreeWalker::Worker(void* arg)
+{
+    TreeWalker*     pwalker = static_cast<TreeWalker*>(arg);
+    treewalk_entry* pentry  = NULL;
+
+    while(pwalker->Next(&pentry)){
+        int res;
+        if(0 != (res = pwalker->pfunc(*pentry, pwalker->pdata))){
+            S3FS_PRN_ERR("failed to process %s(%d).", pentry->old_path.c_str(), res);
+            pwalker->SetResult(res);
+        }
+    }
+    return NULL;
+}
+
+int TreeWalker::Execute(const treewalk_tasks_t& tasks, treewalk_func_t func, void* data)
+{
+    if(tasks.empty()){
+        return 0;
+    }
+    ptasks   = &tasks;
+    pfunc    = func;
+    pdata    = data;
+    next_pos = 0;
+    result   = 0;
+
+    int                    count = std::min(max_workers, static_cast<int>(tasks.size()));
+    std::vector<pthread_t> threads;
+    for(int cnt = 0; cnt < count; ++cnt){
+        pthread_t thread;
+        int       res;
+        if(0 != (res = pthread_create(&thread, NULL, TreeWalker::Worker, static_cast<void*>(this)))){
+            S3FS_PRN_WARN("failed pthread_create - rc(%d)", res);
+            break;
+        }
+        threads.push_back(thread);
+    }
+    if(threads.empty()){
+        // run all in this thread
+        TreeWalker::Worker(static_cast<void*>(this));
+    }
+
+    for(std::vector<pthread_t>::iterator iter = threads.begin(); iter != threads.end(); ++iter){
+        void* retval = NULL;
+        int   res;
+        if(0 != (res = pthread_join(*iter, &retval))){
+            S3FS_PRN_ERR("failed pthread_join - rc(%d)", res);
+            SetResult(-EIO);
+        }
+    }
+    ptasks = NULL;
+
+    return result;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
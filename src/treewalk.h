@@ -0,0 +1,102 @@
+/*
+ * ossfs -  FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_TREEWALK_H_
+#define S3FS_TREEWALK_H_
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/types.h>
+
+//-------------------------------------------------------------------
+// Structure / Typedef
+//-------------------------------------------------------------------
+//
+// Entry of the object tree which is listed once by one listing
+//
+struct treewalk_entry
+{
+    std::string old_path;       // path of the object(or directory)
+    std::string new_path;       // destination path for moving(if needed)
+    std::string etag;           // etag in the listing
+    off_t       size;           // size in the listing(-1 means unknown)
+    bool        is_dir;
+    bool        is_normdir;     // directory which does not have the object
+    int         depth;          // depth from the top directory
+
+    treewalk_entry() : size(-1), is_dir(false), is_normdir(false), depth(0) {}
+};
+
+typedef std::vector<treewalk_entry>  treewalk_list_t;
+typedef std::vector<treewalk_entry*> treewalk_tasks_t;
+
+//
+// Prototype function for each entry
+//
+// The data is the argument of TreeWalker::Execute(). The function is
+// called from the worker threads at the same time, and it returns 0 or
+// -errno.
+//
+typedef int (*treewalk_func_t)(treewalk_entry& entry, void* data);
+
+//-------------------------------------------------------------------
+// Class TreeWalker
+//-------------------------------------------------------------------
+// Executes the function for all entries with the bounded number of
+// threads. The function is not retried here, because the requests in it
+// are retried by S3fsCurl::RequestPerform. When one of them fails, the
+// entries which are not started yet are not executed and the first error
+// is returned.
+//
+class TreeWalker
+{
+    private:
+        pthread_mutex_t         walk_lock;
+        const treewalk_tasks_t* ptasks;
+        treewalk_func_t         pfunc;
+        void*                   pdata;
+        size_t                  next_pos;
+        int                     result;
+        int                     max_workers;
+
+    private:
+        static void* Worker(void* arg);
+
+        bool Next(treewalk_entry** ppentry);
+        void SetResult(int result);
+
+    public:
+        TreeWalker(int max_workers);
+        ~TreeWalker();
+
+        int Execute(const treewalk_tasks_t& tasks, treewalk_func_t func, void* data);
+};
+
+#endif // S3FS_TREEWALK_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
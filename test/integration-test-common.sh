@@ -84,6 +84,12 @@ S3PROXY_BINARY="${S3PROXY_BINARY-"s3proxy-${S3PROXY_VERSION}"}"
 CHAOS_HTTP_PROXY_VERSION="1.1.0"
 CHAOS_HTTP_PROXY_BINARY="chaos-http-proxy-${CHAOS_HTTP_PROXY_VERSION}"
 
+# HTTP/2 frontend(nghttpx) in front of S3Proxy, which supports only HTTP/1.1
+: "${H2_PROXY_URL:="https://127.0.0.1:8443"}"
+H2_PROXY_ACCESS_LOG="/tmp/nghttpx-access.log"
+export H2_PROXY_URL
+export H2_PROXY_ACCESS_LOG
+
 if [ ! -f "$OSSFS_CREDENTIALS_FILE" ]
 then
 	echo "Missing credentials file: ${OSSFS_CREDENTIALS_FILE}"
@@ -175,6 +181,27 @@ function start_s3proxy {
         # wait for Chaos HTTP Proxy to start
         wait_for_port 1080
     fi
+
+    if [ -n "${H2_PROXY}" ]; then
+        # generate self-signed SSL certificate, and trust it as well as S3Proxy's
+        rm -f /tmp/nghttpx-key.pem /tmp/nghttpx-cert.pem "${H2_PROXY_ACCESS_LOG}"
+        openssl req -x509 -newkey rsa:2048 -nodes -keyout /tmp/nghttpx-key.pem -out /tmp/nghttpx-cert.pem -days 365 -subj "/CN=127.0.0.1" -addext "subjectAltName=IP:127.0.0.1"
+        cat /tmp/nghttpx-cert.pem >> /tmp/keystore.pem
+
+        # the access log records the connection(client port) and the protocol of each request
+        nghttpx --frontend="127.0.0.1,${H2_PROXY_URL##*:}" \
+            --backend="127.0.0.1,8080;;tls" \
+            --insecure \
+            --no-ocsp \
+            --workers=1 \
+            --accesslog-file="${H2_PROXY_ACCESS_LOG}" \
+            --accesslog-format='$alpn $remote_port $method $status $path' \
+            /tmp/nghttpx-key.pem /tmp/nghttpx-cert.pem &
+        H2_PROXY_PID=$!
+
+        # wait for nghttpx to start
+        wait_for_port "${H2_PROXY_URL##*:}"
+    fi
 }
 
 function stop_s3proxy {
@@ -187,6 +214,11 @@ function stop_s3proxy {
     then
         kill "${CHAOS_HTTP_PROXY_PID}"
     fi
+
+    if [ -n "${H2_PROXY_PID}" ]
+    then
+        kill "${H2_PROXY_PID}"
+    fi
 }
 
 # Mount the bucket, function arguments passed to ossfs in addition to
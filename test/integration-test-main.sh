@@ -217,6 +217,46 @@ function test_mv_nonempty_directory {
     fi
 }
 
+function test_mv_nested_directory {
+    describe "Testing mv nested directory function ..."
+    if [ -e "${TEST_DIR}" ]; then
+       echo "Unexpected, this file/directory exists: ${TEST_DIR}"
+       return 1
+    fi
+
+    # directory objects, empty and non-empty files, and the directories
+    # which have no object(created by the external program)
+    mk_test_dir
+    for i in $(seq 4); do
+        mkdir "${TEST_DIR}/dir_${i}"
+        mkdir "${TEST_DIR}/dir_${i}/sub"
+        touch "${TEST_DIR}/dir_${i}/empty_file"
+        echo "data ${i}" > "${TEST_DIR}/dir_${i}/sub/file"
+    done
+    local OBJECT_NAME; OBJECT_NAME=$(basename "${PWD}")/"${TEST_DIR}"/implied_dir/implied_sub/file
+    echo "implied" | aws_cli s3 cp - "s3://${TEST_BUCKET_1}/${OBJECT_NAME}"
+
+    mv "${TEST_DIR}" "${TEST_DIR}_rename"
+    if [ -e "${TEST_DIR}" ]; then
+       echo "Directory ${TEST_DIR} still exists after renamed"
+       return 1
+    fi
+    for i in $(seq 4); do
+        if [ ! -d "${TEST_DIR}_rename/dir_${i}/sub" ] || [ ! -f "${TEST_DIR}_rename/dir_${i}/empty_file" ]; then
+           echo "Directory ${TEST_DIR}/dir_${i} was not renamed"
+           return 1
+        fi
+        cmp "${TEST_DIR}_rename/dir_${i}/sub/file" <(echo "data ${i}")
+    done
+    cmp "${TEST_DIR}_rename/implied_dir/implied_sub/file" <(echo "implied")
+
+    rm -r "${TEST_DIR}_rename"
+    if [ -e "${TEST_DIR}_rename" ]; then
+       echo "Could not remove the test directory, it still exists: ${TEST_DIR}_rename"
+       return 1
+    fi
+}
+
 function test_redirects {
     describe "Testing redirects ..."
 
@@ -408,6 +448,98 @@ function test_external_creation {
     rm -f "${TEST_TEXT_FILE}"
 }
 
+function test_stat_cache_stale_window {
+    describe "Test stale stats in stat_cache_stale_window ..."
+    echo "old" > "${TEST_TEXT_FILE}"
+    get_size "${TEST_TEXT_FILE}" > /dev/null
+
+    local OBJECT_NAME; OBJECT_NAME=$(basename "${PWD}")/"${TEST_TEXT_FILE}"
+    echo "new new" | aws_cli s3 cp - "s3://${TEST_BUCKET_1}/${OBJECT_NAME}"
+
+    # The stats expired(stat_cache_expire=1) but in the window is returned
+    # at once, and it is refreshed in background.
+    sleep 2
+    local size; size=$(get_size "${TEST_TEXT_FILE}")
+    if [ "${size}" -ne 4 ]; then
+        echo "Expected the stale size 4 but got ${size}"
+        return 1
+    fi
+
+    sleep 2
+    size=$(get_size "${TEST_TEXT_FILE}")
+    if [ "${size}" -ne 8 ]; then
+        echo "Expected the refreshed size 8 but got ${size}"
+        return 1
+    fi
+    cmp "${TEST_TEXT_FILE}" <(echo "new new")
+    rm -f "${TEST_TEXT_FILE}"
+}
+
+function test_readdir_fake_dir {
+    describe "Test directory stats built from the listing by readdir_fake_dir ..."
+    mk_test_dir
+    mkdir -m 700 "${TEST_DIR}/fake_dir"
+    touch "${TEST_DIR}/fake_dir/file"
+
+    # The listing registers the stats with fake_dir_mode(default 750)
+    # instead of sending HEAD request for the sub directory.
+    sleep 2
+    ls "${TEST_DIR}" > /dev/null
+    if ! get_permissions "${TEST_DIR}/fake_dir" | grep -q 750$; then
+        echo "Expected the fake mode 750 but got $(get_permissions "${TEST_DIR}/fake_dir")"
+        return 1
+    fi
+
+    # Opening it replaces the fake stats with the real ones by HEAD
+    # request(wait for the attributes cached by the kernel to expire).
+    ls "${TEST_DIR}/fake_dir" > /dev/null
+    sleep 2
+    if ! get_permissions "${TEST_DIR}/fake_dir" | grep -q 700$; then
+        echo "Expected the real mode 700 but got $(get_permissions "${TEST_DIR}/fake_dir")"
+        return 1
+    fi
+
+    # The object type is checked without the fake stats.
+    ls "${TEST_DIR}" > /dev/null
+    rm -f "${TEST_DIR}/fake_dir/file"
+    rmdir "${TEST_DIR}/fake_dir"
+    if [ -e "${TEST_DIR}/fake_dir" ]; then
+        echo "Could not remove the directory: ${TEST_DIR}/fake_dir"
+        return 1
+    fi
+    rm_test_dir
+}
+
+function test_readdir_stream {
+    describe "Test readdir_stream with seekdir and rewinddir ..."
+
+    # more objects than list_object_max_keys(default 1000), which are
+    # listed in two pages
+    local FILE_COUNT=1100
+    local LOCAL_DIR="${TEMP_DIR}/readdir_stream_${TEST_DIR}"
+    mkdir -p "${LOCAL_DIR}"
+    for i in $(seq "${FILE_COUNT}"); do
+        : > "${LOCAL_DIR}/file_${i}"
+    done
+    aws_cli s3 cp --recursive --quiet "${LOCAL_DIR}" "s3://${TEST_BUCKET_1}/$(basename "${PWD}")/${TEST_DIR}/"
+    rm -rf "${LOCAL_DIR}"
+
+    local file_cnt; file_cnt=$(find "${TEST_DIR}" -mindepth 1 | wc -l)
+    if [ "${file_cnt}" -ne "${FILE_COUNT}" ]; then
+        echo "Expected ${FILE_COUNT} files but got ${file_cnt}"
+        return 1
+    fi
+
+    # seek back into the first page and into the second page, then rewind
+    local entry_cnt; entry_cnt=$(../../readdir_seek_test "${TEST_DIR}" 10 1050)
+    if [ "${entry_cnt}" -ne "$((FILE_COUNT + 2))" ]; then
+        echo "Expected $((FILE_COUNT + 2)) entries but got ${entry_cnt}"
+        return 1
+    fi
+
+    rm -rf "${TEST_DIR}"
+}
+
 function test_read_external_object() {
     describe "create objects via aws CLI and read via ossfs ..."
     local OBJECT_NAME; OBJECT_NAME=$(basename "${PWD}")/"${TEST_TEXT_FILE}"
@@ -2581,6 +2713,66 @@ function test_mix_direct_read_with_skip {
     rm -f "${TEMP_DIR}/${TEST_FILE}"
 }
 
+function test_endpoint_balance {
+    describe "Testing requests balanced across endpoint_targets ..."
+
+    # the requests in parallel are spread across the addresses
+    local TEST_FILE="endpoint_balance_file"
+    dd if=/dev/urandom of="${TEMP_DIR}/${TEST_FILE}" bs=1M count=1
+    for i in $(seq 10); do
+        cp "${TEMP_DIR}/${TEST_FILE}" "${TEST_FILE}_${i}" &
+    done
+    wait
+
+    # wait for the stat cache to expire, then the stats are got again
+    sleep 2
+    if [ "$(find . -maxdepth 1 -name "${TEST_FILE}_*" | wc -l)" -ne 10 ]; then
+        echo "Expected 10 files"
+        return 1
+    fi
+    for i in $(seq 10); do
+        if ! cmp "${TEMP_DIR}/${TEST_FILE}" "${TEST_FILE}_${i}"; then
+            return 1
+        fi
+        rm -f "${TEST_FILE}_${i}"
+    done
+    rm -f "${TEMP_DIR}/${TEST_FILE}"
+}
+
+function test_http2_multiplexing {
+    describe "Testing HTTP/2 multiplexing ..."
+
+    local FILE_COUNT=100
+    mk_test_dir
+    for i in $(seq "${FILE_COUNT}"); do
+        touch "${TEST_DIR}/file_${i}"
+    done
+
+    # wait for the stat cache to expire, then the listing sends the HEAD
+    # requests for all files in parallel
+    sleep 2
+    local LOG_START; LOG_START=$(wc -l < "${H2_PROXY_ACCESS_LOG}")
+    ls -l "${TEST_DIR}" > /dev/null
+    sleep 1
+
+    local HEAD_LOG; HEAD_LOG=$(tail -n +"$((LOG_START + 1))" "${H2_PROXY_ACCESS_LOG}" | awk '$3 == "HEAD" && $5 ~ /file_/')
+    local HEAD_CNT; HEAD_CNT=$(echo "${HEAD_LOG}" | grep -c "^h2 " || true)
+    local CONN_CNT; CONN_CNT=$(echo "${HEAD_LOG}" | awk '{print $2}' | sort -u | wc -l)
+    if [ "${HEAD_CNT}" -lt "${FILE_COUNT}" ]; then
+        echo "Expected ${FILE_COUNT} HEAD requests by HTTP/2 but got ${HEAD_CNT}"
+        echo "${HEAD_LOG}"
+        return 1
+    fi
+    # the requests are multiplexed on a few connections of multireq_io_threads
+    if [ "$((CONN_CNT * 10))" -gt "${HEAD_CNT}" ]; then
+        echo "Expected the requests multiplexed but ${HEAD_CNT} requests used ${CONN_CNT} connections"
+        return 1
+    fi
+
+    rm -f "${TEST_DIR}"/file_*
+    rm_test_dir
+}
+
 function add_all_tests {
     # shellcheck disable=SC2009
     if ps u -p "${OSSFS_PID}" | grep -q use_cache; then
@@ -2601,6 +2793,7 @@ function add_all_tests {
     add_tests test_mv_to_exist_file
     add_tests test_mv_empty_directory
     add_tests test_mv_nonempty_directory
+    add_tests test_mv_nested_directory
     add_tests test_redirects
     add_tests test_mkdir_rmdir
     add_tests test_list
@@ -2709,6 +2902,26 @@ function add_all_tests {
     if ps u -p "${OSSFS_PID}" | grep -q direct_read_local_file_cache_size_mb; then
         add_tests test_mix_direct_read
     fi
+
+    if ps u -p "${OSSFS_PID}" | grep -q readdir_stream; then
+        add_tests test_readdir_stream
+    fi
+
+    if ps u -p "${OSSFS_PID}" | grep -q readdir_fake_dir; then
+        add_tests test_readdir_fake_dir
+    fi
+
+    if ps u -p "${OSSFS_PID}" | grep -q stat_cache_stale_window; then
+        add_tests test_stat_cache_stale_window
+    fi
+
+    if ps u -p "${OSSFS_PID}" | grep -q endpoint_targets; then
+        add_tests test_endpoint_balance
+    fi
+
+    if ps u -p "${OSSFS_PID}" | grep -q -e "-o http2 "; then
+        add_tests test_http2_multiplexing
+    fi
 }
 
 init_suite
@@ -0,0 +1,135 @@
+/*
+ * ossfs - FUSE-based file system backed by Alibaba Cloud OSS
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Read a directory, then seek back to some positions of it by seekdir() and
+// rewind it by rewinddir(), and check that the same entries are read again.
+// Usage: readdir_seek_test <directory> <position> [<position>...]
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int read_entries(DIR* dp, char*** pnames, long** poffsets)
+{
+    int            count = 0;
+    struct dirent* ent;
+
+    while(NULL != (ent = readdir(dp))){
+        *pnames   = realloc(*pnames, sizeof(char*) * (count + 1));
+        *poffsets = realloc(*poffsets, sizeof(long) * (count + 1));
+        (*pnames)[count]   = strdup(ent->d_name);
+        (*poffsets)[count] = telldir(dp);
+        ++count;
+    }
+    return count;
+}
+
+static int compare_entries(char** names, int count, char** expected, int start, int expected_count)
+{
+    int cnt;
+    if(count != expected_count - start){
+        fprintf(stderr, "[ERROR] read %d entries from position %d, but expected %d\n", count, start, expected_count - start);
+        return 1;
+    }
+    for(cnt = 0; cnt < count; ++cnt){
+        if(0 != strcmp(names[cnt], expected[start + cnt])){
+            fprintf(stderr, "[ERROR] entry %d is %s, but expected %s\n", start + cnt, names[cnt], expected[start + cnt]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void free_entries(char** names, long* offsets, int count)
+{
+    int cnt;
+    for(cnt = 0; cnt < count; ++cnt){
+        free(names[cnt]);
+    }
+    free(names);
+    free(offsets);
+}
+
+int main(int argc, char *argv[])
+{
+    DIR*   dp;
+    char** names   = NULL;
+    long*  offsets = NULL;
+    int    count;
+    int    result = 0;
+    int    argpos;
+
+    if(argc < 3){
+        fprintf(stderr, "Usage: %s <directory> <position> [<position>...]\n", argv[0]);
+        return 1;
+    }
+    if(NULL == (dp = opendir(argv[1]))){
+        fprintf(stderr, "[ERROR] could not open %s\n", argv[1]);
+        return 1;
+    }
+    count = read_entries(dp, &names, &offsets);
+
+    // seek back to the position after the entry of each position
+    for(argpos = 2; 0 == result && argpos < argc; ++argpos){
+        char** seek_names   = NULL;
+        long*  seek_offsets = NULL;
+        int    seek_count;
+        int    pos = atoi(argv[argpos]);
+
+        if(pos < 0 || count <= pos){
+            fprintf(stderr, "[ERROR] position %d is out of %d entries\n", pos, count);
+            result = 1;
+            break;
+        }
+        seekdir(dp, offsets[pos]);
+        seek_count = read_entries(dp, &seek_names, &seek_offsets);
+        result     = compare_entries(seek_names, seek_count, names, pos + 1, count);
+        free_entries(seek_names, seek_offsets, seek_count);
+    }
+
+    // rewind
+    if(0 == result){
+        char** rewind_names   = NULL;
+        long*  rewind_offsets = NULL;
+        int    rewind_count;
+
+        rewinddir(dp);
+        rewind_count = read_entries(dp, &rewind_names, &rewind_offsets);
+        result       = compare_entries(rewind_names, rewind_count, names, 0, count);
+        free_entries(rewind_names, rewind_offsets, rewind_count);
+    }
+    closedir(dp);
+
+    if(0 == result){
+        printf("%d\n", count);
+    }
+    free_entries(names, offsets, count);
+    return result;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
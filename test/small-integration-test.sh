@@ -67,7 +67,16 @@ if [ -n "${ALL_TESTS}" ]; then
         "default_acl=private"
         "direct_read -o direct_read_local_file_cache_size_mb=${DIRECT_READ_LOCAL_FILE_CACHE_SIZE_MB}"
         "sigv4 -o region=${OSS_REGION}"
+        "stat_cache_stale_window=10"
+        readdir_fake_dir
+        readdir_stream
+        "endpoint_targets=127.0.0.1,localhost"
     )
+    # HTTP/2 needs nghttpx as the frontend of S3Proxy
+    if command -v nghttpx > /dev/null; then
+        H2_PROXY=1
+        FLAGS+=("http2 -o url=${H2_PROXY_URL}")
+    fi
 else
     FLAGS=(
         sigv1